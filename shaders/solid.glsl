@@ -0,0 +1,10 @@
+#version 330 core
+
+in vec3 color;
+
+out vec4 outputColor;
+
+void main()
+{
+    outputColor = vec4(color, 1);
+}
\ No newline at end of file
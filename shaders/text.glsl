@@ -8,7 +8,9 @@ out vec4 outputColor;
 
 void main()
 {
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(inputTexture, textureCoord).r);
+    // The texture coordinates are in texels, as the atlas grows when glyphs are added
+    vec2 atlasCoord = textureCoord / vec2(textureSize(inputTexture, 0));
+    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(inputTexture, atlasCoord).r);
     outputColor = vec4(color, 1.0) * sampled;
 }
 
@@ -0,0 +1,19 @@
+#version 330 core
+
+uniform sampler2D inputTexture;
+
+in vec2 textureCoord;
+in vec3 color;
+out vec4 outputColor;
+
+void main()
+{
+    // The texture coordinates are in texels, as the atlas grows when glyphs are added
+    vec2 atlasCoord = textureCoord / vec2(textureSize(inputTexture, 0));
+
+    // The distance is 0.5 at the outline and larger inside, which is smoothed over a pixel at any scale
+    float distance = texture(inputTexture, atlasCoord).r;
+    float smoothing = 0.5 * fwidth(distance);
+    float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+    outputColor = vec4(color, alpha);
+}
\ No newline at end of file
@@ -1,17 +1,35 @@
 #version 330 core
 
 uniform mat4 projection;
+uniform samplerBuffer glyphs;
+uniform vec3 palette[16];
+uniform vec2 lineOffset;
 
-in vec2 vertexPosition;
-in vec2 vertexTexcoord;
-in vec3 vertexColor;
+in vec2 glyphPosition;
+in uint glyphIndex;
+in uint colorIndex;
 
 out vec2 textureCoord;
 out vec3 color;
 
+// The corners of the two triangles of a glyph, where (0, 0) is the bottom left
+const vec2 corners[6] = vec2[6](
+    vec2(0.0, 1.0), vec2(0.0, 0.0), vec2(1.0, 0.0),
+    vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0)
+);
+
 void main()
 {
-    textureCoord = vertexTexcoord;
-    color = vertexColor;
-    gl_Position = projection * vec4(vertexPosition, 0.0, 1.0);
+    // The bearing and size, followed by the left, top, right and bottom texture coordinates in texels
+    vec4 metrics = texelFetch(glyphs, int(glyphIndex) * 2);
+    vec4 bounds = texelFetch(glyphs, int(glyphIndex) * 2 + 1);
+
+    // Cached lines are stored relative to the start of the line
+    vec2 position = glyphPosition + lineOffset;
+    vec2 corner = corners[gl_VertexID];
+    vec2 origin = vec2(position.x + metrics.x, -position.y - (metrics.w - metrics.y));
+
+    textureCoord = vec2(mix(bounds.x, bounds.z, corner.x), mix(bounds.w, bounds.y, corner.y));
+    color = palette[colorIndex];
+    gl_Position = projection * vec4(origin + corner * metrics.zw, 0.0, 1.0);
 }
\ No newline at end of file
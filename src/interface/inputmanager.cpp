@@ -31,6 +31,7 @@ bool InputManager::isKeyPressed(int key) {
 	}
 
 	if (currentPressed && prevReleased) {
+		mHasPressedKeys = true;
 		return true;
 	}
 
@@ -41,10 +42,12 @@ bool InputManager::isKeyPressed(int key) {
 			if (lastPressedIterator != mLastPressed.end()) {
 				if (Helpers::durationMilliseconds(Helpers::timeNow(), lastPressedIterator->second) >= 30) {
 					mLastPressed[key] = Helpers::timeNow();
+					mHasPressedKeys = true;
 					return true;
 				}
 			} else {
 				mLastPressed[key] = Helpers::timeNow();
+				mHasPressedKeys = true;
 				return true;
 			}
 		}
@@ -107,7 +110,24 @@ bool InputManager::isMouseDragMove(int button) {
 	return isDragMove;
 }
 
+bool InputManager::hasPressedKeys() const {
+	return mHasPressedKeys;
+}
+
+bool InputManager::isAnyInputDown() const {
+	for (auto& key : mValidKeys) {
+		if (glfwGetKey(mWindow, key) == GLFW_PRESS) {
+			return true;
+		}
+	}
+
+	return glfwGetMouseButton(mWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS
+		   || glfwGetMouseButton(mWindow, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+}
+
 void InputManager::postUpdate() {
+	mHasPressedKeys = false;
+
 	for (auto& key : mValidKeys) {
 		mPreviousState[key] = glfwGetKey(mWindow, key);
 	}
@@ -31,6 +31,8 @@ private:
 
 	bool mIsLeftMouseButtonDragMove = false;
 	bool mIsRightMouseButtonDragMove = false;
+
+	bool mHasPressedKeys = false;
 public:
 	/**
 	 * Creates a new input manager
@@ -78,6 +80,16 @@ public:
 	 */
 	bool isMouseDragMove(int button);
 
+	/**
+	 * Indicates if any key has been pressed since the last update
+	 */
+	bool hasPressedKeys() const;
+
+	/**
+	 * Indicates if a checked key or a mouse button is held down, which repeats the key or drags the mouse over time
+	 */
+	bool isAnyInputDown() const;
+
 	/**
 	 * Updates the input manager
 	 */
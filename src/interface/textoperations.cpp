@@ -5,17 +5,43 @@
 
 
 namespace {
-	void formattedBenchmark(const Font& font, TextFormatter& textFormatter, const RenderStyle& renderStyle, const RenderViewPort& viewPort, const Text& text) {
+	// The estimated time in microseconds for formatting the whole text below which each strategy is used. Full
+	// formatting is done for each edit, so it must fit in a frame.
+	const double MAX_FULL_FORMATTING_COST = 4000.0;
+	const double MAX_INCREMENTAL_FORMATTING_COST = 2000000.0;
+
+	// Lines longer than this are reformatted too slowly for each keystroke in incremental mode
+	const std::size_t MAX_INCREMENTAL_LINE_LENGTH = 10000;
+
+	// The number of lines formatted to estimate the formatting cost of a text
+	const std::size_t NUM_COST_SAMPLE_LINES = 1000;
+
+	const char* formattingTypeName(PerformFormattingType type) {
+		switch (type) {
+			case PerformFormattingType::Full:
+				return "full";
+			case PerformFormattingType::Partial:
+				return "partial";
+			case PerformFormattingType::Incremental:
+				return "incremental";
+			case PerformFormattingType::Adaptive:
+				return "adaptive";
+		}
+
+		return "";
+	}
+
+	void formattedBenchmark(const Font& font, TextFormatter& textFormatter, const RenderStyle& renderStyle, const Text& text) {
 		for (int i = 0; i < 3; i++) {
 			FormattedLines formattedLines;
-			textFormatter.format(font, renderStyle, viewPort, text, formattedLines);
+			textFormatter.format(font, renderStyle, text, formattedLines);
 		}
 
 		int n = 15;
 		auto t0 = Helpers::timeNow();
 		for (int i = 0; i < n; i++) {
 			FormattedLines formattedLines;
-			textFormatter.format(font, renderStyle, viewPort, text, formattedLines);
+			textFormatter.format(font, renderStyle, text, formattedLines);
 		}
 
 		std::cout
@@ -30,23 +56,77 @@ float TextOperations::getLineNumberSpacing(const Font& font, const Text& text) {
 
 TextOperations::TextOperations(PerformFormattingType performFormattingType,
 							   Font& font,
-							   std::unique_ptr<FormatterRules> formattingRules,
+							   std::unique_ptr<TextFormatter> textFormatter,
 							   const RenderStyle& renderStyle,
 							   Text& text,
 							   InputState& inputState)
 	: mPerformFormattingType(performFormattingType),
 	  mFont(font),
-	  mTextFormatter(std::move(formattingRules)),
+	  mTextFormatter(std::move(textFormatter)),
 	  mRenderStyle(renderStyle),
 	  mText(text),
+	  mFoldedText(mFoldIndex),
+	  mWrappedText(font, renderStyle, mFoldIndex),
 	  mInputState(inputState) {
+	if (mPerformFormattingType == PerformFormattingType::Adaptive) {
+		mAdaptiveFormatting = true;
+		mPerformFormattingType = PerformFormattingType::Incremental;
+	}
+}
+
+bool TextOperations::isWordWrapped() const {
+	// Partial formatting only formats the visible lines, which means that the layout of the lines above is not known
+	return mRenderStyle.wordWrap && mPerformFormattingType != PerformFormattingType::Partial;
+}
 
+const TextFormatter& TextOperations::textFormatter() const {
+	return *mTextFormatter;
 }
 
-BaseFormattedText* TextOperations::formattedText() const {
+const BaseFormattedText* TextOperations::formattedText() const {
+	if (isWordWrapped()) {
+		return &mWrappedText;
+	}
+
+	if (!mFoldIndex.empty()) {
+		return &mFoldedText;
+	}
+
 	return mFormattedText.get();
 }
 
+const FoldIndex& TextOperations::foldIndex() const {
+	return mFoldIndex;
+}
+
+const BracketIndex* TextOperations::bracketIndex() const {
+	if (mPerformFormattingType == PerformFormattingType::Partial || mFormattedText == nullptr) {
+		return nullptr;
+	}
+
+	return &mBracketIndex;
+}
+
+const SymbolIndex* TextOperations::symbolIndex() const {
+	if (mPerformFormattingType == PerformFormattingType::Partial || mFormattedText == nullptr) {
+		return nullptr;
+	}
+
+	return &mSymbolIndex;
+}
+
+PerformFormattingType TextOperations::performFormattingType() const {
+	return mPerformFormattingType;
+}
+
+std::size_t TextOperations::numVisualLines() const {
+	if (isWordWrapped()) {
+		return mWrappedText.numLines();
+	}
+
+	return mText.numLines() - mFoldIndex.numHiddenLines();
+}
+
 IncrementalFormattedText::InputState TextOperations::getIncrementalFormattingInputState() {
 	return { (std::size_t)mInputState.caretLineIndex, (std::size_t)mInputState.caretCharIndex };
 }
@@ -59,15 +139,204 @@ std::size_t TextOperations::numLines() {
 	return mText.numLines();
 }
 
+void TextOperations::addFormattingCost(std::size_t numFormattedLines, std::int64_t durationMicroseconds) {
+	if (numFormattedLines == 0) {
+		return;
+	}
+
+	auto costPerLine = (double)durationMicroseconds / numFormattedLines;
+	if (mFormattingCostPerLine == 0.0) {
+		mFormattingCostPerLine = costPerLine;
+	} else {
+		mFormattingCostPerLine = 0.75 * mFormattingCostPerLine + 0.25 * costPerLine;
+	}
+}
+
+void TextOperations::measureText() {
+	auto t0 = Helpers::timeNow();
+	mNumLongLines = countLongLines(0, mText.numLines());
+
+	auto numSampleLines = std::min(mText.numLines(), NUM_COST_SAMPLE_LINES);
+	FormattedLines formattedLines;
+	auto t1 = Helpers::timeNow();
+	mTextFormatter->formatLinesInState(mFont, mRenderStyle, mText, 0, numSampleLines - 1, State::Text, formattedLines);
+	addFormattingCost(numSampleLines, Helpers::durationMicroseconds(Helpers::timeNow(), t1));
+
+	std::cout
+		<< "Measured text (lines = " << numLines() << ", long lines = " << mNumLongLines
+		<< ", cost per line = " << mFormattingCostPerLine << " us) in "
+		<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
+		<< std::endl;
+}
+
+std::size_t TextOperations::countLongLines(std::size_t lineIndex, std::size_t count) const {
+	std::size_t numLongLines = 0;
+	auto endLineIndex = std::min(lineIndex + count, mText.numLines());
+	for (auto i = lineIndex; i < endLineIndex; i++) {
+		if (mText.getLine(i).size() > MAX_INCREMENTAL_LINE_LENGTH) {
+			numLongLines++;
+		}
+	}
+
+	return numLongLines;
+}
+
+void TextOperations::updateLongLines(std::size_t lineIndex, std::size_t numOldLongLines, std::size_t numNewLines) {
+	// The long lines are counted when the text is measured
+	if (mFormattingCostPerLine == 0.0) {
+		return;
+	}
+
+	// Counting the replaced lines means that the count also goes down when a long line is shortened or deleted
+	mNumLongLines = mNumLongLines - numOldLongLines + countLongLines(lineIndex, numNewLines);
+}
+
+PerformFormattingType TextOperations::selectFormattingType() const {
+	if (mNumLongLines > 0) {
+		return PerformFormattingType::Partial;
+	}
+
+	// Switching back to a more expensive strategy requires a margin, to avoid switching back and forth at the limits
+	auto maxFullCost = MAX_FULL_FORMATTING_COST;
+	auto maxIncrementalCost = MAX_INCREMENTAL_FORMATTING_COST;
+	if (mPerformFormattingType == PerformFormattingType::Incremental) {
+		maxFullCost *= 0.5;
+	} else if (mPerformFormattingType == PerformFormattingType::Partial) {
+		maxIncrementalCost *= 0.5;
+	}
+
+	auto estimatedCost = mFormattingCostPerLine * mText.numLines();
+	if (estimatedCost < maxFullCost) {
+		return PerformFormattingType::Full;
+	}
+
+	if (estimatedCost < maxIncrementalCost) {
+		return PerformFormattingType::Incremental;
+	}
+
+	return PerformFormattingType::Partial;
+}
+
+void TextOperations::updateFormattingType() {
+	if (!mAdaptiveFormatting) {
+		return;
+	}
+
+	if (mFormattingCostPerLine == 0.0) {
+		measureText();
+	}
+
+	auto performFormattingType = selectFormattingType();
+	if (performFormattingType == mPerformFormattingType) {
+		return;
+	}
+
+	std::cout
+		<< "Switched formatting from " << formattingTypeName(mPerformFormattingType)
+		<< " to " << formattingTypeName(performFormattingType)
+		<< " (lines = " << numLines() << ", estimated cost = " << (mFormattingCostPerLine * numLines() / 1E3) << " ms)"
+		<< std::endl;
+
+	mPerformFormattingType = performFormattingType;
+	mFormattedText.reset();
+}
+
 void TextOperations::viewMoved() {
 	mViewMoved = true;
 }
 
+void TextOperations::setFormattingBudget(std::int64_t budgetMicroseconds) {
+	mFormattingBudget = budgetMicroseconds;
+
+	if (mPerformFormattingType == PerformFormattingType::Incremental && mFormattedText != nullptr) {
+		incrementalFormattedText()->setFormattingBudget(budgetMicroseconds);
+	}
+}
+
+void TextOperations::setFormattingWindowSize(std::size_t windowSize) {
+	mFormattingWindowSize = windowSize;
+
+	if (mPerformFormattingType == PerformFormattingType::Incremental && mFormattedText != nullptr) {
+		incrementalFormattedText()->setWindowSize(windowSize);
+	}
+}
+
+bool TextOperations::updateFormatting(const RenderViewPort& viewPort) {
+	if (mPerformFormattingType != PerformFormattingType::Incremental || mFormattedText == nullptr) {
+		return false;
+	}
+
+	bool changed = false;
+	auto formattedText = incrementalFormattedText();
+	if (formattedText->hasPendingFormatting()) {
+		auto formattedLines = formattedText->runFormattingJob();
+		if (formattedLines.second > 0) {
+			updateReformattedLines(formattedLines.first, formattedLines.second, formattedLines.second);
+			changed = true;
+		}
+	} else {
+		changed = updateSymbolIndex();
+	}
+
+	if (mFormattingWindowSize > 0 && numVisualLines() > 0) {
+		auto visibleText = this->formattedText();
+		auto lastVisualLineIndex = numVisualLines() - 1;
+		auto position = mInputState.getDrawPosition(mRenderStyle);
+
+		auto viewStartLineIndex = (std::size_t)std::max(std::floor(-position.y / mFont.lineHeight()), 0.0f);
+		auto viewEndLineIndex = viewStartLineIndex + (std::size_t)std::ceil(viewPort.height / mFont.lineHeight());
+
+		formattedText->updateWindow(
+			visibleText->getTextLineIndex(std::min(viewStartLineIndex, lastVisualLineIndex)),
+			visibleText->getTextLineIndex(std::min(viewEndLineIndex, lastVisualLineIndex)),
+			(std::size_t)mInputState.caretLineIndex);
+	}
+
+	return changed;
+}
+
+bool TextOperations::hasPendingFormatting() const {
+	if (mPerformFormattingType != PerformFormattingType::Incremental || mFormattedText == nullptr) {
+		return false;
+	}
+
+	auto formattedText = (const IncrementalFormattedText*)mFormattedText.get();
+	return formattedText->hasPendingFormatting() || mSymbolIndex.numLines() != mFormattedText->numLines();
+}
+
+bool TextOperations::updateSymbolIndex() {
+	if (mSymbolIndex.numLines() == mFormattedText->numLines()) {
+		return false;
+	}
+
+	// The index is built over several frames, as indexing a large text at once would stall the editor
+	auto t0 = Helpers::timeNow();
+	mNumSymbolIndexSlices++;
+	if (mSymbolIndex.build(*mFormattedText, mFormattingBudget)) {
+		std::cout
+			<< "Indexed symbols (lines = " << mSymbolIndex.numLines() << ", symbols = " << mSymbolIndex.numSymbols()
+			<< ") in " << mNumSymbolIndexSlices << " slices, last in "
+			<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
+			<< std::endl;
+		mNumSymbolIndexSlices = 0;
+	}
+
+	return true;
+}
+
 void TextOperations::formatLinePartialMode(const RenderViewPort& viewPort, PartialFormattedText& formattedText, std::size_t lineIndex) {
-	FormattedLine formattedLine;
-	mTextFormatter.formatLine(mFont, mRenderStyle, viewPort, mText.getLine(lineIndex), formattedLine);
-	formattedLine.number = lineIndex;
-	formattedText.addLine(lineIndex, formattedLine);
+	// Partial formatting of a line only depends on its content, so a cached line can be used even if it has moved
+	auto lineVersion = mText.lineVersion(lineIndex);
+	auto formattedLine = mPartialLineCache.get(lineVersion);
+	if (formattedLine == nullptr) {
+		auto newFormattedLine = std::make_shared<FormattedLine>();
+		mTextFormatter->formatLine(mFont, mRenderStyle, mText.getLine(lineIndex), *newFormattedLine);
+		newFormattedLine->number = lineIndex;
+		formattedLine = newFormattedLine;
+		mPartialLineCache.put(lineVersion, formattedLine);
+	}
+
+	formattedText.addLine(lineIndex, std::move(formattedLine));
 }
 
 void TextOperations::requireLineFormatted(const RenderViewPort& viewPort, std::size_t lineIndex) {
@@ -111,13 +380,14 @@ PartialFormattedText TextOperations::performPartialFormatting(const RenderViewPo
 		formatLine((std::size_t)mInputState.caretLineIndex);
 	}
 
+	// Folded lines are skipped by going through the visible lines
 	auto cursorLineIndex = (std::int64_t)std::floor(-position.y / mFont.lineHeight());
-	for (std::int64_t lineIndex = cursorLineIndex; lineIndex < (std::int64_t)mText.numLines(); lineIndex++) {
+	for (std::int64_t lineIndex = cursorLineIndex; lineIndex < (std::int64_t)numVisualLines(); lineIndex++) {
 		if (lineIndex >= 0) {
 			glm::vec2 drawPosition(position.x, position.y + (lineIndex + 1) * mFont.lineHeight());
 
 			if (drawPosition.y >= viewPort.top()) {
-				formatLine((std::size_t)lineIndex);
+				formatLine(mFoldIndex.getTextLineIndex((std::size_t)lineIndex));
 			}
 
 			if (drawPosition.y > viewPort.bottom()) {
@@ -135,90 +405,356 @@ PartialFormattedText TextOperations::performPartialFormatting(const RenderViewPo
 }
 
 void TextOperations::updateFormattedText(const RenderViewPort& viewPort) {
-	bool needUpdate = mLastViewPort.width != viewPort.width
-					  || mLastViewPort.height != viewPort.height
-					  || mLastViewPort.position != viewPort.position
-					  || mText.hasChanged(mTextVersion);
+	updateFormattingType();
+
+	// The formatting does not depend on the view port, except for partial formatting which only formats the visible lines
+	bool needUpdate = mFormattedText == nullptr || mText.hasChanged(mTextVersion);
 
 	if (mPerformFormattingType == PerformFormattingType::Partial) {
-		needUpdate |= mViewMoved;
+		needUpdate |= mViewMoved
+					  || mLastViewPort.height != viewPort.height
+					  || mLastViewPort.position != viewPort.position;
 	}
 
-	if (needUpdate) {
-		mLastViewPort = viewPort;
+	mLastViewPort = viewPort;
 
+	if (needUpdate) {
 		switch (mPerformFormattingType) {
 			case PerformFormattingType::Full: {
 				auto t0 = Helpers::timeNow();
 				auto formattedText = std::make_unique<FormattedText>();
-				mTextFormatter.format(mFont, mRenderStyle, viewPort, mText, formattedText->lines());
+				mTextFormatter->format(mFont, mRenderStyle, mText, formattedText->lines());
 				mFormattedText = std::move(formattedText);
+				mBracketIndex.assign(*mFormattedText);
+				mSymbolIndex.assign(*mFormattedText);
+				addFormattingCost(numLines(), Helpers::durationMicroseconds(Helpers::timeNow(), t0));
 				std::cout
 					<< "Formatted text (lines = " << numLines() << ") in "
 					<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
 					<< std::endl;
 
-//				formattedBenchmark(mFont, mFormatMode, mRenderStyle, viewPort, mText);
+//				formattedBenchmark(mFont, *mTextFormatter, mRenderStyle, mText);
 
 				mInputState.caretLineIndex = std::min(mInputState.caretLineIndex, (std::int64_t)numLines() - 1);
 				break;
 			}
 			case PerformFormattingType::Incremental: {
 				auto t0 = Helpers::timeNow();
-				mFormattedText = std::make_unique<IncrementalFormattedText>(
+				auto formattedText = std::make_unique<IncrementalFormattedText>(
 					mFont,
-					mTextFormatter,
+					*mTextFormatter,
 					mRenderStyle,
-					viewPort,
 					mText,
 					mTextVersion);
+				formattedText->setFormattingBudget(mFormattingBudget);
+				formattedText->setWindowSize(mFormattingWindowSize);
+				mFormattedText = std::move(formattedText);
+				mBracketIndex.assign(*mFormattedText);
+				mSymbolIndex.clear();
+				mNumSymbolIndexSlices = 0;
+				addFormattingCost(numLines(), Helpers::durationMicroseconds(Helpers::timeNow(), t0));
 
 				std::cout
 					<< "Formatted text (lines = " << numLines() << ") in "
 					<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
 					<< std::endl;
 
-//				formattedBenchmark(mFont, mTextFormatter, mRenderStyle, viewPort, mText);
+//				formattedBenchmark(mFont, *mTextFormatter, mRenderStyle, mText);
 
 				mInputState.caretLineIndex = std::min(mInputState.caretLineIndex, (std::int64_t) numLines() - 1);
 				break;
 			}
 			case PerformFormattingType::Partial: {
 				auto t0 = Helpers::timeNow();
+				auto numMissesBefore = mPartialLineCache.numMisses();
 				mViewMoved = false;
+				mBracketIndex.clear();
+				mSymbolIndex.clear();
 				mFormattedText = std::make_unique<PartialFormattedText>(performPartialFormatting(
 					viewPort,
 					mInputState.getDrawPosition(mRenderStyle)
 					+ glm::vec2(TextOperations::getLineNumberSpacing(mFont, mText), 0.0f)));
+				addFormattingCost(
+					mPartialLineCache.numMisses() - numMissesBefore,
+					Helpers::durationMicroseconds(Helpers::timeNow(), t0));
 
 				std::cout
-					<< "Partial formatted text (lines = " << numLines() << ") in "
+					<< "Partial formatted text (lines = " << numLines()
+					<< ", formatted = " << (mPartialLineCache.numMisses() - numMissesBefore) << ") in "
 					<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
 					<< std::endl;
 				break;
 			}
+			case PerformFormattingType::Adaptive:
+				break;
+		}
+
+		mFoldedText.setText(*mFormattedText);
+	}
+
+	updateLayout(viewPort, needUpdate);
+}
+
+void TextOperations::updateLayout(const RenderViewPort& viewPort, bool formatted) {
+	if (!isWordWrapped()) {
+		return;
+	}
+
+	bool textChanged = mText.hasChanged(mLayoutTextVersion);
+	bool foldsChanged = mFoldIndex.hasChanged(mLayoutFoldVersion);
+	if (formatted || textChanged || foldsChanged || mWrappedText.maxWidth() != viewPort.width) {
+		auto t0 = Helpers::timeNow();
+		mWrappedText.layout(*mFormattedText, viewPort.width);
+
+		std::cout
+			<< "Word wrapped text (lines = " << mWrappedText.numLines() << ") in "
+			<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
+			<< std::endl;
+	}
+
+	// Only the lines around the view are split into rows
+	auto position = mInputState.getDrawPosition(mRenderStyle);
+	auto viewStartRowIndex = (std::size_t)std::max(std::floor(-position.y / mFont.lineHeight()), 0.0f);
+	auto viewEndRowIndex = viewStartRowIndex + (std::size_t)std::ceil(viewPort.height / mFont.lineHeight()) + 2;
+	mWrappedText.updateWindow(viewStartRowIndex, viewEndRowIndex, (std::size_t)mInputState.caretLineIndex);
+}
+
+void TextOperations::updateLayoutLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines) {
+	if (!isWordWrapped() || mWrappedText.numLines() == 0) {
+		return;
+	}
+
+	mWrappedText.replaceLines(lineIndex, numOldLines, numNewLines);
+	mText.hasChanged(mLayoutTextVersion);
+}
+
+void TextOperations::updateReformattedLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines) {
+	updateLayoutLines(lineIndex, numOldLines, numNewLines);
+	mBracketIndex.replaceLines(*mFormattedText, lineIndex, numOldLines, numNewLines);
+	mSymbolIndex.replaceLines(*mFormattedText, lineIndex, numOldLines, numNewLines);
+
+	auto formattedLines = incrementalFormattedText()->takeEditFormattedLines();
+	if (formattedLines.second > 0) {
+		updateLayoutLines(formattedLines.first, formattedLines.second, formattedLines.second);
+		mBracketIndex.replaceLines(*mFormattedText, formattedLines.first, formattedLines.second, formattedLines.second);
+		mSymbolIndex.replaceLines(*mFormattedText, formattedLines.first, formattedLines.second, formattedLines.second);
+	}
+}
+
+void TextOperations::updateEditedLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines) {
+	mFoldIndex.replaceLines(lineIndex, numOldLines, numNewLines);
+
+	if (mPerformFormattingType == PerformFormattingType::Incremental) {
+		updateReformattedLines(lineIndex, numOldLines, numNewLines);
+	}
+}
+
+bool TextOperations::findFoldRegion(std::size_t lineIndex, std::size_t& lastLineIndex) {
+	// Partial formatting has no state for multi-line constructs, so the lines after the header are formatted as needed
+	std::unique_ptr<FormattingJob> formattingJob;
+	auto getFormattedLine = [&](std::size_t index) -> const FormattedLine* {
+		if (index >= mText.numLines()) {
+			return nullptr;
+		}
+
+		if (mPerformFormattingType != PerformFormattingType::Partial) {
+			return &mFormattedText->getLine(index);
+		}
+
+		if (formattingJob == nullptr) {
+			formattingJob = mTextFormatter->createFormattingJob(mFont, mRenderStyle, mText, lineIndex, mText.numLines() - 1);
+		}
+
+		while (formattingJob->formattedLines().size() <= index - lineIndex && !formattingJob->isDone()) {
+			formattingJob->run(mFormattingBudget);
+		}
+
+		auto& formattedLines = formattingJob->formattedLines();
+		return index - lineIndex < formattedLines.size() ? &formattedLines[index - lineIndex] : nullptr;
+	};
+
+	auto headerLine = getFormattedLine(lineIndex);
+	if (headerLine == nullptr) {
+		return false;
+	}
+
+	// A block of brackets, where the line of the close bracket is still shown
+	auto bracketIndex = this->bracketIndex();
+	BracketPosition open;
+	BracketPosition close;
+	if (bracketIndex != nullptr) {
+		if (bracketIndex->findBlockAtLine(lineIndex, open, close)) {
+			lastLineIndex = close.lineIndex - 1;
+			return lastLineIndex > lineIndex;
+		}
+	} else {
+		std::vector<Bracket> brackets;
+		BracketIndex::findBrackets(*headerLine, brackets);
+		if (BracketIndex::findLastUnmatchedOpen(brackets) != nullptr) {
+			std::int64_t depth = 1;
+			for (auto index = lineIndex + 1; depth > 0; index++) {
+				auto line = getFormattedLine(index);
+				if (line == nullptr) {
+					return false;
+				}
+
+				BracketIndex::findBrackets(*line, brackets);
+				for (auto& bracket : brackets) {
+					depth += bracket.isOpen ? 1 : -1;
+					if (depth == 0) {
+						break;
+					}
+				}
+
+				lastLineIndex = index - 1;
+			}
+
+			return lastLineIndex > lineIndex;
+		}
+	}
+
+	// A block comment, where the line that ends it is still shown
+	bool startsInBlockComment = mPerformFormattingType != PerformFormattingType::Partial
+								&& lineIndex > 0
+								&& getFormattedLine(lineIndex - 1)->endsInBlockComment;
+	if (headerLine->endsInBlockComment && !startsInBlockComment) {
+		lastLineIndex = lineIndex;
+		for (auto index = lineIndex + 1; ; index++) {
+			auto line = getFormattedLine(index);
+			if (line == nullptr || !line->endsInBlockComment) {
+				break;
+			}
+
+			lastLineIndex = index;
+		}
+
+		return lastLineIndex > lineIndex;
+	}
+
+	// An indentation block, e.g. in Python, which is started by a line ending with a colon
+	String headerCode;
+	for (auto& token : headerLine->tokens) {
+		if (token.type != TokenType::Comment) {
+			headerCode += token.text;
 		}
 	}
+
+	auto lastCodeChar = headerCode.find_last_not_of(u" \t");
+	if (lastCodeChar == String::npos || headerCode[lastCodeChar] != ':') {
+		return false;
+	}
+
+	auto indentation = [&](const String& line) {
+		std::size_t width = 0;
+		for (auto character : line) {
+			if (character == ' ') {
+				width++;
+			} else if (character == '\t') {
+				width += mRenderStyle.spacesPerTab;
+			} else {
+				return width;
+			}
+		}
+
+		return std::string::npos;
+	};
+
+	auto headerIndentation = indentation(mText.getLine(lineIndex));
+	lastLineIndex = lineIndex;
+	for (auto index = lineIndex + 1; index < mText.numLines(); index++) {
+		auto lineIndentation = indentation(mText.getLine(index));
+		if (lineIndentation == std::string::npos) {
+			// Empty lines belong to the block if it continues after them
+			continue;
+		}
+
+		if (lineIndentation <= headerIndentation) {
+			break;
+		}
+
+		lastLineIndex = index;
+	}
+
+	return lastLineIndex > lineIndex;
+}
+
+void TextOperations::toggleFold(const RenderViewPort& viewPort) {
+	auto t0 = Helpers::timeNow();
+	auto lineIndex = (std::size_t)mInputState.caretLineIndex;
+	if (!mFoldIndex.unfold(lineIndex)) {
+		std::size_t lastLineIndex = 0;
+		if (!findFoldRegion(lineIndex, lastLineIndex)) {
+			return;
+		}
+
+		mFoldIndex.fold(lineIndex, lastLineIndex);
+		std::cout
+			<< "Folded lines (start = " << lineIndex + 1 << ", count = " << lastLineIndex - lineIndex << ") in "
+			<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
+			<< std::endl;
+	}
+
+	mViewMoved = true;
+	updateFormattedText(viewPort);
+}
+
+bool TextOperations::goToDefinition(const RenderViewPort& viewPort) {
+	auto symbolIndex = this->symbolIndex();
+	if (symbolIndex == nullptr) {
+		return false;
+	}
+
+	auto t0 = Helpers::timeNow();
+	SymbolPosition start;
+	auto symbol = symbolIndex->findSymbolAt(
+		{ (std::size_t)mInputState.caretLineIndex, (std::size_t)mInputState.caretCharIndex },
+		start);
+
+	SymbolPosition definition;
+	if (symbol == SymbolIndex::NO_SYMBOL || !symbolIndex->findDefinition(symbol, definition)) {
+		return false;
+	}
+
+	std::cout
+		<< "Found definition (line = " << definition.lineIndex + 1 << ") in "
+		<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
+		<< std::endl;
+
+	mFoldIndex.reveal(definition.lineIndex);
+	mInputState.caretLineIndex = (std::int64_t)definition.lineIndex;
+	mInputState.caretCharIndex = (std::int64_t)definition.charIndex;
+
+	mViewMoved = true;
+	updateFormattedText(viewPort);
+	return true;
 }
 
 void TextOperations::insertCharacter(const RenderViewPort& viewPort, Char character) {
+	auto numOldLongLines = countLongLines((std::size_t)mInputState.caretLineIndex, 1);
 	mText.insertAt((std::size_t)mInputState.caretLineIndex, (std::size_t)mInputState.caretCharIndex, character);
+	updateLongLines((std::size_t)mInputState.caretLineIndex, numOldLongLines, 1);
 
 	if (mPerformFormattingType == PerformFormattingType::Incremental) {
 		incrementalFormattedText()->insertCharacter(getIncrementalFormattingInputState());
-	} else {
-		updateFormattedText(viewPort);
 	}
+
+	updateEditedLines((std::size_t)mInputState.caretLineIndex, 1, 1);
+
+	updateFormattedText(viewPort);
 }
 
 void TextOperations::insertLine(const RenderViewPort& viewPort) {
+	auto numOldLongLines = countLongLines((std::size_t)mInputState.caretLineIndex, 1);
 	mText.splitLine((std::size_t)mInputState.caretLineIndex, (std::size_t)mInputState.caretCharIndex);
+	updateLongLines((std::size_t)mInputState.caretLineIndex, numOldLongLines, 2);
 
 	if (mPerformFormattingType == PerformFormattingType::Incremental) {
 		incrementalFormattedText()->insertLine(getIncrementalFormattingInputState());
-	} else {
-		updateFormattedText(viewPort);
 	}
+
+	updateEditedLines((std::size_t)mInputState.caretLineIndex, 1, 2);
+
+	updateFormattedText(viewPort);
 }
 
 std::pair<std::size_t, std::size_t> TextOperations::paste(const RenderViewPort& viewPort, const String& text) {
@@ -227,6 +763,7 @@ std::pair<std::size_t, std::size_t> TextOperations::paste(const RenderViewPort&
 	auto diffCaretX = text.size();
 	std::size_t diffCaretY = 0;
 
+	auto numOldLongLines = countLongLines((std::size_t)mInputState.caretLineIndex, 1);
 	if (pasteText.numLines() > 1) {
 		mText.insertText((std::size_t)mInputState.caretLineIndex, (std::size_t)mInputState.caretCharIndex, pasteText);
 		diffCaretX = pasteText.getLine(pasteText.numLines() - 1).size();
@@ -235,31 +772,57 @@ std::pair<std::size_t, std::size_t> TextOperations::paste(const RenderViewPort&
 		mText.insertAt((std::size_t)mInputState.caretLineIndex, (std::size_t)mInputState.caretCharIndex, text);
 	}
 
+	updateLongLines((std::size_t)mInputState.caretLineIndex, numOldLongLines, pasteText.numLines());
+
 	if (mPerformFormattingType == PerformFormattingType::Incremental) {
 		incrementalFormattedText()->paste(
 			getIncrementalFormattingInputState(),
 			pasteText.numLines());
-	} else {
-		updateFormattedText(viewPort);
 	}
 
+	updateEditedLines((std::size_t)mInputState.caretLineIndex, 1, pasteText.numLines());
+
+	updateFormattedText(viewPort);
+
 	return std::make_pair(diffCaretX, diffCaretY);
 }
 
 void TextOperations::deleteLine(const RenderViewPort& viewPort, Text::DeleteLineMode mode) {
+	auto lineIndex = (std::size_t)mInputState.caretLineIndex;
+	bool hasNextLine = lineIndex + 1 < mText.numLines();
+
+	// The line is merged into the line before or after it, or deleted if it is the first line
+	auto mergedLineIndex = mode == Text::DeleteLineMode::Start && lineIndex > 0 ? lineIndex - 1 : lineIndex;
+	auto numMergedLines = mode == Text::DeleteLineMode::Start ? (lineIndex > 0 ? 2 : 1) : (hasNextLine ? 2 : 1);
+	auto numOldLongLines = countLongLines(mergedLineIndex, numMergedLines);
+
 	auto diff = mText.deleteLine((std::size_t)mInputState.caretLineIndex, mode);
 	if (mode == Text::DeleteLineMode::Start) {
 		mInputState.caretCharIndex = diff.caretX;
 	}
 
+	updateLongLines(mergedLineIndex, numOldLongLines, mode == Text::DeleteLineMode::Start && lineIndex == 0 ? 0 : 1);
+
 	if (mPerformFormattingType == PerformFormattingType::Incremental) {
 		incrementalFormattedText()->deleteLine(getIncrementalFormattingInputState(), mode);
+	}
+
+	if (mode == Text::DeleteLineMode::Start) {
+		if (lineIndex > 0) {
+			updateEditedLines(lineIndex - 1, 2, 1);
+		} else {
+			updateEditedLines(lineIndex, 1, 0);
+		}
 	} else {
-		updateFormattedText(viewPort);
+		updateEditedLines(lineIndex, hasNextLine ? 2 : 1, 1);
 	}
+
+	updateFormattedText(viewPort);
 }
 
 void TextOperations::deleteSelection(const RenderViewPort& viewPort, const TextSelection& textSelection) {
+	auto numOldLines = textSelection.endLine - textSelection.startLine + 1;
+	auto numOldLongLines = countLongLines(textSelection.startLine, numOldLines);
 	auto deleteData = mText.deleteSelection(mInputState.selection);
 
 	if (mPerformFormattingType == PerformFormattingType::Incremental) {
@@ -267,17 +830,30 @@ void TextOperations::deleteSelection(const RenderViewPort& viewPort, const TextS
 			getIncrementalFormattingInputState(),
 			textSelection,
 			deleteData);
-	} else {
-		updateFormattedText(viewPort);
 	}
+
+	std::size_t numDeletedLines = 0;
+	if (textSelection.startLine != textSelection.endLine) {
+		numDeletedLines = deleteData.endDeleteLineIndex + 1 - deleteData.startDeleteLineIndex;
+	}
+
+	updateLongLines(textSelection.startLine, numOldLongLines, numOldLines - numDeletedLines);
+
+	updateEditedLines(textSelection.startLine, numOldLines, numOldLines - numDeletedLines);
+
+	updateFormattedText(viewPort);
 }
 
 void TextOperations::deleteCharacter(const RenderViewPort& viewPort, std::size_t charIndex) {
+	auto numOldLongLines = countLongLines((std::size_t)mInputState.caretLineIndex, 1);
 	mText.deleteAt((std::size_t)mInputState.caretLineIndex, charIndex);
+	updateLongLines((std::size_t)mInputState.caretLineIndex, numOldLongLines, 1);
 
 	if (mPerformFormattingType == PerformFormattingType::Incremental) {
 		incrementalFormattedText()->deleteCharacter(getIncrementalFormattingInputState());
-	} else {
-		updateFormattedText(viewPort);
 	}
+
+	updateEditedLines((std::size_t)mInputState.caretLineIndex, 1, 1);
+
+	updateFormattedText(viewPort);
 }
\ No newline at end of file
@@ -8,6 +8,12 @@
 #include "../rendering/textmetrics.h"
 #include "../text/textformatter.h"
 #include "../text/incrementalformattedtext.h"
+#include "../text/wrappedformattedtext.h"
+#include "../text/foldedformattedtext.h"
+#include "../text/foldindex.h"
+#include "../text/formattedlinecache.h"
+#include "../text/bracketindex.h"
+#include "../text/symbolindex.h"
 
 enum class PerformFormattingType : std::uint32_t;
 struct InputState;
@@ -20,9 +26,12 @@ using LineAndOffset = std::pair<std::size_t, std::int64_t>;
 class TextOperations {
 private:
 	PerformFormattingType mPerformFormattingType;
+	bool mAdaptiveFormatting = false;
+	double mFormattingCostPerLine = 0.0;
+	std::size_t mNumLongLines = 0;
 
 	Font& mFont;
-	TextFormatter mTextFormatter;
+	std::unique_ptr<TextFormatter> mTextFormatter;
 	const RenderStyle& mRenderStyle;
 
 	std::size_t mTextVersion = 0;
@@ -30,8 +39,22 @@ private:
 
 	std::unique_ptr<BaseFormattedText> mFormattedText;
 
+	FoldIndex mFoldIndex;
+	FoldedFormattedText mFoldedText;
+
+	std::size_t mLayoutTextVersion = 0;
+	std::size_t mLayoutFoldVersion = 0;
+	WrappedFormattedText mWrappedText;
+
 	RenderViewPort mLastViewPort;
 	bool mViewMoved = false;
+	FormattedLineCache mPartialLineCache;
+	BracketIndex mBracketIndex;
+	SymbolIndex mSymbolIndex;
+	std::size_t mNumSymbolIndexSlices = 0;
+
+	std::int64_t mFormattingBudget = 4000;
+	std::size_t mFormattingWindowSize = 0;
 
 	InputState& mInputState;
 
@@ -45,11 +68,96 @@ private:
 	 */
 	IncrementalFormattedText* incrementalFormattedText();
 
+	/**
+	 * Updates the word wrap layout of the formatted text, and splits the lines around the view into rows
+	 * @param viewPort The view port
+	 * @param formatted Indicates if the text was formatted
+	 */
+	void updateLayout(const RenderViewPort& viewPort, bool formatted);
+
+	/**
+	 * Updates the word wrap layout after the given lines have been incrementally reformatted
+	 * @param lineIndex The index of the first changed line
+	 * @param numOldLines The number of lines before the change
+	 * @param numNewLines The number of lines after the change
+	 */
+	void updateLayoutLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines);
+
+	/**
+	 * Indexes the symbols of the lines that have not been indexed yet, within the formatting budget
+	 * @return True if lines were indexed
+	 */
+	bool updateSymbolIndex();
+
+	/**
+	 * Updates the word wrap layout and the indices after the given lines have been incrementally reformatted,
+	 * including the lines reformatted beyond them by the edit
+	 * @param lineIndex The index of the first changed line
+	 * @param numOldLines The number of lines before the change
+	 * @param numNewLines The number of lines after the change
+	 */
+	void updateReformattedLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines);
+
+	/**
+	 * Updates the folds, and the incremental formatting state, after the given lines have been edited
+	 * @param lineIndex The index of the first edited line
+	 * @param numOldLines The number of lines before the edit
+	 * @param numNewLines The number of lines after the edit
+	 */
+	void updateEditedLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines);
+
+	/**
+	 * Finds the region that can be folded at the given line. This is a block of brackets, a block comment or an
+	 * indented block after a line ending with a colon.
+	 * @param lineIndex The index of the header line
+	 * @param lastLineIndex The index of the last line to hide
+	 * @return True if there is a region with lines to hide
+	 */
+	bool findFoldRegion(std::size_t lineIndex, std::size_t& lastLineIndex);
+
 	/**
 	 * Returns the number of lines in the text
 	 */
 	std::size_t numLines();
 
+	/**
+	 * Records the measured cost of formatting
+	 * @param numFormattedLines The number of formatted lines
+	 * @param durationMicroseconds The time it took in microseconds
+	 */
+	void addFormattingCost(std::size_t numFormattedLines, std::int64_t durationMicroseconds);
+
+	/**
+	 * Measures the formatting cost and counts the long lines of the text, which are used to select the initial strategy
+	 */
+	void measureText();
+
+	/**
+	 * Returns the number of the given lines that are too long for incremental formatting
+	 * @param lineIndex The index of the first line
+	 * @param count The number of lines
+	 */
+	std::size_t countLongLines(std::size_t lineIndex, std::size_t count) const;
+
+	/**
+	 * Updates the number of long lines after lines have been replaced
+	 * @param lineIndex The index of the first line
+	 * @param numOldLongLines The number of long lines among the replaced lines
+	 * @param numNewLines The number of new lines
+	 */
+	void updateLongLines(std::size_t lineIndex, std::size_t numOldLongLines, std::size_t numNewLines);
+
+	/**
+	 * Selects the cheapest formatting strategy for the text based on the measured formatting cost
+	 */
+	PerformFormattingType selectFormattingType() const;
+
+	/**
+	 * Switches the formatting strategy if adaptive formatting is used and a cheaper strategy exists.
+	 * The caret and view are kept as they are part of the input state.
+	 */
+	void updateFormattingType();
+
 	/**
 	 * Performs partial formatting at the given position
 	 * @param viewPort The view port
@@ -69,16 +177,17 @@ private:
 public:
 	/**
 	 * Creates new text operations for the given text
-	 * @param performFormattingType How the formatting will be performed
+	 * @param performFormattingType How the formatting will be performed. Adaptive selects and switches the
+	 * strategy at runtime.
 	 * @param font The font
-	 * @param formattingRules The formatting rules
+	 * @param textFormatter The text formatter
 	 * @param renderStyle The render style
 	 * @param text The input text
 	 * @param inputState The input state
 	 */
 	TextOperations(PerformFormattingType performFormattingType,
 				   Font& font,
-				   std::unique_ptr<FormatterRules> formattingRules,
+				   std::unique_ptr<TextFormatter> textFormatter,
 				   const RenderStyle& renderStyle,
 				   Text& text,
 				   InputState& inputState);
@@ -90,16 +199,77 @@ public:
 	 */
 	static float getLineNumberSpacing(const Font& font, const Text& text);
 
+	/**
+	 * Returns the text formatter
+	 */
+	const TextFormatter& textFormatter() const;
+
 	/**
 	 * Returns the formatted text
 	 */
-	BaseFormattedText* formattedText() const;
+	const BaseFormattedText* formattedText() const;
+
+	/**
+	 * Returns the folds
+	 */
+	const FoldIndex& foldIndex() const;
+
+	/**
+	 * Returns the bracket index, or null if the text is partially formatted
+	 */
+	const BracketIndex* bracketIndex() const;
+
+	/**
+	 * Returns the symbol index, or null if the text is partially formatted. The index can cover only the first lines
+	 * while it is being built.
+	 */
+	const SymbolIndex* symbolIndex() const;
+
+	/**
+	 * Returns the current formatting strategy
+	 */
+	PerformFormattingType performFormattingType() const;
+
+	/**
+	 * Indicates if the formatted text is word wrapped
+	 */
+	bool isWordWrapped() const;
+
+	/**
+	 * Returns the number of visual lines, which differs from the number of text lines when word wrapped
+	 */
+	std::size_t numVisualLines() const;
 
 	/**
 	 * Marks that the view moved
 	 */
 	void viewMoved();
 
+	/**
+	 * Sets the time budget for formatting in each frame
+	 * @param budgetMicroseconds The budget in microseconds
+	 */
+	void setFormattingBudget(std::int64_t budgetMicroseconds);
+
+	/**
+	 * Sets the number of lines around the view and caret that keeps their formatting in incremental mode
+	 * @param windowSize The number of lines on each side, zero keeps all lines
+	 */
+	void setFormattingWindowSize(std::size_t windowSize);
+
+	/**
+	 * Continues formatting that did not complete within the budget, evicts formatting outside the window and continues
+	 * building the symbol index
+	 * @param viewPort The view port
+	 * @return True if lines were formatted or indexed, which can change what is shown
+	 */
+	bool updateFormatting(const RenderViewPort& viewPort);
+
+	/**
+	 * Indicates if there is formatting or indexing left for later frames
+	 */
+	bool hasPendingFormatting() const;
+
 	/**
 	 * Updates the formatted text
 	 * @param viewPort The view port
@@ -120,6 +290,19 @@ public:
 	 */
 	void requireSelectionFormatted(const RenderViewPort& viewPort, const TextSelection& selection);
 
+	/**
+	 * Folds the region at the line of the caret, or unfolds it if already folded
+	 * @param viewPort The view port
+	 */
+	void toggleFold(const RenderViewPort& viewPort);
+
+	/**
+	 * Moves the caret to the likely definition of the identifier at the caret, unfolding it if hidden
+	 * @param viewPort The view port
+	 * @return True if a definition was found
+	 */
+	bool goToDefinition(const RenderViewPort& viewPort);
+
 	/**
 	 * Inserts the given character
 	 * @param viewPort The view port
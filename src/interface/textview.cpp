@@ -1,5 +1,6 @@
 #include "textview.h"
 #include "../rendering/textrender.h"
+#include "../rendering/texturerender.h"
 #include "../rendering/renderstyle.h"
 #include "../rendering/renderviewport.h"
 #include "../rendering/font.h"
@@ -8,6 +9,7 @@
 #include "inputmanager.h"
 #include "../windowstate.h"
 #include "../rendering/common/glhelpers.h"
+#include "../rendering/common/framebuffer.h"
 #include "../rendering/common/shadercompiler.h"
 #include "../text/incrementalformattedtext.h"
 
@@ -36,7 +38,7 @@ glm::vec2 InputState::getDrawPosition(const RenderStyle& renderStyle) const {
 
 TextView::TextView(GLFWwindow* window,
 				   Font& font,
-				   std::unique_ptr<FormatterRules> rules,
+				   std::unique_ptr<TextFormatter> textFormatter,
 				   const RenderViewPort& viewPort,
 				   const RenderStyle& renderStyle,
 				   Text& text)
@@ -46,9 +48,9 @@ TextView::TextView(GLFWwindow* window,
 	  mTextMetrics(mFont, mRenderStyle),
 	  mViewPort(viewPort),
 	  mTextOperations(
-		PerformFormattingType::Incremental,
+		PerformFormattingType::Adaptive,
 	  	font,
-	  	std::move(rules),
+	  	std::move(textFormatter),
 	  	renderStyle,
 	  	text,
 	  	mInputState),
@@ -115,6 +117,10 @@ TextView::TextView(GLFWwindow* window,
 	mKeyboardCommands.push_back({ GLFW_KEY_DELETE, KeyModifier::None, [&]() { deleteAction(); } });
 	mKeyboardCommands.push_back({ GLFW_KEY_ENTER, KeyModifier::None, [&]() { insertLine(); } });
 	mKeyboardCommands.push_back({ GLFW_KEY_V, KeyModifier::Control, [&]() { paste(); } });
+	mKeyboardCommands.push_back({ GLFW_KEY_K, KeyModifier::Control, [&]() { toggleFold(); } });
+	mKeyboardCommands.push_back({ GLFW_KEY_F12, KeyModifier::None, [&]() { goToDefinition(); } });
+
+	mWordCompletion.setKeywords(mTextOperations.textFormatter().keywords());
 
 	mCharTriggers['"'] = [&]() { insertAction('"'); };
 	mCharTriggers['\''] = [&]() { insertAction('\''); };
@@ -124,8 +130,7 @@ TextView::TextView(GLFWwindow* window,
 }
 
 const FormattedLine& TextView::currentLine() const {
-	auto lineIndex = (std::size_t)mInputState.caretLineIndex;
-	return mTextOperations.formattedText()->getLine(lineIndex);
+	return mTextOperations.formattedText()->getLine(currentVisualLineIndex());
 }
 
 //std::size_t TextView::currentLineNumber() const {
@@ -163,6 +168,16 @@ std::size_t TextView::numLines() {
 	return mText.numLines();
 }
 
+std::size_t TextView::currentVisualLineIndex() const {
+	return mTextOperations.formattedText()->getVisualLineIndex(
+		(std::size_t)mInputState.caretLineIndex,
+		(std::size_t)mInputState.caretCharIndex);
+}
+
+std::size_t TextView::numVisualLines() const {
+	return mTextOperations.numVisualLines();
+}
+
 void TextView::moveCaretX(std::int64_t diff) {
 	std::int64_t diffSign = 0;
 	if (diff > 0) {
@@ -236,19 +251,19 @@ void TextView::clampViewPositionY(float caretScreenPositionY) {
 
 	if (!(-mInputState.viewPosition.y + viewPort.height >= -caretScreenPositionY
 		  && -mInputState.viewPosition.y <= -caretScreenPositionY)) {
-		mInputState.viewPosition.y = -mInputState.caretLineIndex * lineHeight + viewPort.height / 2.0f;
+		mInputState.viewPosition.y = -(std::int64_t)currentVisualLineIndex() * lineHeight + viewPort.height / 2.0f;
 	}
 
 	if (mInputState.viewPosition.y > 0) {
 		mInputState.viewPosition.y = 0;
 	}
 
-	auto maxViewHeight = std::ceil((numLines() * mFont.lineHeight() - viewPort.height) / mFont.lineHeight()) * mFont.lineHeight();
+	auto maxViewHeight = std::ceil((numVisualLines() * mFont.lineHeight() - viewPort.height) / mFont.lineHeight()) * mFont.lineHeight();
 	if (mInputState.viewPosition.y < -maxViewHeight) {
 		mInputState.viewPosition.y = -maxViewHeight;
 	}
 
-	auto contentHeight = numLines() * lineHeight;
+	auto contentHeight = numVisualLines() * lineHeight;
 	if (contentHeight < viewPort.height) {
 		mInputState.viewPosition.y = 0;
 	}
@@ -261,18 +276,26 @@ void TextView::moveCaretY(std::int64_t diff) {
 	auto viewPort = getTextViewPort();
 	const auto lineHeight = mFont.lineHeight();
 
-	mInputState.caretLineIndex += diff;
+	if (mTextOperations.isWordWrapped()) {
+		diff = moveCaretVisualY(diff);
+	} else {
+		// Folded lines are skipped by moving between the visible lines
+		auto visualLineIndex = (std::int64_t)currentVisualLineIndex() + diff;
 
-	if (mInputState.caretLineIndex >= (std::int64_t)numLines()) {
-		mInputState.caretLineIndex = (std::int64_t)numLines() - 1;
-		diff = 0;
-	}
+		if (visualLineIndex >= (std::int64_t)numVisualLines()) {
+			visualLineIndex = (std::int64_t)numVisualLines() - 1;
+			diff = 0;
+		}
+
+		if (visualLineIndex < 0) {
+			visualLineIndex = 0;
+		}
 
-	if (mInputState.caretLineIndex < 0) {
-		mInputState.caretLineIndex = 0;
+		mInputState.caretLineIndex = (std::int64_t)mTextOperations.formattedText()->getTextLineIndex(
+			(std::size_t)visualLineIndex);
 	}
 
-	auto caretScreenPositionY = -std::max(mInputState.caretLineIndex + diff, 0L) * lineHeight;
+	auto caretScreenPositionY = -std::max((std::int64_t)currentVisualLineIndex() + diff, 0L) * lineHeight;
 	if (caretScreenPositionY < mInputState.viewPosition.y - viewPort.height) {
 		mInputState.viewPosition.y -= diff * lineHeight;
 	}
@@ -290,6 +313,33 @@ void TextView::moveCaretY(std::int64_t diff) {
 	}
 }
 
+std::int64_t TextView::moveCaretVisualY(std::int64_t diff) {
+	auto formattedText = mTextOperations.formattedText();
+	auto column = (std::size_t)mInputState.caretCharIndex - currentLine().offsetFromTextLine;
+
+	auto visualLineIndex = (std::int64_t)currentVisualLineIndex() + diff;
+	if (visualLineIndex >= (std::int64_t)numVisualLines()) {
+		visualLineIndex = (std::int64_t)numVisualLines() - 1;
+		diff = 0;
+	}
+
+	if (visualLineIndex < 0) {
+		visualLineIndex = 0;
+	}
+
+	auto& row = formattedText->getLine((std::size_t)visualLineIndex);
+	mInputState.caretLineIndex = (std::int64_t)formattedText->getTextLineIndex((std::size_t)visualLineIndex);
+
+	// The position after the last character of a row is the start of the next row, except for the last row
+	auto rowEnd = row.offsetFromTextLine + row.length();
+	if (rowEnd < currentLineLength() && rowEnd > row.offsetFromTextLine) {
+		rowEnd--;
+	}
+
+	mInputState.caretCharIndex = (std::int64_t)std::min(row.offsetFromTextLine + column, rowEnd);
+	return diff;
+}
+
 void TextView::moveViewY(float diff) {
 	auto viewPort = getTextViewPort();
 	mTextOperations.viewMoved();
@@ -299,12 +349,12 @@ void TextView::moveViewY(float diff) {
 		mInputState.viewPosition.y = 0;
 	}
 
-	auto maxViewHeight = std::ceil((numLines() * mFont.lineHeight() - viewPort.height) / mFont.lineHeight()) * mFont.lineHeight();
+	auto maxViewHeight = std::ceil((numVisualLines() * mFont.lineHeight() - viewPort.height) / mFont.lineHeight()) * mFont.lineHeight();
 	if (mInputState.viewPosition.y < -maxViewHeight) {
 		mInputState.viewPosition.y = -maxViewHeight;
 	}
 
-	auto contentHeight = numLines() * mFont.lineHeight();
+	auto contentHeight = numVisualLines() * mFont.lineHeight();
 	if (contentHeight < viewPort.height) {
 		mInputState.viewPosition.y = 0;
 	}
@@ -328,11 +378,11 @@ void TextView::updateViewMovement(const WindowState& windowState) {
 	if (mInputManager.isKeyPressed(GLFW_KEY_HOME)) {
 		mDrawCaret = true;
 		mLastCaretUpdate = Helpers::timeNow();
-		moveCaretY(-mInputState.caretLineIndex);
+		moveCaretY(-(std::int64_t)currentVisualLineIndex());
 	} else if (mInputManager.isKeyPressed(GLFW_KEY_END)) {
 		mDrawCaret = true;
 		mLastCaretUpdate = Helpers::timeNow();
-		moveCaretY((std::int64_t)numLines() - mInputState.caretLineIndex);
+		moveCaretY((std::int64_t)numVisualLines() - (std::int64_t)currentVisualLineIndex());
 	}
 
 	int caretPositionDiffY = 0;
@@ -372,6 +422,8 @@ void TextView::insertCharacter(Char character, bool moveCaret) {
 	if (moveCaret) {
 		moveCaretX(1);
 	}
+
+	mCompletionRequested = SymbolIndex::isIdentifierCharacter(character);
 }
 
 void TextView::insertAction(Char character, bool moveCaret) {
@@ -411,6 +463,22 @@ void TextView::paste() {
 	}
 }
 
+void TextView::toggleFold() {
+	mTextOperations.toggleFold(getTextViewPort());
+	mInputState.caretCharIndex = std::min((std::size_t)mInputState.caretCharIndex, currentLineLength());
+	moveViewY(0.0f);
+}
+
+void TextView::goToDefinition() {
+	if (!mTextOperations.goToDefinition(getTextViewPort())) {
+		return;
+	}
+
+	mInputState.showSelection = false;
+	clampViewPositionY(-(float)currentVisualLineIndex() * mFont.lineHeight());
+	mInputState.viewPosition.x = 0;
+}
+
 void TextView::deleteLine(Text::DeleteLineMode mode) {
 	if (mode == Text::DeleteLineMode::Start && mInputState.caretLineIndex == 0) {
 		return;
@@ -434,7 +502,7 @@ void TextView::deleteSelection() {
 
 	mInputState.showSelection = false;
 
-	auto caretScreenPositionY = -mInputState.caretLineIndex * mFont.lineHeight();
+	auto caretScreenPositionY = -(std::int64_t)currentVisualLineIndex() * mFont.lineHeight();
 	clampViewPositionY(caretScreenPositionY);
 }
 
@@ -448,6 +516,7 @@ void TextView::backspaceAction() {
 		if (charIndex >= 0) {
 			deleteCharacter(charIndex);
 			moveCaretX(-1);
+			mCompletionRequested = !mCompletions.empty();
 		} else {
 			deleteLine(Text::DeleteLineMode::Start);
 		}
@@ -504,10 +573,12 @@ void TextView::updateEditing(const WindowState& windowState) {
 	}
 }
 
-std::pair<std::int64_t, std::int64_t> TextView::getMouseTextPosition() {
+std::pair<std::int64_t, std::int64_t> TextView::getMouseTextPosition(const WindowState& windowState) {
 	double mouseX;
 	double mouseY;
 	glfwGetCursorPos(mWindow, &mouseX, &mouseY);
+	mouseX /= windowState.zoom();
+	mouseY /= windowState.zoom();
 
 	auto drawPosition = mInputState.getDrawPosition(mRenderStyle);
 	auto textY = (std::int64_t)std::floor((-drawPosition.y + mouseY) / mFont.lineHeight());
@@ -517,23 +588,26 @@ std::pair<std::int64_t, std::int64_t> TextView::getMouseTextPosition() {
 		textY = 0;
 	}
 
-	if (textY >= (std::int64_t)numLines()) {
-		textY = numLines() - 1;
+	if (textY >= (std::int64_t)numVisualLines()) {
+		textY = numVisualLines() - 1;
 	}
 
-	mTextOperations.requireLineFormatted(getTextViewPort(), (std::size_t)textY);
+	auto formattedText = mTextOperations.formattedText();
+	auto lineIndex = formattedText->getTextLineIndex((std::size_t)textY);
+	mTextOperations.requireLineFormatted(getTextViewPort(), lineIndex);
 
-	auto textX = (std::int64_t)mTextMetrics.getCharIndexFromScreenPosition(
-		*mTextOperations.formattedText(),
-		mTextOperations.formattedText()->getLine((std::size_t)textY).number,
-		(float)relativeMousePositionX);
+	auto& row = formattedText->getLine((std::size_t)textY);
+	auto textX = (std::int64_t)(row.offsetFromTextLine + mTextMetrics.getCharIndexFromScreenPosition(
+		*formattedText,
+		(std::size_t)textY,
+		(float)relativeMousePositionX));
 
-	return std::make_pair(textX, textY);
+	return std::make_pair(textX, (std::int64_t)lineIndex);
 }
 
 void TextView::updateTextSelection(const WindowState& windowState) {
 	if (glfwGetMouseButton(mWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
-		auto mouseTextPosition = getMouseTextPosition();
+		auto mouseTextPosition = getMouseTextPosition(windowState);
 
 		if (mSelectionStarted) {
 			mPotentialSelection.endChar = (std::size_t)mouseTextPosition.first;
@@ -544,12 +618,12 @@ void TextView::updateTextSelection(const WindowState& windowState) {
 			glfwGetCursorPos(mWindow, &mouseX, &mouseY);
 
 			if (mouseY <= 0) {
-				moveViewY((float)(-mouseY));
+				moveViewY((float)(-mouseY / windowState.zoom()));
 				mTextOperations.updateFormattedText(getTextViewPort());
 			}
 
 			if (mouseY >= windowState.height()) {
-				moveViewY((float)(windowState.height() - mouseY));
+				moveViewY((float)((windowState.height() - mouseY) / windowState.zoom()));
 				mTextOperations.updateFormattedText(getTextViewPort());
 			}
 
@@ -589,7 +663,7 @@ void TextView::updateMouseMovement(const WindowState& windowState) {
 	if (windowState.isLeftMouseButtonPressed()) {
 		mTextOperations.updateFormattedText(getTextViewPort());
 
-		auto mouseTextPosition = getMouseTextPosition();
+		auto mouseTextPosition = getMouseTextPosition(windowState);
 		mInputState.caretCharIndex = mouseTextPosition.first;
 		mInputState.caretLineIndex = mouseTextPosition.second;
 
@@ -603,10 +677,105 @@ void TextView::updateMouseMovement(const WindowState& windowState) {
 	updateTextSelection(windowState);
 }
 
+void TextView::findCompletions() {
+	auto t0 = Helpers::timeNow();
+	auto& line = mText.getLine((std::size_t)mInputState.caretLineIndex);
+	auto caretCharIndex = (std::size_t)mInputState.caretCharIndex;
+	auto startCharIndex = WordCompletion::findWordStart(line, caretCharIndex);
+
+	mCompletionStart = { (std::size_t)mInputState.caretLineIndex, startCharIndex };
+	mCompletionCaret = { (std::size_t)mInputState.caretLineIndex, caretCharIndex };
+	mSelectedCompletion = 0;
+	mWordCompletion.complete(
+		mTextOperations.symbolIndex(),
+		line.substr(startCharIndex, caretCharIndex - startCharIndex),
+		MAX_COMPLETIONS,
+		mCompletions);
+
+	if (!mCompletions.empty()) {
+		std::cout
+			<< "Found completions (count = " << mCompletions.size() << ") in "
+			<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
+			<< std::endl;
+	}
+}
+
+void TextView::closeCompletions() {
+	mCompletions.clear();
+	mSelectedCompletion = 0;
+}
+
+void TextView::updateCompletions() {
+	if (mCompletionRequested) {
+		mCompletionRequested = false;
+		findCompletions();
+	} else if (!mCompletions.empty()
+			   && ((std::size_t)mInputState.caretLineIndex != mCompletionCaret.lineIndex
+				   || (std::size_t)mInputState.caretCharIndex != mCompletionCaret.charIndex)) {
+		closeCompletions();
+	}
+}
+
+bool TextView::updateCompletionInput() {
+	if (mCompletions.empty()) {
+		return false;
+	}
+
+	if (mInputManager.isKeyPressed(GLFW_KEY_UP)) {
+		mSelectedCompletion = (mSelectedCompletion + mCompletions.size() - 1) % mCompletions.size();
+		return true;
+	}
+
+	if (mInputManager.isKeyPressed(GLFW_KEY_DOWN)) {
+		mSelectedCompletion = (mSelectedCompletion + 1) % mCompletions.size();
+		return true;
+	}
+
+	if (mInputManager.isKeyPressed(GLFW_KEY_TAB) || mInputManager.isKeyPressed(GLFW_KEY_ENTER)) {
+		acceptCompletion();
+		return true;
+	}
+
+	if (mInputManager.isKeyPressed(GLFW_KEY_ESCAPE)) {
+		closeCompletions();
+		return true;
+	}
+
+	return false;
+}
+
+void TextView::acceptCompletion() {
+	// The completions start with the word before the caret, which means that only the rest is inserted
+	auto prefixLength = mCompletionCaret.charIndex - mCompletionStart.charIndex;
+	auto rest = mCompletions[mSelectedCompletion].word.substr(prefixLength);
+	closeCompletions();
+
+	if (!rest.empty()) {
+		mInputState.showSelection = false;
+		auto diffCaret = mTextOperations.paste(getTextViewPort(), rest);
+		moveCaretX(diffCaret.first);
+	}
+}
+
 void TextView::updateInput(const WindowState& windowState) {
-	updateViewMovement(windowState);
-	updateEditing(windowState);
+	// The keys used by the completions are not passed on, e.g. enter does not also insert a line
+	if (!updateCompletionInput()) {
+		updateViewMovement(windowState);
+		updateEditing(windowState);
+	}
+
 	updateMouseMovement(windowState);
+	updateCompletions();
+
+	// Handled keys, entered characters, scrolling and mouse selection can all change what is shown
+	if (mInputManager.hasPressedKeys()
+		|| !windowState.inputCharacters().empty()
+		|| windowState.hasScrolled()
+		|| windowState.isLeftMouseButtonPressed()
+		|| glfwGetMouseButton(mWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+		mIsDamaged = true;
+	}
+
 	mInputManager.postUpdate();
 }
 
@@ -616,14 +785,57 @@ Text& TextView::text() {
 
 void TextView::update(const WindowState& windowState) {
 	auto timeNow = Helpers::timeNow();
-	if (Helpers::durationMilliseconds(timeNow, mLastCaretUpdate) >= 500) {
+	if (Helpers::durationMilliseconds(timeNow, mLastCaretUpdate) >= CARET_BLINK_INTERVAL) {
 		mDrawCaret = !mDrawCaret;
 		mLastCaretUpdate = timeNow;
+		mIsDamaged = true;
+	}
+
+	if (mSpellChecker != nullptr && mSpellChecker->hasNewResults()) {
+		mIsDamaged = true;
 	}
 
 	updateInput(windowState);
 }
 
+bool TextView::isDamaged() const {
+	return mIsDamaged;
+}
+
+double TextView::timeUntilUpdate() const {
+	if (mTextOperations.hasPendingFormatting()) {
+		return 0.0;
+	}
+
+	auto timeUntilBlink = CARET_BLINK_INTERVAL - Helpers::durationMilliseconds(Helpers::timeNow(), mLastCaretUpdate);
+	if (mInputManager.isAnyInputDown()) {
+		return std::min((double)INPUT_POLL_INTERVAL, std::max(timeUntilBlink, 0.0));
+	}
+
+	return std::max(timeUntilBlink, 0.0);
+}
+
+void TextView::setFormattingBudget(std::int64_t budgetMicroseconds) {
+	mTextOperations.setFormattingBudget(budgetMicroseconds);
+}
+
+void TextView::setFormattingWindowSize(std::size_t windowSize) {
+	mTextOperations.setFormattingWindowSize(windowSize);
+}
+
+void TextView::setSpellingDictionary(const std::string& fileName) {
+	if (mTextOperations.textFormatter().mode() == FormatMode::Text) {
+		// Wakes up the main loop to show the misspellings of the checked lines
+		mSpellChecker = std::make_unique<SpellChecker>(fileName, []() { glfwPostEmptyEvent(); });
+	}
+}
+
+void TextView::updateFormatting() {
+	if (mTextOperations.updateFormatting(getTextViewPort())) {
+		mIsDamaged = true;
+	}
+}
+
 RenderViewPort TextView::getTextViewPort() const {
 	auto viewPort = mViewPort;
 	viewPort.width -= mRenderStyle.sideSpacing * 2;
@@ -632,30 +844,276 @@ RenderViewPort TextView::getTextViewPort() const {
 	return viewPort;
 }
 
-void TextView::render(const WindowState& windowState, TextRender& textRender) {
+std::pair<std::size_t, std::size_t> TextView::getViewTextLines(const BaseFormattedText& formattedText,
+															  glm::vec2 drawPosition) const {
 	auto viewPort = getTextViewPort();
-	auto lineNumberSpacing = TextOperations::getLineNumberSpacing(mFont, mText);
+	auto lastVisualLineIndex = formattedText.numLines() - 1;
+	auto viewStartLineIndex = (std::size_t)std::max(std::floor(-drawPosition.y / mFont.lineHeight()), 0.0f);
+	auto viewEndLineIndex = viewStartLineIndex + (std::size_t)std::ceil(viewPort.height / mFont.lineHeight());
+	return {
+		formattedText.getTextLineIndex(std::min(viewStartLineIndex, lastVisualLineIndex)),
+		formattedText.getTextLineIndex(std::min(viewEndLineIndex, lastVisualLineIndex))
+	};
+}
 
-//	auto startTime = std::chrono::system_clock::now();
-	auto drawPosition = mInputState.getDrawPosition(mRenderStyle);
-	mTextOperations.updateFormattedText(viewPort);
-	auto formattedText = mTextOperations.formattedText();
+void TextView::renderSymbolOccurrences(TextRender& textRender,
+									   const BaseFormattedText& formattedText,
+									   glm::vec2 drawPosition,
+									   float lineNumberSpacing) {
+	auto symbolIndex = mTextOperations.symbolIndex();
+	if (symbolIndex == nullptr || formattedText.numLines() == 0) {
+		return;
+	}
+
+	SymbolPosition start;
+	auto symbol = symbolIndex->findSymbolAt(
+		{ (std::size_t)mInputState.caretLineIndex, (std::size_t)mInputState.caretCharIndex },
+		start);
+	if (symbol == SymbolIndex::NO_SYMBOL) {
+		return;
+	}
+
+	// Only the visible lines are searched, where the chunks without the identifier are skipped
+	auto viewTextLines = getViewTextLines(formattedText, drawPosition);
+	symbolIndex->findOccurrences(symbol, viewTextLines.first, viewTextLines.second, mSymbolOccurrences);
+
+	auto& foldIndex = mTextOperations.foldIndex();
+	mSymbolOccurrences.erase(
+		std::remove_if(
+			mSymbolOccurrences.begin(),
+			mSymbolOccurrences.end(),
+			[&](const SymbolPosition& position) { return foldIndex.isHidden(position.lineIndex); }),
+		mSymbolOccurrences.end());
+
+	// A single occurrence is the identifier itself
+	if (mSymbolOccurrences.size() > 1) {
+		textRender.renderSymbolOccurrences(
+			mFont,
+			mRenderStyle,
+			mTextMetrics,
+			formattedText,
+			{ lineNumberSpacing + mRenderStyle.sideSpacing, mRenderStyle.topSpacing },
+			mInputState,
+			symbolIndex->symbolName(symbol),
+			mSymbolOccurrences);
+	}
+}
+
+void TextView::renderMisspellings(const WindowState& windowState,
+								  const BaseFormattedText& formattedText,
+								  glm::vec2 drawPosition,
+								  float lineNumberSpacing) {
+	if (mSpellChecker == nullptr || formattedText.numLines() == 0) {
+		return;
+	}
+
+	// Lines that have not been checked yet are checked in the background and underlined in a later frame
+	auto viewTextLines = getViewTextLines(formattedText, drawPosition);
+	mSpellChecker->findMisspellings(mText, viewTextLines.first, viewTextLines.second, mMisspellings);
+
+	// The word that is being typed is not marked until it is complete
+	auto& foldIndex = mTextOperations.foldIndex();
+	mMisspellings.erase(
+		std::remove_if(
+			mMisspellings.begin(),
+			mMisspellings.end(),
+			[&](const Misspelling& misspelling) {
+				return foldIndex.isHidden(misspelling.lineIndex)
+					   || (misspelling.lineIndex == (std::size_t)mInputState.caretLineIndex
+						   && misspelling.charIndex + misspelling.length == (std::size_t)mInputState.caretCharIndex);
+			}),
+		mMisspellings.end());
+
+	mUnderlineRender.render(
+		windowState,
+		mFont,
+		mTextMetrics,
+		formattedText,
+		{ drawPosition.x + lineNumberSpacing, drawPosition.y },
+		mMisspellings,
+		mRenderStyle.misspellingColor);
+}
+
+bool TextView::canScrollTextLayer(const TextLayerState& current, const TextLayerState& next) const {
+	auto offsetY = next.rowPosition - current.rowPosition;
+	if (current.drawPosition.x != next.drawPosition.x
+		|| current.zoom != next.zoom
+		|| current.lineNumberSpacing != next.lineNumberSpacing
+		|| current.numLines != next.numLines
+		|| current.fontVersion != next.fontVersion
+		|| std::abs(offsetY) >= getTextViewPort().height * next.zoom) {
+		return false;
+	}
+
+	auto startLineIndex = std::max(current.startLineIndex, next.startLineIndex);
+	auto endLineIndex = std::min(
+		current.startLineIndex + current.lines.size(),
+		next.startLineIndex + next.lines.size());
+
+	for (auto lineIndex = startLineIndex; lineIndex < endLineIndex; lineIndex++) {
+		if (current.lines[lineIndex - current.startLineIndex] != next.lines[lineIndex - next.startLineIndex]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TextView::renderTextLayerRows(TextRender& textRender,
+								   const BaseFormattedText& formattedText,
+								   FrameBuffer& textLayer,
+								   int top,
+								   int bottom,
+								   glm::vec2 drawPosition,
+								   float lineNumberSpacing,
+								   float zoom) {
+	textLayer.bind();
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, textLayer.height() - bottom, textLayer.width(), bottom - top);
+	glClearColor(mRenderStyle.backgroundColor.r, mRenderStyle.backgroundColor.g, mRenderStyle.backgroundColor.b, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// The lines that reach into the rows are rendered and clipped, where a glyph can extend a line above and below
+	// its line. The view port is never extended beyond the view, which keeps the same lines as rendering all rows.
+	auto viewPort = getTextViewPort();
+	auto margin = 2.0f * mFont.lineHeight();
+	auto rowsTop = std::max(viewPort.top(), top / zoom - margin);
+	auto rowsBottom = std::min(viewPort.bottom(), bottom / zoom + margin);
+	RenderViewPort rowsViewPort { glm::vec2(viewPort.position.x, rowsTop), viewPort.width, rowsBottom - rowsTop };
 
 	textRender.renderLineNumbers(
 		mFont,
 		mRenderStyle,
-		viewPort,
-		*formattedText,
+		rowsViewPort,
+		formattedText,
 		drawPosition);
 
 	textRender.render(
 		mFont,
 		mRenderStyle,
-		viewPort,
-		*formattedText,
+		rowsViewPort,
+		formattedText,
 		drawPosition + glm::vec2(lineNumberSpacing, 0.0f),
 		0.0f);
 
+	glDisable(GL_SCISSOR_TEST);
+}
+
+FrameBuffer& TextView::updateTextLayer(TextRender& textRender,
+									   const BaseFormattedText& formattedText,
+									   FrameBuffer& textLayer,
+									   glm::vec2 drawPosition,
+									   float lineNumberSpacing,
+									   float zoom) {
+	if (mScrolledTextLayer == nullptr
+		|| mScrolledTextLayer->width() != textLayer.width()
+		|| mScrolledTextLayer->height() != textLayer.height()) {
+		if (mTextLayerState.textLayer == mScrolledTextLayer.get()) {
+			mTextLayerState.textLayer = nullptr;
+		}
+
+		mScrolledTextLayer = std::make_unique<FrameBuffer>(textLayer.width(), textLayer.height());
+	}
+
+	// The text is drawn at whole rows, such that scrolling moves the layer by whole rows at any zoom
+	auto& state = mNewTextLayerState;
+	state.zoom = zoom;
+	state.rowPosition = std::round(drawPosition.y * zoom);
+	drawPosition.y = state.rowPosition / zoom;
+	state.drawPosition = drawPosition;
+	state.lineNumberSpacing = lineNumberSpacing;
+	state.numLines = formattedText.numLines();
+	state.fontVersion = mFont.version();
+
+	// Includes the partially visible lines at the top and bottom
+	auto viewPort = getTextViewPort();
+	state.startLineIndex = (std::size_t)std::max(std::floor(-drawPosition.y / mFont.lineHeight()), 0.0f);
+	auto endLineIndex = std::min(
+		state.startLineIndex + (std::size_t)std::ceil(viewPort.height / mFont.lineHeight()) + 2,
+		formattedText.numLines());
+
+	state.lines.clear();
+	for (auto lineIndex = state.startLineIndex; lineIndex < endLineIndex; lineIndex++) {
+		state.lines.emplace_back(formattedText.getTextLineIndex(lineIndex), formattedText.getLine(lineIndex).version);
+	}
+
+	// The layers are swapped when scrolling, as a frame buffer cannot be copied into itself
+	auto& current = mTextLayerState;
+	auto isValid = current.textLayer == &textLayer || current.textLayer == mScrolledTextLayer.get();
+	if (isValid
+		&& state.drawPosition == current.drawPosition
+		&& state.zoom == current.zoom
+		&& state.lineNumberSpacing == current.lineNumberSpacing
+		&& state.numLines == current.numLines
+		&& state.fontVersion == current.fontVersion
+		&& state.lines == current.lines) {
+		return *current.textLayer;
+	}
+
+	if (isValid && canScrollTextLayer(current, state)) {
+		state.textLayer = current.textLayer == &textLayer ? mScrolledTextLayer.get() : &textLayer;
+		auto offsetY = (int)(state.rowPosition - current.rowPosition);
+		current.textLayer->copyTo(*state.textLayer, -offsetY);
+
+		// Besides the rows that became visible, the rows at the edges are rendered again, as the lines that are only
+		// partially visible are not rendered
+		auto margin = (int)std::ceil(2.0f * mFont.lineHeight() * zoom);
+		auto height = state.textLayer->height();
+		auto topRows = offsetY > 0 ? offsetY + margin : margin;
+		auto bottomRows = offsetY < 0 ? margin - offsetY : margin;
+
+		for (auto rows : { std::make_pair(0, std::min(topRows, height)),
+						   std::make_pair(std::max(height - bottomRows, 0), height) }) {
+			renderTextLayerRows(
+				textRender,
+				formattedText,
+				*state.textLayer,
+				rows.first,
+				rows.second,
+				drawPosition,
+				lineNumberSpacing,
+				zoom);
+		}
+	} else {
+		state.textLayer = &textLayer;
+		renderTextLayerRows(
+			textRender,
+			formattedText,
+			textLayer,
+			0,
+			textLayer.height(),
+			drawPosition,
+			lineNumberSpacing,
+			zoom);
+	}
+
+	std::swap(mTextLayerState, mNewTextLayerState);
+	return *mTextLayerState.textLayer;
+}
+
+void TextView::render(const WindowState& windowState,
+					  TextRender& textRender,
+					  FrameBuffer& textLayer,
+					  TextureRender& textureRender) {
+	mIsDamaged = false;
+	auto viewPort = getTextViewPort();
+	auto lineNumberSpacing = TextOperations::getLineNumberSpacing(mFont, mText);
+
+//	auto startTime = std::chrono::system_clock::now();
+	auto drawPosition = mInputState.getDrawPosition(mRenderStyle);
+	mTextOperations.updateFormattedText(viewPort);
+	auto formattedText = mTextOperations.formattedText();
+
+	auto& currentTextLayer = updateTextLayer(
+		textRender,
+		*formattedText,
+		textLayer,
+		drawPosition,
+		lineNumberSpacing,
+		windowState.zoom());
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	textureRender.render(currentTextLayer.textureColorBuffer());
+
 	//
 	// textRender.render(
 	// 	mFont,
@@ -665,6 +1123,8 @@ void TextView::render(const WindowState& windowState, TextRender& textRender) {
 	// 	drawPosition,
 	// 	lineNumberSpacing);
 
+	renderMisspellings(windowState, *formattedText, drawPosition, lineNumberSpacing);
+
 	if (mInputState.showSelection) {
 		mTextSelectionRender.render(
 			windowState,
@@ -678,6 +1138,30 @@ void TextView::render(const WindowState& windowState, TextRender& textRender) {
 			},
 			mInputState);
 	} else {
+		renderSymbolOccurrences(textRender, *formattedText, drawPosition, lineNumberSpacing);
+
+		// The pair at the caret is looked up every frame, which the bracket index keeps logarithmic
+		auto bracketIndex = mTextOperations.bracketIndex();
+		BracketPosition firstBracket;
+		BracketPosition secondBracket;
+		if (bracketIndex != nullptr
+			&& bracketIndex->findPairAtCaret(
+				{ (std::size_t)mInputState.caretLineIndex, (std::size_t)mInputState.caretCharIndex },
+				firstBracket,
+				secondBracket)
+			&& !mTextOperations.foldIndex().isHidden(secondBracket.lineIndex)) {
+			textRender.renderBracketPair(
+				mFont,
+				mRenderStyle,
+				mTextMetrics,
+				*formattedText,
+				{ lineNumberSpacing + mRenderStyle.sideSpacing, mRenderStyle.topSpacing },
+				mInputState,
+				*bracketIndex,
+				firstBracket,
+				secondBracket);
+		}
+
 		if (mDrawCaret) {
 			textRender.renderCaret(
 				mFont,
@@ -688,6 +1172,29 @@ void TextView::render(const WindowState& windowState, TextRender& textRender) {
 				{ lineNumberSpacing + mRenderStyle.sideSpacing, mRenderStyle.topSpacing },
 				mInputState);
 		}
+
+		if (!mCompletions.empty()) {
+			// The popup is placed below the start of the completed word
+			auto visualLineIndex = formattedText->getVisualLineIndex(
+				mCompletionStart.lineIndex,
+				mCompletionStart.charIndex);
+			auto lineOffset = mTextMetrics.calculatePositionX(
+				*formattedText,
+				visualLineIndex,
+				mCompletionStart.charIndex - formattedText->getLine(visualLineIndex).offsetFromTextLine);
+
+			mCompletionRender.render(
+				windowState,
+				mFont,
+				mRenderStyle,
+				textRender,
+				{
+					drawPosition.x + lineNumberSpacing + lineOffset,
+					drawPosition.y + (visualLineIndex + 1) * mFont.lineHeight()
+				},
+				mCompletions,
+				mSelectedCompletion);
+		}
 	}
 
 //	std::cout
@@ -5,6 +5,8 @@
 #include "../rendering/renderviewport.h"
 #include "../rendering/textmetrics.h"
 #include "../rendering/textselectionrender.h"
+#include "../rendering/completionrender.h"
+#include "../rendering/underlinerender.h"
 #include "../text/incrementalformattedtext.h"
 #include "textoperations.h"
 
@@ -15,6 +17,8 @@
 class Font;
 struct RenderStyle;
 class TextRender;
+class TextureRender;
+class FrameBuffer;
 class Text;
 
 /**
@@ -62,7 +66,8 @@ struct KeyboardCommand {
 enum class PerformFormattingType : std::uint32_t {
 	Full,
 	Partial,
-	Incremental
+	Incremental,
+	Adaptive // Selects one of the above based on the measured formatting cost
 };
 
 /**
@@ -102,12 +107,49 @@ private:
 
 	Text& mText;
 
+	static constexpr double CARET_BLINK_INTERVAL = 500.0;
+	static constexpr double INPUT_POLL_INTERVAL = 10.0;
+
 	bool mDrawCaret = false;
 	TimePoint mLastCaretUpdate;
+	bool mIsDamaged = true;
+
+	/**
+	 * What the text layer shows. The layer only needs to be rendered again when this changes.
+	 */
+	struct TextLayerState {
+		FrameBuffer* textLayer = nullptr;
+		glm::vec2 drawPosition;
+		float zoom = 1.0f;
+		float rowPosition = 0.0f;
+		float lineNumberSpacing = 0.0f;
+		std::size_t numLines = 0;
+		std::size_t startLineIndex = 0;
+		std::uint64_t fontVersion = 0;
+		std::vector<std::pair<std::size_t, std::uint64_t>> lines;
+	};
+
+	TextLayerState mTextLayerState;
+	TextLayerState mNewTextLayerState;
+	std::unique_ptr<FrameBuffer> mScrolledTextLayer;
 
 	TextSelectionRender mTextSelectionRender;
 	bool mSelectionStarted = false;
 	TextSelection mPotentialSelection;
+	std::vector<SymbolPosition> mSymbolOccurrences;
+
+	static constexpr std::size_t MAX_COMPLETIONS = 8;
+	WordCompletion mWordCompletion;
+	CompletionRender mCompletionRender;
+	std::vector<Completion> mCompletions;
+	std::size_t mSelectedCompletion = 0;
+	SymbolPosition mCompletionStart;
+	SymbolPosition mCompletionCaret;
+	bool mCompletionRequested = false;
+
+	std::unique_ptr<SpellChecker> mSpellChecker;
+	UnderlineRender mUnderlineRender;
+	std::vector<Misspelling> mMisspellings;
 
 	/**
 	 * Returns the current line the caret is at
@@ -134,6 +176,16 @@ private:
 	 */
 	std::size_t numLines();
 
+	/**
+	 * Returns the index of the visual line the caret is at
+	 */
+	std::size_t currentVisualLineIndex() const;
+
+	/**
+	 * Returns the number of visual lines
+	 */
+	std::size_t numVisualLines() const;
+
 	/**
 	 * Moves the caret in the x position by the given amount
 	 * @param diff The amount to move
@@ -152,12 +204,125 @@ private:
 	 */
 	void moveCaretY(std::int64_t diff);
 
+	/**
+	 * Moves the caret by the given number of visual lines when word wrapped, keeping the column within the row
+	 * @param diff The amount to move
+	 * @return The amount actually moved
+	 */
+	std::int64_t moveCaretVisualY(std::int64_t diff);
+
 	/**
 	 * Clamps the view position y
 	 * @param caretScreenPositionY The y position of the caret on the screen
 	 */
 	void clampViewPositionY(float caretScreenPositionY);
 
+	/**
+	 * Finds the completions of the word before the caret
+	 */
+	void findCompletions();
+
+	/**
+	 * Closes the completions
+	 */
+	void closeCompletions();
+
+	/**
+	 * Finds the completions if requested by an edit, and closes them if the caret has moved
+	 */
+	void updateCompletions();
+
+	/**
+	 * Handles the keys for selecting and accepting a completion while completions are shown
+	 * @return True if a key was handled
+	 */
+	bool updateCompletionInput();
+
+	/**
+	 * Replaces the word before the caret with the selected completion
+	 */
+	void acceptCompletion();
+
+	/**
+	 * Renders the visible occurrences of the identifier at the caret
+	 * @param textRender The text render
+	 * @param formattedText The formatted text
+	 * @param drawPosition The draw position
+	 * @param lineNumberSpacing The spacing due to line numbers
+	 */
+	void renderSymbolOccurrences(TextRender& textRender,
+								 const BaseFormattedText& formattedText,
+								 glm::vec2 drawPosition,
+								 float lineNumberSpacing);
+
+	/**
+	 * Returns the first and last text line in the view
+	 * @param formattedText The formatted text
+	 * @param drawPosition The draw position
+	 */
+	std::pair<std::size_t, std::size_t> getViewTextLines(const BaseFormattedText& formattedText,
+														 glm::vec2 drawPosition) const;
+
+	/**
+	 * Indicates if the text layer with the given state can be moved vertically to show the new state, which is when
+	 * they are only moved vertically at the same zoom and the lines that are visible in both are the same
+	 * @param current The current state
+	 * @param next The new state
+	 */
+	bool canScrollTextLayer(const TextLayerState& current, const TextLayerState& next) const;
+
+	/**
+	 * Renders the line numbers and text between the given rows to the given text layer, where the rest of the layer is
+	 * left unchanged
+	 * @param textRender The text render
+	 * @param formattedText The formatted text
+	 * @param textLayer The text layer
+	 * @param top The first row
+	 * @param bottom The row after the last row
+	 * @param drawPosition The draw position
+	 * @param lineNumberSpacing The spacing due to line numbers
+	 * @param zoom The number of rows per unit of the view
+	 */
+	void renderTextLayerRows(TextRender& textRender,
+							 const BaseFormattedText& formattedText,
+							 FrameBuffer& textLayer,
+							 int top,
+							 int bottom,
+							 glm::vec2 drawPosition,
+							 float lineNumberSpacing,
+							 float zoom);
+
+	/**
+	 * Updates the text layer with the visible lines, given by their text line and version. The layer is only rendered
+	 * when they have changed. When only scrolled, the layer is copied into the other layer moved by the scrolled amount,
+	 * and only the rows that became visible are rendered.
+	 * @param textRender The text render
+	 * @param formattedText The formatted text
+	 * @param textLayer The text layer
+	 * @param drawPosition The draw position
+	 * @param lineNumberSpacing The spacing due to line numbers
+	 * @param zoom The zoom of the view
+	 * @return The frame buffer that has the text
+	 */
+	FrameBuffer& updateTextLayer(TextRender& textRender,
+								 const BaseFormattedText& formattedText,
+								 FrameBuffer& textLayer,
+								 glm::vec2 drawPosition,
+								 float lineNumberSpacing,
+								 float zoom);
+
+	/**
+	 * Renders an underline below the misspelled words in the view
+	 * @param windowState The window state
+	 * @param formattedText The formatted text
+	 * @param drawPosition The draw position
+	 * @param lineNumberSpacing The spacing due to line numbers
+	 */
+	void renderMisspellings(const WindowState& windowState,
+							const BaseFormattedText& formattedText,
+							glm::vec2 drawPosition,
+							float lineNumberSpacing);
+
 	/**
 	 * Updates the input
 	 * @param windowState The window state
@@ -188,6 +353,16 @@ private:
 	 */
 	void paste();
 
+	/**
+	 * Folds or unfolds the region at the line of the caret
+	 */
+	void toggleFold();
+
+	/**
+	 * Moves the caret to the likely definition of the identifier at the caret
+	 */
+	void goToDefinition();
+
 	/**
 	 * Deletes the current line
 	 * @param mode How to delete the line
@@ -242,8 +417,9 @@ private:
 
 	/**
 	 * Returns the position of the mouse in the text
+	 * @param windowState The window state
 	 */
-	std::pair<std::int64_t, std::int64_t> getMouseTextPosition();
+	std::pair<std::int64_t, std::int64_t> getMouseTextPosition(const WindowState& windowState);
 
 	/**
 	 * Updates text selection
@@ -266,14 +442,14 @@ public:
 	 * Creates a new text view
 	 * @param window The window
 	 * @param font The font
-	 * @param rules The formatting rules
+	 * @param textFormatter The text formatter
 	 * @param viewPort The view port
 	 * @param renderStyle The render style
 	 * @param text The text
 	 */
 	TextView(GLFWwindow* window,
 			 Font& font,
-			 std::unique_ptr<FormatterRules> rules,
+			 std::unique_ptr<TextFormatter> textFormatter,
 			 const RenderViewPort& viewPort,
 			 const RenderStyle& renderStyle,
 			 Text& text);
@@ -290,9 +466,51 @@ public:
 	void update(const WindowState& windowState);
 
 	/**
-	 * Renders the current view
+	 * Sets the time budget for formatting in each frame
+	 * @param budgetMicroseconds The budget in microseconds
+	 */
+	void setFormattingBudget(std::int64_t budgetMicroseconds);
+
+	/**
+	 * Sets the number of lines around the view and caret that keeps their formatting
+	 * @param windowSize The number of lines on each side, zero keeps all lines
+	 */
+	void setFormattingWindowSize(std::size_t windowSize);
+
+	/**
+	 * Enables spell checking with the given word list. Only text that is not code is checked.
+	 * @param fileName The name of the word list file
+	 */
+	void setSpellingDictionary(const std::string& fileName);
+
+	/**
+	 * Continues formatting that did not complete within the budget, evicts formatting outside the window and continues
+	 * building the symbol index
+	 */
+	void updateFormatting();
+
+	/**
+	 * Indicates if the view has changed since it was last rendered, due to input, edits, formatting or the caret blinking
+	 */
+	bool isDamaged() const;
+
+	/**
+	 * Returns the time in milliseconds until the view needs to be updated, even if there is no input. This is zero
+	 * while formatting is pending, short while a key is repeated and otherwise the time until the caret blinks.
+	 */
+	double timeUntilUpdate() const;
+
+	/**
+	 * Renders the current view. The line numbers and text are rendered to the text layer only when the visible lines or
+	 * the scroll position have changed, where scrolling moves the layer and only renders the rows that became visible.
+	 * The layer is then drawn to the screen, with the caret, selection and other overlays on top.
 	 * @param windowState The window state
 	 * @param textRender The text text render
+	 * @param textLayer The frame buffer that keeps the text between frames, of the same size as the window
+	 * @param textureRender The render to draw the text layer with
 	 */
-	void render(const WindowState& windowState, TextRender& textRender);
+	void render(const WindowState& windowState,
+				TextRender& textRender,
+				FrameBuffer& textLayer,
+				TextureRender& textureRender);
 };
\ No newline at end of file
@@ -1,6 +1,5 @@
 #include <iostream>
 #include <fstream>
-#include <thread>
 #include <vector>
 #include <map>
 
@@ -28,7 +27,12 @@
 #include "text/textloader.h"
 
 RenderViewPort getViewPort(const WindowState& windowState) {
-	return RenderViewPort { glm::vec2(0, 0), (float)windowState.width(), (float)windowState.height() };
+	// The view is in units of the font, which the projection scales by the zoom
+	return RenderViewPort {
+		glm::vec2(0, 0),
+		(float)windowState.width() / windowState.zoom(),
+		(float)windowState.height() / windowState.zoom()
+	};
 }
 
 void setProjection(ShaderProgram& shaderProgram, const WindowState& windowState) {
@@ -56,6 +60,9 @@ int main(int argc, char* argv[]) {
 
 	auto window = glfwCreateWindow(windowState.width(), windowState.height(), "TextEditor", nullptr, nullptr);
 	glfwMakeContextCurrent(window);
+
+	// Frames are only drawn when something has changed, and then paced by the display
+	glfwSwapInterval(1);
 	glfwSetWindowUserPointer(window, &windowState),
 
 	glewExperimental = GL_TRUE;
@@ -63,102 +70,129 @@ int main(int argc, char* argv[]) {
 
 	windowState.initialize(window);
 
-	// Compile and link shaders
-	ShaderProgram textProgram(
-		Helpers::readFileAsUTF8Text("shaders/textVertex.glsl"),
-		Helpers::readFileAsUTF8Text("shaders/text.glsl"));
-
-	glUseProgram(textProgram.id());
-	textProgram.setParameters({ ShaderParameter::textureParameter("inputTexture", 0) });
-	setProjection(textProgram, windowState);
-
-	auto fontName = "fonts/NotoMono-Regular.ttf";
-	Font font(fontName, 16);
-
-	TextRender textRender(textProgram);
-
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	auto wololo = "4	\t44\""; 5.0f;
-
-//  std::string text = "hello	world\nmy friend";
-//  std::string inlineText = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Suspendisse eu enim vitae erat viverra dignissim. Cras congue hendrerit eleifend. Curabitur augue mauris, rutrum laoreet mollis in, laoreet in lacus. Phasellus laoreet lectus quis magna convallis elementum. Donec tempus, nibh vitae ultricies molestie, ex enim porttitor dolor, vel dignissim mauris massa vitae leo.\n\nUt varius semper eros, et gravida nulla maximus sed. Phasellus viverra libero at dignissim mollis. Fusce consectetur porta volutpat. Pellentesque aliquam pharetra convallis. Nunc at elit quam. Proin urna lorem, bibendum vitae consectetur nec, rhoncus at magna. Interdum et malesuada fames ac ante ipsum primis in faucibus. Phasellus odio sapien, scelerisque quis facilisis quis, suscipit eget ligula. Morbi vitae elementum leo. Nullam mollis est quis consectetur finibus. Suspendisse vehicula purus vel libero auctor ultrices. Ut scelerisque quam ante, vitae tincidunt velit laoreet et. Quisque tellus urna, pellentesque nec tincidunt in, semper et nisl. Proin id euismod lorem. Nam nec lorem ornare, blandit arcu nec, pulvinar justo. Curabitur nec rutrum risus. Aenean maximus turpis sit amet risus blandit vehicula. Vestibulum tincidunt odio lectus, non viverra nibh mattis non. Mauris vitae ex posuere diam tincidunt accumsan.\n\nQuisque pretium tortor vitae diam suscipit pellentesque at ac erat. In hac habitasse platea dictumst. Proin sodales dapibus pretium. Duis id eros nulla. Ut hendrerit vehicula lobortis. Etiam sagittis porta dui, vel porttitor tellus scelerisque vel. Quisque cursus rhoncus velit, quis volutpat velit volutpat sit amet. Sed quis molestie libero, eu sollicitudin felis.\n\nNunc tempor eu leo non fermentum. Donec bibendum et lectus vel malesuada. Vivamus malesuada eros nibh, id faucibus eros elementum at. Integer ac sem lorem. Curabitur luctus feugiat justo. Nulla at tortor sit amet orci cursus ornare non id massa. Vivamus vel lacus feugiat, vehicula urna dignissim, blandit lectus. Morbi non urna dui. Morbi ac libero a ligula varius lobortis. Proin at purus eget velit mattis viverra vel sed quam. Duis sollicitudin massa magna, viverra fringilla arcu ultricies eget. Suspendisse potenti. Morbi turpis felis, pellentesque id pretium vel, euismod non eros. Nulla mauris ipsum, interdum at leo aliquam, porttitor condimentum nunc. Cras semper feugiat hendrerit.";
-
-	TextLoader textLoader;
-//	auto loadedText = textLoader.load("data/gc.cpp");
-//	auto loadedText = textLoader.load("src/main.cpp");
-//	auto loadedText = textLoader.load("data/circle.py");
+	// The view and the font are destroyed before the window system, which stops their threads and deletes their
+	// OpenGL objects while the context exists
+	{
+		auto fontName = "fonts/NotoMono-Regular.ttf";
+		// Glyphs of new characters are rasterized in the background, which wakes up the main loop when they are ready.
+		// The font map is cached between runs, which avoids rasterizing any glyph at startup.
+		// The glyphs are distance fields, which means that zooming only changes the projection.
+		Font font(fontName, 16, GlyphFormat::DistanceField, "fonts/fonts.cache", []() { glfwPostEmptyEvent(); });
 
-	auto loadedText = textLoader.load(argv[1]);
+		// Compile and link shaders
+		ShaderProgram textProgram(
+			Helpers::readFileAsUTF8Text("shaders/textVertex.glsl"),
+			Helpers::readFileAsUTF8Text(
+				font.glyphFormat() == GlyphFormat::DistanceField ? "shaders/textDistanceField.glsl" : "shaders/text.glsl"));
 
-	auto startTime = Helpers::timeNow();
-	int numFrames = 0;
-	float fps = 0.0f;
+		glUseProgram(textProgram.id());
+		textProgram.setParameters({ ShaderParameter::textureParameter("inputTexture", 0) });
+		setProjection(textProgram, windowState);
+
+		TextRender textRender(textProgram);
+
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		auto wololo = "4	\t44\""; 5.0f;
+
+	//  std::string text = "hello	world\nmy friend";
+	//  std::string inlineText = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Suspendisse eu enim vitae erat viverra dignissim. Cras congue hendrerit eleifend. Curabitur augue mauris, rutrum laoreet mollis in, laoreet in lacus. Phasellus laoreet lectus quis magna convallis elementum. Donec tempus, nibh vitae ultricies molestie, ex enim porttitor dolor, vel dignissim mauris massa vitae leo.\n\nUt varius semper eros, et gravida nulla maximus sed. Phasellus viverra libero at dignissim mollis. Fusce consectetur porta volutpat. Pellentesque aliquam pharetra convallis. Nunc at elit quam. Proin urna lorem, bibendum vitae consectetur nec, rhoncus at magna. Interdum et malesuada fames ac ante ipsum primis in faucibus. Phasellus odio sapien, scelerisque quis facilisis quis, suscipit eget ligula. Morbi vitae elementum leo. Nullam mollis est quis consectetur finibus. Suspendisse vehicula purus vel libero auctor ultrices. Ut scelerisque quam ante, vitae tincidunt velit laoreet et. Quisque tellus urna, pellentesque nec tincidunt in, semper et nisl. Proin id euismod lorem. Nam nec lorem ornare, blandit arcu nec, pulvinar justo. Curabitur nec rutrum risus. Aenean maximus turpis sit amet risus blandit vehicula. Vestibulum tincidunt odio lectus, non viverra nibh mattis non. Mauris vitae ex posuere diam tincidunt accumsan.\n\nQuisque pretium tortor vitae diam suscipit pellentesque at ac erat. In hac habitasse platea dictumst. Proin sodales dapibus pretium. Duis id eros nulla. Ut hendrerit vehicula lobortis. Etiam sagittis porta dui, vel porttitor tellus scelerisque vel. Quisque cursus rhoncus velit, quis volutpat velit volutpat sit amet. Sed quis molestie libero, eu sollicitudin felis.\n\nNunc tempor eu leo non fermentum. Donec bibendum et lectus vel malesuada. Vivamus malesuada eros nibh, id faucibus eros elementum at. Integer ac sem lorem. Curabitur luctus feugiat justo. Nulla at tortor sit amet orci cursus ornare non id massa. Vivamus vel lacus feugiat, vehicula urna dignissim, blandit lectus. Morbi non urna dui. Morbi ac libero a ligula varius lobortis. Proin at purus eget velit mattis viverra vel sed quam. Duis sollicitudin massa magna, viverra fringilla arcu ultricies eget. Suspendisse potenti. Morbi turpis felis, pellentesque id pretium vel, euismod non eros. Nulla mauris ipsum, interdum at leo aliquam, porttitor condimentum nunc. Cras semper feugiat hendrerit.";
+
+		TextLoader textLoader;
+		textLoader.loadGrammars("grammars/grammars.list", "grammars/grammars.cache");
+	//	auto loadedText = textLoader.load("data/gc.cpp");
+	//	auto loadedText = textLoader.load("src/main.cpp");
+	//	auto loadedText = textLoader.load("data/circle.py");
+
+		auto loadedText = textLoader.load(argv[1]);
+
+		auto startTime = Helpers::timeNow();
+		int numFrames = 0;
+		float fps = 0.0f;
+
+		auto frameBuffer = std::make_unique<FrameBuffer>(windowState.width(), windowState.height());
+
+		ShaderProgram passthroughProgram(
+			Helpers::readFileAsUTF8Text("shaders/vertex.glsl"),
+			Helpers::readFileAsUTF8Text("shaders/passthrough.glsl"));
+
+		RenderStyle renderStyle;
+		auto renderViewPort = getViewPort(windowState);
+
+		TextView codeTextView(
+			window,
+			font,
+			std::move(loadedText.formatter),
+			renderViewPort,
+			renderStyle,
+			loadedText.text);
+
+		// Formatting of large regions is spread over frames to keep the input responsive
+		codeTextView.setFormattingBudget(4000);
+
+		// Only keep the formatting of the lines near the view and caret, which bounds the memory for large files
+		codeTextView.setFormattingWindowSize(2000);
+
+		// Prose is checked against the system word list, without affecting the frame time
+		codeTextView.setSpellingDictionary("/usr/share/dict/words");
+
+	//	codeTextView.update(windowState);
+	//	codeTextView.render(windowState, textRender);
+	//	return 0;
+
+		TextureRender frameBufferRender(passthroughProgram.id());
+
+		while (!glfwWindowShouldClose(window)) {
+			windowState.update();
+
+			auto hasChangedWindowSize = windowState.hasChangedWindowSize();
+			if (hasChangedWindowSize || windowState.hasChangedZoom()) {
+				renderViewPort = getViewPort(windowState);
+				setProjection(textProgram, windowState);
+			}
+
+			if (hasChangedWindowSize) {
+				frameBuffer = std::make_unique<FrameBuffer>(windowState.width(), windowState.height());
+			}
+
+			// The glyphs are uploaded before anything is drawn, which redraws the characters that had a placeholder
+			if (font.uploadGlyphs()) {
+				windowState.damage();
+			}
+
+			codeTextView.update(windowState);
+			codeTextView.updateFormatting();
+
+			if (windowState.isDamaged() || codeTextView.isDamaged()) {
+				// The text is kept in the frame buffer, which is drawn to the screen with the overlays on top
+				codeTextView.render(windowState, textRender, *frameBuffer, frameBufferRender);
+
+				// Swap
+				glfwSwapBuffers(window);
+				windowState.clearDamage();
+				numFrames++;
+			}
+
+			auto duration = (float)Helpers::durationMilliseconds(Helpers::timeNow(), startTime);
+			if (duration >= 1000) {
+				fps = numFrames / (duration * 0.001f);
+				startTime = Helpers::timeNow();
+				numFrames = 0;
+			}
 
-	auto frameBuffer = std::make_unique<FrameBuffer>(windowState.width(), windowState.height());
-
-	ShaderProgram passthroughProgram(
-		Helpers::readFileAsUTF8Text("shaders/vertex.glsl"),
-		Helpers::readFileAsUTF8Text("shaders/passthrough.glsl"));
-
-	RenderStyle renderStyle;
-	auto renderViewPort = getViewPort(windowState);
-
-	TextView codeTextView(
-		window,
-		font,
-		std::move(loadedText.rules),
-		renderViewPort,
-		renderStyle,
-		loadedText.text);
-
-//	codeTextView.update(windowState);
-//	codeTextView.render(windowState, textRender);
-//	return 0;
-
-	TextureRender frameBufferRender(passthroughProgram.id());
-
-	while (!glfwWindowShouldClose(window)) {
-		windowState.update();
-
-		if (windowState.hasChangedWindowSize()) {
-			renderViewPort = getViewPort(windowState);
-			setProjection(textProgram, windowState);
-			frameBuffer = std::make_unique<FrameBuffer>(windowState.width(), windowState.height());
-		}
+			// std::cout << "\rFPS: " << fps << std::flush;
 
-		// Draw text to frame buffer
-//		frameBuffer->bind();
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-		glClearColor(renderStyle.backgroundColor.r, renderStyle.backgroundColor.g, renderStyle.backgroundColor.b, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		codeTextView.update(windowState);
-		codeTextView.render(windowState, textRender);
-
-		// Draw frame buffer to screen
-		/*
-		 * glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		 *
-		 * frameBufferRender.render(frameBuffer->textureColorBuffer());
-		 * */
-
-		// Swap
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-
-		numFrames++;
-		auto duration = (float)Helpers::durationMilliseconds(Helpers::timeNow(), startTime);
-		if (duration >= 1000) {
-			fps = numFrames / (duration * 0.001f);
-			startTime = Helpers::timeNow();
-			numFrames = 0;
+			// Sleeps until there is input or the view needs to be updated, such as for blinking the caret
+			auto timeout = codeTextView.timeUntilUpdate();
+			if (timeout > 0.0) {
+				glfwWaitEventsTimeout(timeout / 1000.0);
+			} else {
+				glfwPollEvents();
+			}
 		}
 
-		// std::cout << "\rFPS: " << fps << std::flush;
-		std::this_thread::sleep_for(std::chrono::milliseconds(12));
+		font.saveCache();
 	}
 
 	glfwTerminate();
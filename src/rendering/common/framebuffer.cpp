@@ -1,5 +1,7 @@
 #include "framebuffer.h"
 
+#include <algorithm>
+
 FrameBuffer::FrameBuffer(int width, int height)
 	: mWidth(width),
 	  mHeight(height) {
@@ -54,3 +56,20 @@ GLuint FrameBuffer::textureColorBuffer() const {
 void FrameBuffer::bind() {
 	glBindFramebuffer(GL_FRAMEBUFFER, mFrameBuffer);
 }
+
+void FrameBuffer::copyTo(FrameBuffer& target, int offsetY) const {
+	auto startY = std::max(0, -offsetY);
+	auto endY = std::min(mHeight, mHeight - offsetY);
+	if (startY >= endY) {
+		return;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, mFrameBuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.mFrameBuffer);
+	glBlitFramebuffer(
+		0, startY, mWidth, endY,
+		0, startY + offsetY, mWidth, endY + offsetY,
+		GL_COLOR_BUFFER_BIT,
+		GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
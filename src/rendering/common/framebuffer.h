@@ -43,4 +43,12 @@ public:
 	 * Binds the current frame buffer
 	 */
 	void bind();
+
+	/**
+	 * Copies the content to the given frame buffer of the same size, moved vertically by the given amount. The rows
+	 * that are moved outside are lost, and the rows that are moved away from are left unchanged in the target.
+	 * @param target The frame buffer to copy to
+	 * @param offsetY The number of rows to move up
+	 */
+	void copyTo(FrameBuffer& target, int offsetY) const;
 };
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "completionrender.h"
+#include "common/shadercompiler.h"
+#include "font.h"
+#include "renderstyle.h"
+#include "textrender.h"
+
+#include "../helpers.h"
+#include "../windowstate.h"
+
+#include <algorithm>
+
+CompletionRender::CompletionRender()
+	: mShaderProgram(Helpers::readFileAsUTF8Text("shaders/selectionVertex.glsl"), Helpers::readFileAsUTF8Text("shaders/solid.glsl")) {
+	glGenVertexArrays(1, &mVAO);
+	glGenBuffers(1, &mVBO);
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 5 * 6, nullptr, GL_DYNAMIC_DRAW);
+
+	glUseProgram(mShaderProgram.id());
+
+	auto posAttribute = glGetAttribLocation(mShaderProgram.id(), "vertexPosition");
+	glEnableVertexAttribArray(posAttribute);
+	glVertexAttribPointer(posAttribute, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), nullptr);
+
+	auto colorAttribute = glGetAttribLocation(mShaderProgram.id(), "vertexColor");
+	glEnableVertexAttribArray(colorAttribute);
+	glVertexAttribPointer(colorAttribute, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)(2 * sizeof(GLfloat)));
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+CompletionRender::~CompletionRender() {
+	glDeleteVertexArrays(1, &mVAO);
+	glDeleteBuffers(1, &mVBO);
+}
+
+void CompletionRender::renderRectangle(glm::vec2 position, glm::vec2 size, glm::vec3 color) {
+	// The y-axis points up in the projection
+	auto left = position.x;
+	auto right = position.x + size.x;
+	auto top = -position.y;
+	auto bottom = -(position.y + size.y);
+
+	GLfloat vertices[] = {
+		left, top, color.r, color.g, color.b,
+		right, top, color.r, color.g, color.b,
+		left, bottom, color.r, color.g, color.b,
+
+		left, bottom, color.r, color.g, color.b,
+		right, bottom, color.r, color.g, color.b,
+		right, top, color.r, color.g, color.b,
+	};
+
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void CompletionRender::render(const WindowState& windowState,
+							  Font& font,
+							  const RenderStyle& renderStyle,
+							  TextRender& textRender,
+							  glm::vec2 position,
+							  const std::vector<Completion>& completions,
+							  std::size_t selectedIndex) {
+	if (completions.empty()) {
+		return;
+	}
+
+	auto padding = renderStyle.getAdvanceX(font, ' ');
+	auto width = 0.0f;
+	for (auto& completion : completions) {
+		auto wordWidth = 0.0f;
+		for (auto character : completion.word) {
+			wordWidth += renderStyle.getAdvanceX(font, character);
+		}
+
+		width = std::max(width, wordWidth);
+	}
+
+	// The rows are aligned with the text lines, where a line extends below the baseline by the descent of '|'
+	auto& fontCharacter = font['|'];
+	auto descent = fontCharacter.size.y - fontCharacter.bearing.y;
+	auto top = position.y + descent;
+
+	glUseProgram(mShaderProgram.id());
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	mShaderProgram.setParameters({ ShaderParameter::float4x4MatrixParameter("projection", windowState.projection()) });
+
+	renderRectangle(
+		{ position.x - padding, top },
+		{ width + 2.0f * padding, completions.size() * font.lineHeight() },
+		renderStyle.completionBackgroundColor);
+
+	renderRectangle(
+		{ position.x - padding, top + selectedIndex * font.lineHeight() },
+		{ width + 2.0f * padding, font.lineHeight() },
+		renderStyle.completionSelectionColor);
+
+	for (std::size_t i = 0; i < completions.size(); i++) {
+		textRender.renderText(
+			font,
+			renderStyle,
+			completions[i].word,
+			{ position.x, position.y + (i + 1) * font.lineHeight() },
+			completions[i].isKeyword ? renderStyle.keywordColor : renderStyle.textColor);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "common/shaderprogram.h"
+#include "../text/wordcompletion.h"
+
+#include <GL/glew.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+class WindowState;
+class Font;
+struct RenderStyle;
+class TextRender;
+
+/**
+ * Represents a render for the popup with word completions
+ */
+class CompletionRender {
+private:
+	ShaderProgram mShaderProgram;
+
+	GLuint mVAO;
+	GLuint mVBO;
+
+	/**
+	 * Renders a rectangle
+	 * @param position The top left corner
+	 * @param size The size
+	 * @param color The color
+	 */
+	void renderRectangle(glm::vec2 position, glm::vec2 size, glm::vec3 color);
+public:
+	CompletionRender();
+	~CompletionRender();
+
+	/**
+	 * Renders the given completions below the given position
+	 * @param windowState The window state
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param textRender The text render
+	 * @param position The position of the baseline of the line above the popup
+	 * @param completions The completions
+	 * @param selectedIndex The index of the selected completion
+	 */
+	void render(const WindowState& windowState,
+				Font& font,
+				const RenderStyle& renderStyle,
+				TextRender& textRender,
+				glm::vec2 position,
+				const std::vector<Completion>& completions,
+				std::size_t selectedIndex);
+};
\ No newline at end of file
@@ -1,161 +1,697 @@
 #include "font.h"
+#include "../helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <memory>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace {
 	const auto numChars = 256;
 
-	std::vector<Char> createAllCharacters() {
-		std::vector<Char> characters;
-		for (Char current = 0; current < numChars; current++) {
-			characters.push_back(current);
+	// New shelves are rounded up in height, such that glyphs of similar height share a shelf
+	const std::uint32_t shelfHeightGranularity = 8;
+
+	const std::uint32_t CACHE_MAGIC = 0x544E4F46;
+	const std::uint32_t CACHE_VERSION = 3;
+
+	/**
+	 * A character stored in the cache, where the glyph index is given by the order in the cache
+	 */
+	struct CachedCharacter {
+		std::uint32_t character;
+		FontCharacter fontCharacter;
+		glm::vec4 metrics;
+		glm::vec4 bounds;
+	};
+
+	/**
+	 * Returns the modification time of the given file in nanoseconds
+	 * @param fileName The name of the file
+	 * @param time The modification time
+	 * @return True if the file exists
+	 */
+	bool modificationTime(const std::string& fileName, std::int64_t& time) {
+		struct stat fileStat;
+		if (stat(fileName.c_str(), &fileStat) != 0) {
+			return false;
 		}
 
-		return characters;
+		time = (std::int64_t)fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+		return true;
 	}
-}
 
-FontMap::FontMap(const std::string& name, std::uint32_t size, const std::vector<Char>& characters)
-	: mSize(size) {
-	FT_Library ft;
-	if (FT_Init_FreeType(&ft)) {
-		throw std::runtime_error("Could not init FreeType Library.");
+	template<typename T>
+	void writeValue(std::ostream& stream, const T& value) {
+		stream.write((const char*)&value, sizeof(T));
 	}
 
-	FT_Face face;
-	if (FT_New_Face(ft, name.c_str(), 0, &face)) {
-		throw std::runtime_error("Failed to load font.");
+	void writeString(std::ostream& stream, const std::string& str) {
+		writeValue(stream, (std::uint32_t)str.size());
+		stream.write(str.data(), str.size());
 	}
 
-	FT_Set_Pixel_Sizes(face, 0, size);
-
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Disable byte-alignment restriction
+	/**
+	 * Reads values from a memory mapped file
+	 */
+	struct MappedFileReader {
+		const char* current;
+		const char* end;
+
+		template<typename T>
+		bool readValue(T& value) {
+			if ((std::size_t)(end - current) < sizeof(T)) {
+				return false;
+			}
 
-	// Determine size of the elements in the map
-	for (auto& character : characters) {
-		// Load font character glyph
-		if (FT_Load_Char(face, character, FT_LOAD_RENDER)) {
-			continue;
+			std::memcpy(&value, current, sizeof(T));
+			current += sizeof(T);
+			return true;
 		}
 
-		mSize = std::max(mSize, face->glyph->bitmap.width);
-		mSize = std::max(mSize, face->glyph->bitmap.rows);
-	}
+		bool readString(std::string& str) {
+			std::uint32_t size = 0;
+			if (!readValue(size) || (std::size_t)(end - current) < size) {
+				return false;
+			}
 
-	mCharsPerColumn = characters.size();
-	const auto maxWidth = characters.size() * (float)mSize;
+			str.assign(current, size);
+			current += size;
+			return true;
+		}
+
+		const char* readBytes(std::size_t size) {
+			if ((std::size_t)(end - current) < size) {
+				return nullptr;
+			}
 
-	static std::unordered_map<Char, Char> glpyhReplacements = {
-		{ '\t', ' ' }
+			auto bytes = current;
+			current += size;
+			return bytes;
+		}
 	};
+}
 
-	auto buffer = std::make_unique<std::uint8_t[]>(mSize * mSize * characters.size());
-	std::size_t characterIndex = 0;
-	for (auto& character : characters) {
-		auto glpyhCharacter = character;
+FontMap::FontMap(const std::string& name,
+				 std::uint32_t size,
+				 GlyphFormat format,
+				 std::function<void ()> glyphsAvailable)
+	: mName(name),
+	  mSize(size),
+	  mFormat(format),
+	  mGlyphScale(GlyphRasterizer::glyphScale(format)),
+	  mRasterizer(name, size, format, std::move(glyphsAvailable)) {
+	GLint maxTextureSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	mAtlasWidth = std::min((std::uint32_t)ATLAS_WIDTH, (std::uint32_t)maxTextureSize);
+	mMaxAtlasHeight = (std::uint32_t)maxTextureSize;
 
-		auto replacementIterator = glpyhReplacements.find(character);
-		if (replacementIterator != glpyhReplacements.end()) {
-			glpyhCharacter = replacementIterator->second;
-		}
+	// Generate texture
+	glGenTextures(1, &mTextureMap);
+	glBindTexture(GL_TEXTURE_2D, mTextureMap);
 
-		// Load font character glyph
-		if (FT_Load_Char(face, glpyhCharacter, FT_LOAD_RENDER)) {
-			std::cerr << "Failed to load glyph." << std::endl;
-			continue;
-		}
+	// Set texture options
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	addPage();
+
+	mGlyphCapacity = INITIAL_GLYPH_CAPACITY * 8;
+	glGenBuffers(1, &mGlyphBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, mGlyphBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLfloat) * mGlyphCapacity, nullptr, GL_DYNAMIC_DRAW);
+
+	glGenTextures(1, &mGlyphTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, mGlyphTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mGlyphBuffer);
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// Latin-1 is the first page
+	mPages.fill(&mEmptyPage);
+	mPages[0] = &mLatin1Characters;
+
+	FontCharacter placeholder;
+	placeholder.size = glm::i16vec2(0, 0);
+	placeholder.bearing = glm::i16vec2(0, 0);
+	placeholder.advanceX = 0.0f;
+	placeholder.glyphIndex = 0;
+
+	// The entries start uninitialized, while setting the placeholder only replaces the entries with glyph index zero
+	mLatin1Characters.fill(placeholder);
+	setPlaceholder(placeholder);
+}
+
+FontMap::~FontMap() {
+	glDeleteTextures(1, &mTextureMap);
+	glDeleteTextures(1, &mGlyphTexture);
+	glDeleteBuffers(1, &mGlyphBuffer);
+
+	if (mFace != nullptr) {
+		FT_Done_Face(mFace);
+	}
+
+	if (mLibrary != nullptr) {
+		FT_Done_FreeType(mLibrary);
+	}
+}
+
+FT_Face FontMap::face() {
+	if (mFace == nullptr && !GlyphRasterizer::openFace(mName, mSize, mFormat, mLibrary, mFace)) {
+		throw std::runtime_error("Failed to load font.");
+	}
+
+	return mFace;
+}
+
+void FontMap::createPlaceholder() {
+	// The glyph for missing characters is the placeholder of the characters that are being rasterized
+	RasterizedGlyph placeholderGlyph;
+	GlyphRasterizer::rasterizeGlyph(face(), 0, mFormat, placeholderGlyph);
+	auto placeholder = mPlaceholder;
+	placeGlyph(placeholderGlyph, placeholder);
+	setPlaceholder(placeholder);
+}
 
-		auto width = face->glyph->bitmap.width;
-		auto height = face->glyph->bitmap.rows;
-		auto charMapOffset = characterIndex * mSize;
+void FontMap::setPlaceholder(const FontCharacter& placeholder) {
+	mPlaceholder = placeholder;
+	mEmptyPage.fill(mPlaceholder);
 
-		for (std::size_t y = 0; y < height; y++) {
-			for (std::size_t x = 0; x < width; x++) {
-				buffer[y * (mSize * mCharsPerColumn) + charMapOffset + x] = face->glyph->bitmap.buffer[y * width + x];
+	for (auto page : mPages) {
+		if (page != &mEmptyPage) {
+			for (auto& fontCharacter : *page) {
+				if (fontCharacter.glyphIndex == 0) {
+					fontCharacter = mPlaceholder;
+				}
 			}
 		}
+	}
+}
 
-		// Now store fontCharacter for later use
-		FontCharacter fontCharacter = {
-			glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-			glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-			face->glyph->advance.x / 64.0f,
-			face->glyph->metrics.vertAdvance / 64.0f,
+FontCharacter& FontMap::characterEntry(Char character) {
+	auto& page = mPages[character >> PAGE_BITS];
+	if (page == &mEmptyPage) {
+		mAllocatedPages.push_back(std::make_unique<Page>(mEmptyPage));
+		page = mAllocatedPages.back().get();
+	}
 
-			0.0f, // Top
-			charMapOffset / maxWidth, // Left
-			fontCharacter.size.y / (float)mSize, // Bottom
-			(charMapOffset + fontCharacter.size.x) / maxWidth //Right
-		};
+	return (*page)[character & (PAGE_SIZE - 1)];
+}
 
-		mCharacters.insert({ character, fontCharacter });
-		characterIndex++;
+bool FontMap::addPage() {
+	auto height = std::min(mAtlasHeight + ATLAS_PAGE_HEIGHT, mMaxAtlasHeight);
+	if (height == mAtlasHeight) {
+		return false;
 	}
 
-//	std::cout << "loaded font map" << std::endl;
+	resizeAtlas(height);
+	return true;
+}
 
-	// Generate texture
-	glGenTextures(1, &mTextureMap);
+void FontMap::resizeAtlas(std::uint32_t height) {
+	// The atlas is stored by row, which means that the new rows are added at the end
+	mAtlasHeight = height;
+	mAtlas.resize((std::size_t)mAtlasWidth * mAtlasHeight, 0);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Disable byte-alignment restriction
 	glBindTexture(GL_TEXTURE_2D, mTextureMap);
 	glTexImage2D(
 		GL_TEXTURE_2D,
 		0,
 		GL_RED,
-		(std::uint32_t)(mSize * characters.size()),
-		mSize,
+		mAtlasWidth,
+		mAtlasHeight,
 		0,
 		GL_RED,
 		GL_UNSIGNED_BYTE,
-		buffer.get()
+		mAtlas.data()
 	);
+}
 
-	// Set texture options
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+bool FontMap::allocate(std::uint32_t width, std::uint32_t height, std::uint32_t& left, std::uint32_t& top) {
+	if (width > mAtlasWidth) {
+		return false;
+	}
+
+	// Use the lowest shelf with room for the glyph
+	Shelf* bestShelf = nullptr;
+	for (auto& shelf : mShelves) {
+		if (shelf.height >= height
+			&& shelf.nextLeft + width <= mAtlasWidth
+			&& (bestShelf == nullptr || shelf.height < bestShelf->height)) {
+			bestShelf = &shelf;
+		}
+	}
+
+	if (bestShelf == nullptr) {
+		auto shelfHeight = (height + shelfHeightGranularity - 1) / shelfHeightGranularity * shelfHeightGranularity;
+		while (mNextShelfTop + shelfHeight > mAtlasHeight) {
+			if (!addPage()) {
+				return false;
+			}
+		}
+
+		mShelves.push_back({ mNextShelfTop, shelfHeight, 0 });
+		mNextShelfTop += shelfHeight;
+		bestShelf = &mShelves.back();
+	}
 
-	FT_Done_Face(face);
-	FT_Done_FreeType(ft);
+	left = bestShelf->nextLeft;
+	top = bestShelf->top;
+	bestShelf->nextLeft += width;
+	return true;
 }
 
-FontMap::~FontMap() {
-	glDeleteTextures(1, &mTextureMap);
+void FontMap::setGlyph(std::uint32_t glyphIndex, const glm::vec4& metrics, const glm::vec4& bounds) {
+	auto start = (std::size_t)glyphIndex * 8;
+	if (mGlyphs.size() < start + 8) {
+		mGlyphs.resize(start + 8, 0.0f);
+	}
+
+	auto glyph = &mGlyphs[start];
+	glyph[0] = metrics.x;
+	glyph[1] = metrics.y;
+	glyph[2] = metrics.z;
+	glyph[3] = metrics.w;
+	glyph[4] = bounds.x;
+	glyph[5] = bounds.y;
+	glyph[6] = bounds.z;
+	glyph[7] = bounds.w;
+
+	if (mDirtyGlyphStart == mDirtyGlyphEnd) {
+		mDirtyGlyphStart = start;
+		mDirtyGlyphEnd = start + 8;
+	} else {
+		mDirtyGlyphStart = std::min(mDirtyGlyphStart, start);
+		mDirtyGlyphEnd = std::max(mDirtyGlyphEnd, start + 8);
+	}
 }
 
-GLuint FontMap::textureMap() const {
-	return mTextureMap;
+void FontMap::placeGlyph(const RasterizedGlyph& glyph, FontCharacter& fontCharacter) {
+	// The character has the metrics of the outline, while the drawn glyph includes the padding of a distance field
+	auto padding = glyph.padding;
+	fontCharacter.size = glm::i16vec2(0, 0);
+	fontCharacter.bearing = glm::i16vec2(
+		(std::int16_t)std::round((glyph.bearing.x + padding) * mGlyphScale),
+		(std::int16_t)std::round((glyph.bearing.y - padding) * mGlyphScale));
+	fontCharacter.advanceX = glyph.advanceX * mGlyphScale;
+
+	if (mLineHeight == 0.0f) {
+		mLineHeight = glyph.lineHeight * mGlyphScale;
+	}
+
+	auto metrics = glm::vec4(
+		glyph.bearing.x * mGlyphScale,
+		glyph.bearing.y * mGlyphScale,
+		glyph.size.x * mGlyphScale,
+		glyph.size.y * mGlyphScale);
+
+	// The glyphs are padded with empty texels, such that filtering does not sample the neighbouring glyphs
+	auto width = (std::uint32_t)glyph.size.x;
+	auto height = (std::uint32_t)glyph.size.y;
+	std::uint32_t left = 0;
+	std::uint32_t top = 0;
+	if (width > 0 && height > 0) {
+		if (!allocate(width + 2 * GLYPH_PADDING, height + 2 * GLYPH_PADDING, left, top)) {
+			std::cerr << "The font map is full." << std::endl;
+			metrics.z = 0.0f;
+			metrics.w = 0.0f;
+			setGlyph(fontCharacter.glyphIndex, metrics, glm::vec4(0.0f, 0.0f, 0.0f, 0.0f));
+			return;
+		}
+
+		left += GLYPH_PADDING;
+		top += GLYPH_PADDING;
+
+		for (std::uint32_t y = 0; y < height; y++) {
+			std::memcpy(
+				&mAtlas[(std::size_t)(top + y) * mAtlasWidth + left],
+				&glyph.bitmap[(std::size_t)y * width],
+				width);
+		}
+
+		if (mDirtyAtlasTop == mDirtyAtlasBottom) {
+			mDirtyAtlasTop = top;
+			mDirtyAtlasBottom = top + height;
+		} else {
+			mDirtyAtlasTop = std::min(mDirtyAtlasTop, top);
+			mDirtyAtlasBottom = std::max(mDirtyAtlasBottom, top + height);
+		}
+	}
+
+	fontCharacter.size = glm::i16vec2(
+		(std::int16_t)std::round(std::max((int)width - 2 * padding, 0) * mGlyphScale),
+		(std::int16_t)std::round(std::max((int)height - 2 * padding, 0) * mGlyphScale));
+	setGlyph(
+		fontCharacter.glyphIndex,
+		metrics,
+		glm::vec4((float)left, (float)top, (float)(left + width), (float)(top + height)));
+}
+
+void FontMap::upload() {
+	// The changed rows are uploaded at once, which is a single upload for a batch of glyphs
+	if (mDirtyAtlasTop != mDirtyAtlasBottom) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glBindTexture(GL_TEXTURE_2D, mTextureMap);
+		glTexSubImage2D(
+			GL_TEXTURE_2D,
+			0,
+			0,
+			mDirtyAtlasTop,
+			mAtlasWidth,
+			mDirtyAtlasBottom - mDirtyAtlasTop,
+			GL_RED,
+			GL_UNSIGNED_BYTE,
+			&mAtlas[(std::size_t)mDirtyAtlasTop * mAtlasWidth]);
+
+		mDirtyAtlasTop = 0;
+		mDirtyAtlasBottom = 0;
+	}
+
+	if (mDirtyGlyphStart != mDirtyGlyphEnd) {
+		glBindBuffer(GL_TEXTURE_BUFFER, mGlyphBuffer);
+		if (mGlyphs.size() > mGlyphCapacity) {
+			// Grow the buffer by doubling, such that adding glyphs one at a time only reallocates it rarely
+			while (mGlyphCapacity < mGlyphs.size()) {
+				mGlyphCapacity *= 2;
+			}
+
+			glBufferData(GL_TEXTURE_BUFFER, sizeof(GLfloat) * mGlyphCapacity, nullptr, GL_DYNAMIC_DRAW);
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(GLfloat) * mGlyphs.size(), mGlyphs.data());
+		} else {
+			glBufferSubData(
+				GL_TEXTURE_BUFFER,
+				sizeof(GLfloat) * mDirtyGlyphStart,
+				sizeof(GLfloat) * (mDirtyGlyphEnd - mDirtyGlyphStart),
+				&mGlyphs[mDirtyGlyphStart]);
+		}
+
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		mDirtyGlyphStart = 0;
+		mDirtyGlyphEnd = 0;
+	}
 }
 
-const std::unordered_map<Char, FontCharacter>& FontMap::characters() const {
-	return mCharacters;
+bool FontMap::loadCache(const std::string& cacheFileName) {
+	std::int64_t fontTime = 0;
+	if (!mGlyphs.empty() || !modificationTime(mName, fontTime)) {
+		return false;
+	}
+
+	auto file = open(cacheFileName.c_str(), O_RDONLY);
+	if (file == -1) {
+		return false;
+	}
+
+	struct stat fileStat;
+	void* data = MAP_FAILED;
+	if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0) {
+		data = mmap(nullptr, (std::size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	}
+
+	close(file);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	MappedFileReader reader { (const char*)data, (const char*)data + fileStat.st_size };
+	std::uint32_t magic = 0;
+	std::uint32_t version = 0;
+	std::string name;
+	std::int64_t time = 0;
+	std::uint32_t size = 0;
+	std::uint32_t format = 0;
+	float lineHeight = 0.0f;
+	std::uint32_t atlasWidth = 0;
+	std::uint32_t atlasHeight = 0;
+	std::uint32_t nextShelfTop = 0;
+	std::uint32_t numShelves = 0;
+	auto isValid = reader.readValue(magic) && magic == CACHE_MAGIC
+		&& reader.readValue(version) && version == CACHE_VERSION
+		&& reader.readString(name) && name == mName
+		&& reader.readValue(time) && time == fontTime
+		&& reader.readValue(size) && size == mSize
+		&& reader.readValue(format) && format == (std::uint32_t)mFormat
+		&& reader.readValue(lineHeight)
+		&& reader.readValue(atlasWidth) && atlasWidth == mAtlasWidth
+		&& reader.readValue(atlasHeight) && atlasHeight <= mMaxAtlasHeight
+		&& reader.readValue(nextShelfTop) && nextShelfTop <= atlasHeight
+		&& reader.readValue(numShelves);
+
+	std::vector<Shelf> shelves;
+	for (std::uint32_t i = 0; isValid && i < numShelves; i++) {
+		Shelf shelf;
+		isValid = reader.readValue(shelf.top)
+			&& reader.readValue(shelf.height)
+			&& reader.readValue(shelf.nextLeft)
+			&& shelf.top + shelf.height <= nextShelfTop;
+		shelves.push_back(shelf);
+	}
+
+	CachedCharacter placeholder;
+	std::uint32_t numCharacters = 0;
+	isValid = isValid && reader.readValue(placeholder) && reader.readValue(numCharacters);
+
+	std::vector<CachedCharacter> characters;
+	for (std::uint32_t i = 0; isValid && i < numCharacters; i++) {
+		CachedCharacter character;
+		isValid = reader.readValue(character) && character.character < NUM_PAGES * PAGE_SIZE;
+		characters.push_back(character);
+	}
+
+	// Only the rows with shelves are stored
+	auto atlas = isValid ? reader.readBytes((std::size_t)atlasWidth * nextShelfTop) : nullptr;
+	if (atlas != nullptr) {
+		mAtlas.assign((std::size_t)atlasWidth * atlasHeight, 0);
+		std::memcpy(mAtlas.data(), atlas, (std::size_t)atlasWidth * nextShelfTop);
+		resizeAtlas(atlasHeight);
+
+		mShelves = std::move(shelves);
+		mNextShelfTop = nextShelfTop;
+		mLineHeight = lineHeight;
+
+		// The glyph indices are given by the order in the cache, after the placeholder
+		placeholder.fontCharacter.glyphIndex = 0;
+		setGlyph(0, placeholder.metrics, placeholder.bounds);
+		setPlaceholder(placeholder.fontCharacter);
+
+		for (auto& current : characters) {
+			current.fontCharacter.glyphIndex = (std::uint32_t)(mGlyphs.size() / 8);
+			setGlyph(current.fontCharacter.glyphIndex, current.metrics, current.bounds);
+			characterEntry((Char)current.character) = current.fontCharacter;
+		}
+
+		mNumCharacters = characters.size();
+
+		upload();
+		mHasNewGlyphs = false;
+	}
+
+	munmap(data, (std::size_t)fileStat.st_size);
+	return atlas != nullptr;
 }
 
-Font::Font(const std::string& name, std::uint32_t size)
-	: mName(name), mSize(size) {
-	mCreatedCharacters = createAllCharacters();
-	createFontMap(mCreatedCharacters);
+void FontMap::saveCache(const std::string& cacheFileName) {
+	std::int64_t fontTime = 0;
+	if (!modificationTime(mName, fontTime)) {
+		return;
+	}
+
+	// The cache is replaced at once, as another instance can have the current cache mapped
+	auto tempFileName = cacheFileName + ".tmp";
+	{
+		std::ofstream stream(tempFileName, std::ios::binary);
+		if (!stream.is_open()) {
+			return;
+		}
+
+		writeValue(stream, CACHE_MAGIC);
+		writeValue(stream, CACHE_VERSION);
+		writeString(stream, mName);
+		writeValue(stream, fontTime);
+		writeValue(stream, mSize);
+		writeValue(stream, (std::uint32_t)mFormat);
+		writeValue(stream, mLineHeight);
+		writeValue(stream, mAtlasWidth);
+		writeValue(stream, mAtlasHeight);
+		writeValue(stream, mNextShelfTop);
+
+		writeValue(stream, (std::uint32_t)mShelves.size());
+		for (auto& shelf : mShelves) {
+			writeValue(stream, shelf.top);
+			writeValue(stream, shelf.height);
+			writeValue(stream, shelf.nextLeft);
+		}
+
+		auto cachedCharacter = [&](std::size_t character, const FontCharacter& fontCharacter) {
+			auto glyph = &mGlyphs[(std::size_t)fontCharacter.glyphIndex * 8];
+			return CachedCharacter {
+				(std::uint32_t)character,
+				fontCharacter,
+				glm::vec4(glyph[0], glyph[1], glyph[2], glyph[3]),
+				glm::vec4(glyph[4], glyph[5], glyph[6], glyph[7])
+			};
+		};
+
+		writeValue(stream, cachedCharacter(0, mPlaceholder));
+		writeValue(stream, (std::uint32_t)(mNumCharacters - mPendingCharacters.size()));
+		for (std::size_t pageIndex = 0; pageIndex < NUM_PAGES; pageIndex++) {
+			auto page = mPages[pageIndex];
+			if (page == &mEmptyPage) {
+				continue;
+			}
+
+			for (std::size_t i = 0; i < PAGE_SIZE; i++) {
+				auto character = (pageIndex << PAGE_BITS) | i;
+				auto& fontCharacter = (*page)[i];
+				if (fontCharacter.glyphIndex != 0 && mPendingCharacters.count((Char)character) == 0) {
+					writeValue(stream, cachedCharacter(character, fontCharacter));
+				}
+			}
+		}
+
+		stream.write((const char*)mAtlas.data(), (std::streamsize)((std::size_t)mAtlasWidth * mNextShelfTop));
+		if (!stream) {
+			return;
+		}
+	}
+
+	if (std::rename(tempFileName.c_str(), cacheFileName.c_str()) == 0) {
+		mHasNewGlyphs = false;
+	}
 }
 
-GLuint Font::textureMap() const {
-	return mFontMap->textureMap();
+bool FontMap::hasNewGlyphs() const {
+	return mHasNewGlyphs;
 }
 
-float Font::lineHeight() const {
+void FontMap::addCharacters(const std::vector<Char>& characters) {
+	if (mGlyphs.empty()) {
+		createPlaceholder();
+	}
+
+	RasterizedGlyph glyph;
+	for (auto character : characters) {
+		// A glyph that fails to load is added without a bitmap, such that it is not loaded again
+		if (!GlyphRasterizer::rasterize(face(), character, mFormat, glyph)) {
+			std::cerr << "Failed to load glyph." << std::endl;
+		}
+
+		auto& fontCharacter = characterEntry(character);
+		if (fontCharacter.glyphIndex == 0) {
+			fontCharacter.glyphIndex = (std::uint32_t)(mGlyphs.size() / 8);
+			mNumCharacters++;
+		}
+
+		placeGlyph(glyph, fontCharacter);
+		mHasNewGlyphs = true;
+	}
+
+	upload();
+}
+
+const FontCharacter& FontMap::requestCharacter(Char character, float advanceX) {
+	// The glyph of the character is drawn as the placeholder until it is ready
+	auto& fontCharacter = characterEntry(character);
+	fontCharacter.glyphIndex = (std::uint32_t)(mGlyphs.size() / 8);
+	fontCharacter.advanceX = advanceX;
+	auto placeholderGlyph = &mGlyphs[0];
+	setGlyph(
+		fontCharacter.glyphIndex,
+		glm::vec4(placeholderGlyph[0], placeholderGlyph[1], placeholderGlyph[2], placeholderGlyph[3]),
+		glm::vec4(placeholderGlyph[4], placeholderGlyph[5], placeholderGlyph[6], placeholderGlyph[7]));
+	upload();
+
+	mRasterizer.request(character);
+	mPendingCharacters.insert(character);
+	mNumCharacters++;
+	return fontCharacter;
+}
+
+bool FontMap::uploadGlyphs(bool& advancesChanged) {
+	mRasterizer.takeFinishedGlyphs(mFinishedGlyphs);
+	if (mFinishedGlyphs.empty()) {
+		return false;
+	}
+
+	for (auto& glyph : mFinishedGlyphs) {
+		auto& fontCharacter = characterEntry(glyph.character);
+		auto placeholderAdvanceX = fontCharacter.advanceX;
+		placeGlyph(glyph, fontCharacter);
+
+		if (fontCharacter.advanceX != placeholderAdvanceX) {
+			advancesChanged = true;
+		}
+
+		mPendingCharacters.erase(glyph.character);
+	}
+
+	mHasNewGlyphs = true;
+	upload();
+	return true;
+}
+
+GlyphFormat FontMap::glyphFormat() const {
+	return mFormat;
+}
+
+GLuint FontMap::textureMap() const {
+	return mTextureMap;
+}
+
+GLuint FontMap::glyphTexture() const {
+	return mGlyphTexture;
+}
+
+float FontMap::lineHeight() const {
 	return mLineHeight;
 }
 
-void Font::createFontMap(const std::vector<Char>& characters) {
-	mFontMap = std::make_unique<FontMap>(mName, mSize, characters);
+std::size_t FontMap::numCharacters() const {
+	return mNumCharacters;
+}
+
+Font::Font(const std::string& name,
+		   std::uint32_t size,
+		   GlyphFormat format,
+		   const std::string& cacheFileName,
+		   std::function<void ()> glyphsAvailable)
+	: mName(name), mSize(size), mFormat(format), mCacheFileName(cacheFileName) {
+	auto t0 = Helpers::timeNow();
+	mFontMap = std::make_unique<FontMap>(name, size, format, std::move(glyphsAvailable));
+	auto isCached = !mCacheFileName.empty() && mFontMap->loadCache(mCacheFileName);
+
+	// The characters that are not in the cache are rasterized directly, as they are needed for the first frame
+	std::vector<Char> characters;
+	std::vector<Char> missingCharacters;
+	for (Char character = 0; character < numChars; character++) {
+		characters.push_back(character);
+		if ((*mFontMap)[character].glyphIndex == 0) {
+			missingCharacters.push_back(character);
+		}
+	}
 
-	mMonoSpaceAdvanceX = 0.0f;
-	mMonoSpaceAdvanceX = false;
+	if (!missingCharacters.empty()) {
+		mFontMap->addCharacters(missingCharacters);
+	}
 
-	for (auto& current : mFontMap->characters()) {
-		auto& fontCharacter = current.second;
+	mLineHeight = mFontMap->lineHeight();
+	for (auto character : characters) {
+		auto& fontCharacter = (*this)[character];
 
-		if (mLineHeight == 0) {
-			mLineHeight = fontCharacter.lineHeight;
+		// Characters without an advance, such as control characters, do not decide the spacing
+		if (fontCharacter.advanceX == 0.0f) {
+			continue;
 		}
 
 		if (mMonoSpaceAdvanceX == 0.0f) {
@@ -163,26 +699,60 @@ void Font::createFontMap(const std::vector<Char>& characters) {
 		}
 
 		if (mMonoSpaceAdvanceX != fontCharacter.advanceX) {
-			mMonoSpaceAdvanceX = false;
+			mIsMonoSpace = false;
 		}
 	}
 
-	std::cout << "Created font map" << std::endl;
+	std::cout
+		<< "Created font map (characters = " << mFontMap->numCharacters()
+		<< ", cached = " << (isCached ? "true" : "false") << ") in "
+		<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
+		<< std::endl;
 }
 
-const FontCharacter& Font::operator[](Char character) const {
-	return mFontMap->characters().at(character);
+void Font::saveCache() {
+	if (!mCacheFileName.empty() && mFontMap->hasNewGlyphs()) {
+		mFontMap->saveCache(mCacheFileName);
+	}
 }
 
-const FontCharacter& Font::tryGet(Char character) {
-	auto charIterator = mFontMap->characters().find(character);
-	if (charIterator != mFontMap->characters().end()) {
-		return charIterator->second;
-	} else {
-		mCreatedCharacters.push_back(character);
-		createFontMap(mCreatedCharacters);
-		return mFontMap->characters().at(character);
+GlyphFormat Font::glyphFormat() const {
+	return mFormat;
+}
+
+GLuint Font::textureMap() const {
+	return mFontMap->textureMap();
+}
+
+GLuint Font::glyphTexture() const {
+	return mFontMap->glyphTexture();
+}
+
+std::uint64_t Font::version() const {
+	return mVersion;
+}
+
+std::uint64_t Font::advancesVersion() const {
+	return mAdvancesVersion;
+}
+
+bool Font::uploadGlyphs() {
+	auto advancesChanged = false;
+	if (!mFontMap->uploadGlyphs(advancesChanged)) {
+		return false;
+	}
+
+	// The advances of a monospaced font do not depend on the glyphs
+	mVersion++;
+	if (advancesChanged && !mIsMonoSpace) {
+		mAdvancesVersion++;
 	}
+
+	return true;
+}
+
+float Font::lineHeight() const {
+	return mLineHeight;
 }
 
 //float Font::getAdvanceX(Char character) const {
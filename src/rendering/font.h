@@ -1,8 +1,13 @@
 #pragma once
-#include <unordered_map>
+#include <array>
+#include <functional>
+#include <unordered_set>
 #include <memory>
+#include <vector>
 
 #include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/type_precision.hpp>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -11,50 +16,258 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include "../text/text.h"
+#include "glyphrasterizer.h"
 
 /**
- * Represents a character for a font
+ * Represents a character for a font. The metrics are packed into 16 bytes, such that four characters share a cache
+ * line. The texture coordinates are only stored with the glyphs of the font map.
  */
 struct FontCharacter {
-	glm::ivec2 size;
-	glm::ivec2 bearing;
+	glm::i16vec2 size;
+	glm::i16vec2 bearing;
 	float advanceX;
-	float lineHeight;
-
-	float textureTop;
-	float textureLeft;
-	float textureBottom;
-	float textureRight;
+	std::uint32_t glyphIndex;
 };
 
 /**
- * Represents a font map
+ * Represents a font map, which is a texture atlas with the glyphs of the loaded characters.
+ *
+ * The glyphs are packed into shelves: rows of glyphs of similar height. The atlas grows by a page of rows at a time
+ * when no shelf has room, and only the glyphs of new characters are rasterized and uploaded.
+ *
+ * New characters are rasterized by a glyph rasterizer on background threads. Until a glyph is ready, its character is
+ * drawn with the glyph that the font uses for missing characters. The finished glyphs are uploaded in a batch, where
+ * the glyph index of the character stays the same.
+ *
+ * The atlas and the characters can be stored in a cache file, which is keyed by the font file, its modification time
+ * and the size. Loading the cache needs no FreeType work, as the FreeType faces are only opened to add characters.
+ *
+ * The glyphs are either coverage bitmaps, drawn at the size of the font, or signed distance fields, which are
+ * rasterized larger and can be drawn at any scale from the same atlas. The metrics of the characters are in pixels of
+ * the font in both cases, while the glyphs of distance fields include the spread around the outline.
+ *
+ * The characters are looked up in a flat table: a direct array for Latin-1, and pages of 256 characters for the rest
+ * of the Basic Multilingual Plane. Pages without characters share a page filled with the placeholder, which means
+ * that a lookup is a single indexed load without branches on whether the character exists. The placeholder has glyph
+ * index zero, which no added character has.
  */
 class FontMap {
 private:
+	static constexpr std::uint32_t ATLAS_WIDTH = 1024;
+	static constexpr std::uint32_t ATLAS_PAGE_HEIGHT = 256;
+	static constexpr std::uint32_t GLYPH_PADDING = 1;
+	static constexpr std::size_t INITIAL_GLYPH_CAPACITY = 256;
+
+	static constexpr std::size_t PAGE_BITS = 8;
+	static constexpr std::size_t PAGE_SIZE = 1 << PAGE_BITS;
+	static constexpr std::size_t NUM_PAGES = 65536 / PAGE_SIZE;
+	using Page = std::array<FontCharacter, PAGE_SIZE>;
+
+	/**
+	 * A row of glyphs in the atlas
+	 */
+	struct Shelf {
+		std::uint32_t top;
+		std::uint32_t height;
+		std::uint32_t nextLeft;
+	};
+
+	std::string mName;
 	std::uint32_t mSize;
-	std::size_t mCharsPerColumn;
-	std::unordered_map<Char, FontCharacter> mCharacters;
+	GlyphFormat mFormat;
+	float mGlyphScale;
+
+	FT_Library mLibrary = nullptr;
+	FT_Face mFace = nullptr;
+	GlyphRasterizer mRasterizer;
+	std::vector<RasterizedGlyph> mFinishedGlyphs;
+
+	Page mLatin1Characters;
+	std::array<Page*, NUM_PAGES> mPages;
+	Page mEmptyPage;
+	std::vector<std::unique_ptr<Page>> mAllocatedPages;
+	std::size_t mNumCharacters = 0;
+
+	std::unordered_set<Char> mPendingCharacters;
+	FontCharacter mPlaceholder;
+	float mLineHeight = 0.0f;
+	bool mHasNewGlyphs = false;
+
 	GLuint mTextureMap;
+	std::uint32_t mAtlasWidth;
+	std::uint32_t mAtlasHeight = 0;
+	std::uint32_t mMaxAtlasHeight;
+	std::vector<std::uint8_t> mAtlas;
+	std::vector<Shelf> mShelves;
+	std::uint32_t mNextShelfTop = 0;
+
+	GLuint mGlyphBuffer;
+	GLuint mGlyphTexture;
+	std::vector<GLfloat> mGlyphs;
+	std::size_t mGlyphCapacity;
+
+	// The changes that have not been uploaded yet
+	std::uint32_t mDirtyAtlasTop = 0;
+	std::uint32_t mDirtyAtlasBottom = 0;
+	std::size_t mDirtyGlyphStart = 0;
+	std::size_t mDirtyGlyphEnd = 0;
+
+	/**
+	 * Returns the FreeType face of the calling thread, which is opened when first used
+	 */
+	FT_Face face();
+
+	/**
+	 * Adds the glyph that the font uses for missing characters as the placeholder
+	 */
+	void createPlaceholder();
+
+	/**
+	 * Sets the placeholder, which is what the characters that have not been added return
+	 * @param placeholder The placeholder
+	 */
+	void setPlaceholder(const FontCharacter& placeholder);
+
+	/**
+	 * Returns the entry of the given character in the table, where its page is allocated if empty
+	 * @param character The character
+	 */
+	FontCharacter& characterEntry(Char character);
+
+	/**
+	 * Adds a page of rows to the atlas, which reallocates the texture
+	 * @return True if the atlas could grow
+	 */
+	bool addPage();
+
+	/**
+	 * Sets the height of the atlas, which reallocates the texture with the content of the atlas
+	 * @param height The height
+	 */
+	void resizeAtlas(std::uint32_t height);
+
+	/**
+	 * Finds room for a glyph of the given size in the atlas
+	 * @param width The width of the glyph, including the padding
+	 * @param height The height of the glyph, including the padding
+	 * @param left The left of the room
+	 * @param top The top of the room
+	 * @return True if there was room
+	 */
+	bool allocate(std::uint32_t width, std::uint32_t height, std::uint32_t& left, std::uint32_t& top);
+
+	/**
+	 * Sets the metrics and texture coordinates of the given glyph in the buffer texture
+	 * @param glyphIndex The index of the glyph
+	 * @param metrics The bearing and size of the drawn glyph in pixels of the font
+	 * @param bounds The left, top, right and bottom texture coordinates in texels
+	 */
+	void setGlyph(std::uint32_t glyphIndex, const glm::vec4& metrics, const glm::vec4& bounds);
+
+	/**
+	 * Copies the given glyph into the atlas and sets the character to it
+	 * @param glyph The rasterized glyph
+	 * @param fontCharacter The character
+	 */
+	void placeGlyph(const RasterizedGlyph& glyph, FontCharacter& fontCharacter);
+
+	/**
+	 * Uploads the changed rows of the atlas and the changed glyphs
+	 */
+	void upload();
 public:
 	/**
-	 * Creates a new font map
+	 * Creates a new empty font map
 	 * @param name The name of the font
 	 * @param size The size of the font
-	 * @param characters The characters to load from the font
+	 * @param format The format of the glyphs
+	 * @param glyphsAvailable Called on a background thread when requested characters are ready to be uploaded
 	 */
-	FontMap(const std::string& name, std::uint32_t size, const std::vector<Char>& characters);
+	FontMap(const std::string& name,
+			std::uint32_t size,
+			GlyphFormat format,
+			std::function<void ()> glyphsAvailable = {});
 	~FontMap();
 
+	FontMap(const FontMap&) = delete;
+	FontMap& operator=(const FontMap&) = delete;
+
+	/**
+	 * Loads the atlas and the characters from the given cache file. The font map must be empty.
+	 * @param cacheFileName The name of the cache file
+	 * @return True if the cache was loaded, which is not the case if it is missing or for another font or format
+	 */
+	bool loadCache(const std::string& cacheFileName);
+
+	/**
+	 * Stores the atlas and the characters in the given cache file. Characters whose glyph is not ready are left out.
+	 * @param cacheFileName The name of the cache file
+	 */
+	void saveCache(const std::string& cacheFileName);
+
+	/**
+	 * Indicates if glyphs have been added since the font map was created or loaded from or stored in a cache
+	 */
+	bool hasNewGlyphs() const;
+
+	/**
+	 * Rasterizes the given characters on the calling thread and adds them to the atlas
+	 * @param characters The characters
+	 */
+	void addCharacters(const std::vector<Char>& characters);
+
+	/**
+	 * Adds the given character with a placeholder glyph, and requests its glyph from the background threads
+	 * @param character The character
+	 * @param advanceX The advance of the character until its glyph is ready
+	 * @return The added character
+	 */
+	const FontCharacter& requestCharacter(Char character, float advanceX);
+
+	/**
+	 * Uploads the glyphs that have been rasterized since the last call
+	 * @param advancesChanged Set to true if a character got a different advance than its placeholder
+	 * @return True if any glyph was uploaded
+	 */
+	bool uploadGlyphs(bool& advancesChanged);
+
+	/**
+	 * Returns the format of the glyphs
+	 */
+	GlyphFormat glyphFormat() const;
+
 	/**
 	 * Returns the texture map for the font
 	 */
 	GLuint textureMap() const;
 
 	/**
-	 * Returns the characters
+	 * Returns the buffer texture with the glyphs, indexed by the glyph index of the characters. Each glyph is two RGBA
+	 * texels: the bearing and size, followed by the left, top, right and bottom texture coordinates in texels.
 	 */
-	const std::unordered_map<Char, FontCharacter>& characters() const;
+	GLuint glyphTexture() const;
+
+	/**
+	 * Returns the height of a line
+	 */
+	float lineHeight() const;
+
+	/**
+	 * Returns the number of added characters
+	 */
+	std::size_t numCharacters() const;
+
+	/**
+	 * Returns the given character, or the placeholder with glyph index zero if it has not been added
+	 * @param character The character
+	 */
+	inline const FontCharacter& operator[](Char character) const {
+		if (character < PAGE_SIZE) {
+			return mLatin1Characters[character];
+		}
+
+		return (*mPages[character >> PAGE_BITS])[character & (PAGE_SIZE - 1)];
+	}
 };
 
 /**
@@ -64,48 +277,94 @@ class Font {
 private:
 	std::string mName;
 	std::uint32_t mSize;
+	GlyphFormat mFormat;
+	std::string mCacheFileName;
 
 	std::unique_ptr<FontMap> mFontMap;
-	std::vector<Char> mCreatedCharacters;
 
 	float mLineHeight = 0.0f;
 	bool mIsMonoSpace = true;
 	float mMonoSpaceAdvanceX = 0.0f;
 
-	/**
-	 * Creates the font map from the given character
-	 * @param characters The characters
-	 */
-	void createFontMap(const std::vector<Char>& characters);
+	std::uint64_t mVersion = 0;
+	std::uint64_t mAdvancesVersion = 0;
 public:
 	/**
-	 * Creates a new font
+	 * Creates a new font with the Latin-1 characters loaded. The font is treated as monospaced if all of these
+	 * characters have the same advance.
 	 * @param name The name of the font
 	 * @param size The size of the font
+	 * @param format The format of the glyphs, where distance fields can be drawn at any scale
+	 * @param cacheFileName The name of the cache file of the font map, or empty to not use a cache
+	 * @param glyphsAvailable Called on a background thread when requested characters are ready to be uploaded
+	 */
+	Font(const std::string& name,
+		 std::uint32_t size,
+		 GlyphFormat format = GlyphFormat::Coverage,
+		 const std::string& cacheFileName = "",
+		 std::function<void ()> glyphsAvailable = {});
+
+	/**
+	 * Stores the font map in the cache file if characters have been added, such that they are loaded at the next start
+	 */
+	void saveCache();
+
+	/**
+	 * Returns the format of the glyphs
 	 */
-	Font(const std::string& name, std::uint32_t size);
+	GlyphFormat glyphFormat() const;
 
 	/**
 	 * Returns the texture map for the font
 	 */
 	GLuint textureMap() const;
 
+	/**
+	 * Returns the buffer texture with the glyphs
+	 */
+	GLuint glyphTexture() const;
+
+	/**
+	 * Returns a number that changes when the glyphs of the characters change
+	 */
+	std::uint64_t version() const;
+
+	/**
+	 * Returns a number that changes when the advance of a character changes
+	 */
+	std::uint64_t advancesVersion() const;
+
+	/**
+	 * Uploads the glyphs of requested characters that have been rasterized, which should be done at the start of a frame
+	 * @return True if any glyph was uploaded
+	 */
+	bool uploadGlyphs();
+
 	/**
 	 * Returns the height of a line
 	 */
 	float lineHeight() const;
 
 	/**
-	 * Returns the given character
+	 * Returns the given character, or the placeholder if it has not been added
 	 * @param character The character
 	 */
-	const FontCharacter& operator[](Char character) const;
+	inline const FontCharacter& operator[](Char character) const {
+		return (*mFontMap)[character];
+	}
 
 	/**
-	 * Tries to get the given character (recreating the font if necessary)
+	 * Tries to get the given character. A new character is drawn with a placeholder until its glyph is uploaded.
 	 * @param character The character
 	 */
-	const FontCharacter& tryGet(Char character);
+	inline const FontCharacter& tryGet(Char character) {
+		auto& fontCharacter = (*mFontMap)[character];
+		if (fontCharacter.glyphIndex != 0) {
+			return fontCharacter;
+		}
+
+		return mFontMap->requestCharacter(character, mMonoSpaceAdvanceX);
+	}
 
 	/**
 	 * Returns the advance X for the given character
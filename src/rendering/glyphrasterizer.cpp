@@ -0,0 +1,183 @@
+#include "glyphrasterizer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+#include FT_MODULE_H
+
+GlyphRasterizer::GlyphRasterizer(const std::string& name,
+								 std::uint32_t size,
+								 GlyphFormat format,
+								 std::function<void ()> glyphsAvailable)
+	: mName(name), mSize(size), mFormat(format), mGlyphsAvailable(std::move(glyphsAvailable)) {
+	// One thread is left for the render thread
+	auto numThreads = std::max(std::min(std::thread::hardware_concurrency(), MAX_THREADS + 1), 2u) - 1;
+	for (unsigned int i = 0; i < numThreads; i++) {
+		mThreads.emplace_back(&GlyphRasterizer::run, this);
+	}
+}
+
+GlyphRasterizer::~GlyphRasterizer() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+
+	mRequestAdded.notify_all();
+	for (auto& thread : mThreads) {
+		thread.join();
+	}
+}
+
+bool GlyphRasterizer::openFace(const std::string& name,
+							   std::uint32_t size,
+							   GlyphFormat format,
+							   FT_Library& library,
+							   FT_Face& face) {
+	face = nullptr;
+	if (FT_Init_FreeType(&library)) {
+		library = nullptr;
+		return false;
+	}
+
+	if (format == GlyphFormat::DistanceField) {
+		FT_UInt spread = DISTANCE_FIELD_SPREAD;
+		FT_Property_Set(library, "sdf", "spread", &spread);
+	}
+
+	if (FT_New_Face(library, name.c_str(), 0, &face)) {
+		face = nullptr;
+		return false;
+	}
+
+	FT_Set_Pixel_Sizes(face, 0, format == GlyphFormat::DistanceField ? size * DISTANCE_FIELD_SCALE : size);
+	return true;
+}
+
+float GlyphRasterizer::glyphScale(GlyphFormat format) {
+	return format == GlyphFormat::DistanceField ? 1.0f / DISTANCE_FIELD_SCALE : 1.0f;
+}
+
+bool GlyphRasterizer::rasterizeGlyph(FT_Face face, FT_UInt glyphIndex, GlyphFormat format, RasterizedGlyph& glyph) {
+	glyph.isLoaded = false;
+	glyph.size = glm::ivec2(0, 0);
+	glyph.bearing = glm::ivec2(0, 0);
+	glyph.advanceX = 0.0f;
+	glyph.lineHeight = 0.0f;
+	glyph.padding = 0;
+	glyph.bitmap.clear();
+
+	if (format == GlyphFormat::Coverage) {
+		if (FT_Load_Glyph(face, glyphIndex, FT_LOAD_RENDER)) {
+			return false;
+		}
+	} else if (FT_Load_Glyph(face, glyphIndex, FT_LOAD_DEFAULT)
+			   || FT_Render_Glyph(face->glyph, FT_RENDER_MODE_SDF)) {
+		return false;
+	}
+
+	auto slot = face->glyph;
+	auto& bitmap = slot->bitmap;
+	glyph.isLoaded = true;
+	glyph.size = glm::ivec2(bitmap.width, bitmap.rows);
+	glyph.bearing = glm::ivec2(slot->bitmap_left, slot->bitmap_top);
+	glyph.advanceX = slot->advance.x / 64.0f;
+	glyph.lineHeight = slot->metrics.vertAdvance / 64.0f;
+
+	// The distance field extends the bitmap by the spread on each side, where the bearing includes the spread
+	if (format == GlyphFormat::DistanceField && bitmap.width > 0 && bitmap.rows > 0) {
+		glyph.padding = DISTANCE_FIELD_SPREAD;
+	}
+
+	glyph.bitmap.resize((std::size_t)bitmap.width * bitmap.rows);
+	for (std::uint32_t y = 0; y < bitmap.rows; y++) {
+		std::memcpy(&glyph.bitmap[(std::size_t)y * bitmap.width], &bitmap.buffer[(std::ptrdiff_t)y * bitmap.pitch], bitmap.width);
+	}
+
+	return true;
+}
+
+bool GlyphRasterizer::rasterize(FT_Face face, Char character, GlyphFormat format, RasterizedGlyph& glyph) {
+	static const std::unordered_map<Char, Char> glpyhReplacements = {
+		{ '\t', ' ' }
+	};
+
+	auto glpyhCharacter = character;
+	auto replacementIterator = glpyhReplacements.find(character);
+	if (replacementIterator != glpyhReplacements.end()) {
+		glpyhCharacter = replacementIterator->second;
+	}
+
+	glyph.character = character;
+	return rasterizeGlyph(face, FT_Get_Char_Index(face, glpyhCharacter), format, glyph);
+}
+
+void GlyphRasterizer::run() {
+	// The face is opened when the first character is requested, as most glyphs are usually already loaded
+	FT_Library library = nullptr;
+	FT_Face face = nullptr;
+	auto isOpened = false;
+
+	while (true) {
+		Char character;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mRequestAdded.wait(lock, [&]() { return mStop || !mRequests.empty(); });
+			if (mStop) {
+				break;
+			}
+
+			character = mRequests.front();
+			mRequests.pop_front();
+			mNumBusyThreads++;
+		}
+
+		if (!isOpened) {
+			isOpened = true;
+			openFace(mName, mSize, mFormat, library, face);
+		}
+
+		RasterizedGlyph glyph;
+		glyph.character = character;
+		if (face == nullptr || !rasterize(face, character, mFormat, glyph)) {
+			std::cerr << "Failed to load glyph." << std::endl;
+		}
+
+		bool isDone;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mFinishedGlyphs.push_back(std::move(glyph));
+			mNumBusyThreads--;
+			isDone = mRequests.empty() && mNumBusyThreads == 0;
+		}
+
+		// The glyphs are uploaded in a batch, which means that only the last glyph of the requests wakes the caller
+		if (isDone && mGlyphsAvailable) {
+			mGlyphsAvailable();
+		}
+	}
+
+	if (face != nullptr) {
+		FT_Done_Face(face);
+	}
+
+	if (library != nullptr) {
+		FT_Done_FreeType(library);
+	}
+}
+
+void GlyphRasterizer::request(Char character) {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRequests.push_back(character);
+	}
+
+	mRequestAdded.notify_one();
+}
+
+void GlyphRasterizer::takeFinishedGlyphs(std::vector<RasterizedGlyph>& glyphs) {
+	glyphs.clear();
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::swap(glyphs, mFinishedGlyphs);
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include "../text/text.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+/**
+ * The format of the rasterized glyphs
+ */
+enum class GlyphFormat : std::uint32_t {
+	Coverage, // The coverage of each pixel, which is drawn at the size of the font
+	DistanceField // The signed distance to the outline, which can be drawn at any scale
+};
+
+/**
+ * Represents the rasterized glyph of a character. The metrics are in pixels of the rasterized bitmap.
+ */
+struct RasterizedGlyph {
+	Char character = 0;
+	bool isLoaded = false;
+
+	glm::ivec2 size;
+	glm::ivec2 bearing;
+	float advanceX = 0.0f;
+	float lineHeight = 0.0f;
+
+	// The border around the outline that is part of the bitmap, which a distance field uses to fade out
+	std::int32_t padding = 0;
+
+	// The coverage or distance of the glyph, stored by row without padding
+	std::vector<std::uint8_t> bitmap;
+};
+
+/**
+ * Rasterizes glyphs on a pool of background threads. FreeType faces cannot be shared between threads, which means that
+ * each thread opens its own face of the font.
+ *
+ * Characters are rasterized in the order they are requested, and the finished glyphs are taken by the calling thread.
+ *
+ * Distance fields are rasterized at a multiple of the size of the font, which keeps the outlines sharp when drawn
+ * larger than the font.
+ */
+class GlyphRasterizer {
+private:
+	static constexpr unsigned int MAX_THREADS = 4;
+	static constexpr std::uint32_t DISTANCE_FIELD_SCALE = 2;
+	static constexpr std::uint32_t DISTANCE_FIELD_SPREAD = 8;
+
+	std::string mName;
+	std::uint32_t mSize;
+	GlyphFormat mFormat;
+
+	std::atomic<bool> mStop { false };
+	std::function<void ()> mGlyphsAvailable;
+
+	// Shared with the background threads
+	std::mutex mMutex;
+	std::condition_variable mRequestAdded;
+	std::deque<Char> mRequests;
+	std::vector<RasterizedGlyph> mFinishedGlyphs;
+	std::size_t mNumBusyThreads = 0;
+
+	std::vector<std::thread> mThreads;
+
+	/**
+	 * Rasterizes the requested characters until stopped
+	 */
+	void run();
+public:
+	/**
+	 * Creates a new glyph rasterizer
+	 * @param name The name of the font
+	 * @param size The size of the font
+	 * @param format The format of the glyphs
+	 * @param glyphsAvailable Called on a background thread when all requested characters have been rasterized
+	 */
+	GlyphRasterizer(const std::string& name,
+					std::uint32_t size,
+					GlyphFormat format,
+					std::function<void ()> glyphsAvailable = {});
+	~GlyphRasterizer();
+
+	GlyphRasterizer(const GlyphRasterizer&) = delete;
+	GlyphRasterizer& operator=(const GlyphRasterizer&) = delete;
+
+	/**
+	 * Opens the given font with a face that rasterizes glyphs of the given format
+	 * @param name The name of the font
+	 * @param size The size of the font
+	 * @param format The format of the glyphs
+	 * @param library The FreeType library, which must be freed even if the face could not be opened
+	 * @param face The face
+	 * @return True if the face was opened
+	 */
+	static bool openFace(const std::string& name,
+						 std::uint32_t size,
+						 GlyphFormat format,
+						 FT_Library& library,
+						 FT_Face& face);
+
+	/**
+	 * Returns the size of a pixel of the rasterized glyphs in pixels of the font
+	 * @param format The format of the glyphs
+	 */
+	static float glyphScale(GlyphFormat format);
+
+	/**
+	 * Loads and rasterizes the given glyph of the given face
+	 * @param face The face
+	 * @param glyphIndex The index of the glyph in the face
+	 * @param format The format of the glyph
+	 * @param glyph The rasterized glyph
+	 * @return True if the glyph was loaded
+	 */
+	static bool rasterizeGlyph(FT_Face face, FT_UInt glyphIndex, GlyphFormat format, RasterizedGlyph& glyph);
+
+	/**
+	 * Loads and rasterizes the glyph of the given character
+	 * @param face The face
+	 * @param character The character
+	 * @param format The format of the glyph
+	 * @param glyph The rasterized glyph
+	 * @return True if the glyph was loaded
+	 */
+	static bool rasterize(FT_Face face, Char character, GlyphFormat format, RasterizedGlyph& glyph);
+
+	/**
+	 * Requests the given character to be rasterized
+	 * @param character The character
+	 */
+	void request(Char character);
+
+	/**
+	 * Takes the glyphs that have been rasterized since the last call
+	 * @param glyphs The rasterized glyphs
+	 */
+	void takeFinishedGlyphs(std::vector<RasterizedGlyph>& glyphs);
+};
\ No newline at end of file
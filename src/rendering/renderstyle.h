@@ -24,6 +24,11 @@ struct RenderStyle {
 	glm::vec3 numberColor = glm::vec3(181.0f / 255.0f, 206.0f / 255.0f, 168.0f / 255.0f);
 	glm::vec3 commentColor = glm::vec3(73.0f / 255.0f, 132.0f / 255.0f, 78.0f / 255.0f);
 	glm::vec3 lineNumberColor = glm::vec3(76.0f / 255.0f, 76.0f / 255.0f, 76.0f / 255.0f);
+	glm::vec3 bracketHighlightColor = glm::vec3(255.0f / 255.0f, 215.0f / 255.0f, 0.0f / 255.0f);
+	glm::vec3 symbolHighlightColor = glm::vec3(156.0f / 255.0f, 220.0f / 255.0f, 254.0f / 255.0f);
+	glm::vec3 completionBackgroundColor = glm::vec3(37.0f / 255.0f, 37.0f / 255.0f, 38.0f / 255.0f);
+	glm::vec3 completionSelectionColor = glm::vec3(4.0f / 255.0f, 57.0f / 255.0f, 94.0f / 255.0f);
+	glm::vec3 misspellingColor = glm::vec3(244.0f / 255.0f, 71.0f / 255.0f, 71.0f / 255.0f);
 
 	/**
 	 * Returns the color of the given token
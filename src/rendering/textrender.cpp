@@ -2,6 +2,8 @@
 #include "font.h"
 #include "common/glhelpers.h"
 #include "../text/textformatter.h"
+#include "../text/bracketindex.h"
+#include "../text/symbolindex.h"
 #include "renderstyle.h"
 #include "renderviewport.h"
 #include "../interface/textview.h"
@@ -9,15 +11,14 @@
 #include "../interface/inputmanager.h"
 
 #include <vector>
+#include <cstddef>
 #include <iostream>
 #include <cmath>
 #include <codecvt>
 #include <locale>
 
 namespace {
-	const std::size_t NUM_TRIANGLES = 6;
-	const std::size_t MAX_CHARACTERS = 200;
-	const std::size_t FLOATS_PER_CHARACTER = NUM_TRIANGLES * (2 + 2 + 3);
+	const std::size_t NUM_VERTICES = 6;
 
 	Char convertFromChar(char character) {
 		return (Char)character;
@@ -40,74 +41,175 @@ TextRender::TextRender(const ShaderProgram& shaderProgram)
 	glGenVertexArrays(1, &mVAO);
 	glGenBuffers(1, &mVBO);
 	glBindVertexArray(mVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * FLOATS_PER_CHARACTER * MAX_CHARACTERS, nullptr, GL_DYNAMIC_DRAW);
-
-	auto vertexSize = (2 + 2 + 3) * sizeof(GLfloat);
-	auto posAttribute = glGetAttribLocation(shaderProgram.id(), "vertexPosition");
-	glEnableVertexAttribArray(posAttribute);
-	glVertexAttribPointer(posAttribute, 2, GL_FLOAT, GL_FALSE, vertexSize, nullptr);
+	setupGlyphAttributes(mVBO);
+	glBindVertexArray(0);
 
-	auto texAttribute = glGetAttribLocation(shaderProgram.id(), "vertexTexcoord");
-	glEnableVertexAttribArray(texAttribute);
-	glVertexAttribPointer(texAttribute, 2, GL_FLOAT, GL_FALSE, vertexSize, (void*)(2 * sizeof(GLfloat)));
+	glUseProgram(shaderProgram.id());
+	glUniform1i(glGetUniformLocation(shaderProgram.id(), "glyphs"), 1);
+	mPaletteUniform = glGetUniformLocation(shaderProgram.id(), "palette");
+	mLineOffsetUniform = glGetUniformLocation(shaderProgram.id(), "lineOffset");
 
-	auto colorAttribute = glGetAttribLocation(shaderProgram.id(), "vertexColor");
-	glEnableVertexAttribArray(colorAttribute);
-	glVertexAttribPointer(colorAttribute, 3, GL_FLOAT, GL_FALSE, vertexSize, (void*)((2 + 2) * sizeof(GLfloat)));
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	mGlyphs.reserve(MAX_GLYPHS);
+	mPalette.reserve(MAX_COLORS);
 }
 
 TextRender::~TextRender() {
 	glDeleteVertexArrays(1, &mVAO);
 	glDeleteBuffers(1, &mVBO);
+
+	for (auto& cachedLine : mCachedLines) {
+		mFreeCachedLines.push_back(cachedLine.second);
+	}
+
+	for (auto& cachedLine : mFreeCachedLines) {
+		glDeleteVertexArrays(1, &cachedLine.vao);
+		glDeleteBuffers(1, &cachedLine.vbo);
+	}
 }
 
-void TextRender::setCharacterVertices(GLfloat* charactersVertices,
-									  std::size_t offset,
-									  Font& font,
-									  Char character,
-									  float currentX,
-									  float currentY,
-									  glm::vec3 color) {
-	auto& fontCharacter = font.tryGet(character);
+void TextRender::setupGlyphAttributes(GLuint vbo) {
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
-	GLfloat drawPosX = currentX + fontCharacter.bearing.x;
-	GLfloat drawPosY = -currentY - (fontCharacter.size.y - fontCharacter.bearing.y);
+	// Each glyph is an instance, where the vertices of the quad are generated by the vertex shader
+	auto glyphSize = sizeof(GlyphInstance);
+	auto posAttribute = glGetAttribLocation(mShaderProgram.id(), "glyphPosition");
+	glEnableVertexAttribArray(posAttribute);
+	glVertexAttribPointer(posAttribute, 2, GL_FLOAT, GL_FALSE, glyphSize, (void*)offsetof(GlyphInstance, x));
+	glVertexAttribDivisor(posAttribute, 1);
 
-	GLfloat drawWidth = fontCharacter.size.x;
-	GLfloat drawHeight = fontCharacter.size.y;
+	auto glyphAttribute = glGetAttribLocation(mShaderProgram.id(), "glyphIndex");
+	glEnableVertexAttribArray(glyphAttribute);
+	glVertexAttribIPointer(glyphAttribute, 1, GL_UNSIGNED_INT, glyphSize, (void*)offsetof(GlyphInstance, glyphIndex));
+	glVertexAttribDivisor(glyphAttribute, 1);
 
-	float top = fontCharacter.textureTop;
-	float left = fontCharacter.textureLeft;
-	float bottom = fontCharacter.textureBottom;
-	float right = fontCharacter.textureRight;
+	auto colorAttribute = glGetAttribLocation(mShaderProgram.id(), "colorIndex");
+	glEnableVertexAttribArray(colorAttribute);
+	glVertexAttribIPointer(colorAttribute, 1, GL_UNSIGNED_INT, glyphSize, (void*)offsetof(GlyphInstance, colorIndex));
+	glVertexAttribDivisor(colorAttribute, 1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GLuint TextRender::colorIndex(glm::vec3 color) {
+	for (std::size_t i = 0; i < mPalette.size(); i++) {
+		if (mPalette[i] == color) {
+			return (GLuint)i;
+		}
+	}
+
+	if (mPalette.size() == MAX_COLORS) {
+		drawGlyphs();
+	}
 
-	// Batch draw calls
-	GLfloat vertices[] = {
-		drawPosX, (drawPosY + drawHeight), left, top, color.r, color.g, color.b,
-		drawPosX, drawPosY, left, bottom, color.r, color.g, color.b,
-		(drawPosX + drawWidth), drawPosY, right, bottom, color.r, color.g, color.b,
+	mPalette.push_back(color);
+	return (GLuint)(mPalette.size() - 1);
+}
 
-		drawPosX, (drawPosY + drawHeight), left, top, color.r, color.g, color.b,
-		(drawPosX + drawWidth), drawPosY, right, bottom, color.r, color.g, color.b,
-		(drawPosX + drawWidth), (drawPosY + drawHeight), right, top, color.r, color.g, color.b
-	};
+void TextRender::addCharacter(Font& font, Char character, float currentX, float currentY, glm::vec3 color) {
+	auto& fontCharacter = font.tryGet(character);
+	auto glyphColor = colorIndex(color);
+	mGlyphs.push_back({ currentX, currentY, fontCharacter.glyphIndex, glyphColor });
 
-	for (std::size_t i = 0; i < FLOATS_PER_CHARACTER; i++) {
-		charactersVertices[offset + i] = vertices[i];
+	if (mGlyphs.size() == MAX_GLYPHS) {
+		drawGlyphs();
 	}
 }
 
 void TextRender::setupRendering(const Font& font) {
 	glBindVertexArray(mVAO);
 	glUseProgram(mShaderProgram.id());
+	glUniform2f(mLineOffsetUniform, 0.0f, 0.0f);
+	mFont = &font;
+}
+
+void TextRender::bindFontTextures() {
+	// The textures are bound when drawing, as other renders bind their own textures in between
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, mFont->glyphTexture());
 	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, mFont->textureMap());
+}
+
+void TextRender::drawGlyphs() {
+	if (!mGlyphs.empty()) {
+		bindFontTextures();
+		glUniform3fv(mPaletteUniform, (GLsizei)mPalette.size(), &mPalette[0].x);
+
+		glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GlyphInstance) * mGlyphs.size(), mGlyphs.data(), GL_STREAM_DRAW);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, NUM_VERTICES, (GLsizei)mGlyphs.size());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	mGlyphs.clear();
+	mPalette.clear();
+}
+
+void TextRender::validateCachedLines(const Font& font, const RenderStyle& renderStyle) {
+	// The positions of the glyphs depend on the advances of the font and the width of tabs
+	if (mCachedFont == &font
+		&& mCachedAdvancesVersion == font.advancesVersion()
+		&& mCachedSpacesPerTab == renderStyle.spacesPerTab) {
+		return;
+	}
+
+	for (auto& cachedLine : mCachedLines) {
+		mFreeCachedLines.push_back(cachedLine.second);
+	}
+
+	mCachedLines.clear();
+	mCachedFont = &font;
+	mCachedAdvancesVersion = font.advancesVersion();
+	mCachedSpacesPerTab = renderStyle.spacesPerTab;
+}
+
+TextRender::CachedLine& TextRender::createCachedLine(Font& font,
+													 const RenderStyle& renderStyle,
+													 const FormattedLine& line) {
+	CachedLine cachedLine;
+	if (!mFreeCachedLines.empty()) {
+		cachedLine = mFreeCachedLines.back();
+		mFreeCachedLines.pop_back();
+	} else {
+		glGenVertexArrays(1, &cachedLine.vao);
+		glGenBuffers(1, &cachedLine.vbo);
+		glBindVertexArray(cachedLine.vao);
+		setupGlyphAttributes(cachedLine.vbo);
+	}
+
+	// The color of a glyph is given by the type of its token, which is the index in the palette set when drawing
+	float currentX = 0.0f;
+	for (auto& token : line.tokens) {
+		for (auto& character : token.text) {
+			mGlyphs.push_back({ currentX, 0.0f, font.tryGet(character).glyphIndex, (GLuint)token.type });
+			currentX += renderStyle.getAdvanceX(font, character);
+		}
+	}
 
-	glBindTexture(GL_TEXTURE_2D, font.textureMap());
-	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	cachedLine.numGlyphs = (GLsizei)mGlyphs.size();
+	if (!mGlyphs.empty()) {
+		glBindBuffer(GL_ARRAY_BUFFER, cachedLine.vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GlyphInstance) * mGlyphs.size(), mGlyphs.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	mGlyphs.clear();
+	return mCachedLines[line.version] = cachedLine;
+}
+
+void TextRender::evictCachedLines() {
+	if (mCachedLines.size() <= MAX_CACHED_LINES) {
+		return;
+	}
+
+	for (auto it = mCachedLines.begin(); it != mCachedLines.end();) {
+		if (it->second.lastUsedFrame != mFrame) {
+			mFreeCachedLines.push_back(it->second);
+			it = mCachedLines.erase(it);
+		} else {
+			++it;
+		}
+	}
 }
 
 void TextRender::renderView(const Font& font,
@@ -117,25 +219,6 @@ void TextRender::renderView(const Font& font,
 							RenderLine renderLine) {
 	setupRendering(font);
 
-	GLfloat charactersVertices[sizeof(GLfloat) * FLOATS_PER_CHARACTER * MAX_CHARACTERS];
-	std::size_t numCharactersDrawn = 0;
-	std::size_t charactersOffset = 0;
-
-	auto drawCharacters = [&]() {
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * FLOATS_PER_CHARACTER * numCharactersDrawn, charactersVertices);
-		glDrawArrays(GL_TRIANGLES, 0, NUM_TRIANGLES * numCharactersDrawn);
-		numCharactersDrawn = 0;
-		charactersOffset = 0;
-	};
-
-	auto drawCharacter = [&]() {
-		numCharactersDrawn++;
-		charactersOffset += FLOATS_PER_CHARACTER;
-		if (numCharactersDrawn >= MAX_CHARACTERS) {
-			drawCharacters();
-		}
-	};
-
 	auto cursorLineIndex = (std::int64_t)std::floor(-position.y / font.lineHeight());
 	float offsetY = 0.0f;
 
@@ -147,14 +230,7 @@ void TextRender::renderView(const Font& font,
 			RenderViewPort currentView { drawPosition, viewPort.width, viewPort.height };
 
 			if (drawPosition.y >= viewPort.top()) {
-				renderLine(
-					charactersVertices,
-					charactersOffset,
-					drawCharacter,
-					lineIndex,
-					currentView,
-					drawPosition);
-
+				renderLine(lineIndex, currentView, drawPosition);
 				offsetY += drawPosition.y - originalY;
 			}
 
@@ -164,11 +240,7 @@ void TextRender::renderView(const Font& font,
 		}
 	}
 
-	if (numCharactersDrawn > 0) {
-		drawCharacters();
-	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	drawGlyphs();
 }
 
 void TextRender::render(Font& font,
@@ -177,59 +249,46 @@ void TextRender::render(Font& font,
 						const BaseFormattedText& text,
 						glm::vec2 position,
 						float lineNumberSpacing) {
-	renderView(font, text.numLines(), viewPort, position, [&](GLfloat* vertices,
-															  std::size_t& offset,
-															  std::function<void()> drawCharacter,
-															  std::int64_t lineIndex,
+	validateCachedLines(font, renderStyle);
+	mFrame++;
+
+	// The palette has the color of each token type, as the cached glyphs are colored by the type of their token
+	setupRendering(font);
+	Token token;
+	mPalette.resize(MAX_COLORS);
+	for (auto type : { TokenType::Text, TokenType::Number, TokenType::Keyword, TokenType::String, TokenType::Comment }) {
+		token.type = type;
+		mPalette[(std::size_t)type] = renderStyle.getColor(token);
+	}
+
+	glUniform3fv(mPaletteUniform, (GLsizei)mPalette.size(), &mPalette[0].x);
+	mPalette.clear();
+	bindFontTextures();
+
+	renderView(font, text.numLines(), viewPort, position, [&](std::int64_t lineIndex,
 															  const RenderViewPort& currentView,
 															  glm::vec2& drawPosition) {
 		auto& line = text.getLine((std::size_t)lineIndex);
 
-		// // Start by drawing the line number
-		// float currentLineNumberSpacing = 0.0f;
-		// if (!line.isContinuation) {
-		// 	auto lineNumber = numericToString<String>(line.number + 1);
-		// 	for (auto& character : lineNumber) {
-		// 		setCharacterVertices(
-		// 			vertices,
-		// 			offset,
-		// 			font,
-		// 			character,
-		// 			drawPosition.x,
-		// 			drawPosition.y,
-		// 			renderStyle.lineNumberColor);
-
-		// 		auto advanceX = renderStyle.getAdvanceX(font, character);
-		// 		drawPosition.x += advanceX;
-		// 		currentLineNumberSpacing += advanceX;
-		// 		drawCharacter();
-		// 	}
-		// }
-
-		// // Then the text on the line
-		// auto actualLineNumberSpacing = lineNumberSpacing - currentLineNumberSpacing;
-		// drawPosition.x += actualLineNumberSpacing;
-
-		for (auto& token : line.tokens) {
-			auto color = renderStyle.getColor(token);
-
-			for (auto& character : token.text) {
-				auto advanceX = renderStyle.getAdvanceX(font, character);
-
-				setCharacterVertices(
-					vertices,
-					offset,
-					font,
-					character,
-					drawPosition.x,
-					drawPosition.y,
-					color);
+		auto cachedLineIterator = mCachedLines.find(line.version);
+		CachedLine* cachedLine;
+		if (cachedLineIterator != mCachedLines.end()) {
+			cachedLine = &cachedLineIterator->second;
+		} else {
+			cachedLine = &createCachedLine(font, renderStyle, line);
+			bindFontTextures();
+		}
 
-				drawPosition.x += advanceX;
-				drawCharacter();
-			}
+		cachedLine->lastUsedFrame = mFrame;
+		if (cachedLine->numGlyphs > 0) {
+			glBindVertexArray(cachedLine->vao);
+			glUniform2f(mLineOffsetUniform, drawPosition.x, drawPosition.y);
+			glDrawArraysInstanced(GL_TRIANGLES, 0, NUM_VERTICES, cachedLine->numGlyphs);
 		}
 	});
+
+	glUniform2f(mLineOffsetUniform, 0.0f, 0.0f);
+	evictCachedLines();
 }
 
 void TextRender::renderLineNumbers(Font& font,
@@ -239,25 +298,20 @@ void TextRender::renderLineNumbers(Font& font,
 								   glm::vec2 position) {
 	auto maxLineNumber = numericToString<String>(text.numLines() + 1);
 
-	renderView(font, text.numLines(), viewPort, position, [&](GLfloat* vertices,
-															  std::size_t& offset,
-															  std::function<void()> drawCharacter,
-															  std::int64_t lineIndex,
+	renderView(font, text.numLines(), viewPort, position, [&](std::int64_t lineIndex,
 															  const RenderViewPort& currentView,
 															  glm::vec2& drawPosition) {
 		auto& line = text.getLine((std::size_t)lineIndex);
 
 		if (!line.isContinuation) {
-			auto lineNumber = numericToString<String>(line.number + 1);
+			auto lineNumber = numericToString<String>(text.getTextLineIndex((std::size_t)lineIndex) + 1);
 			auto whitespaceSpacing = renderStyle.getAdvanceX(font, convertFromChar(' '));
 			for (std::size_t i = 0; i < maxLineNumber.size() - lineNumber.size(); i++) {
 				drawPosition.x += whitespaceSpacing;
 			}
 
 			for (auto& character : lineNumber) {
-				setCharacterVertices(
-					vertices,
-					offset,
+				addCharacter(
 					font,
 					character,
 					drawPosition.x,
@@ -265,12 +319,25 @@ void TextRender::renderLineNumbers(Font& font,
 					renderStyle.lineNumberColor);
 
 				drawPosition.x += renderStyle.getAdvanceX(font, character);
-				drawCharacter();
 			}
 		}
 	});
 }
 
+void TextRender::renderText(Font& font,
+							const RenderStyle& renderStyle,
+							const String& text,
+							glm::vec2 position,
+							glm::vec3 color) {
+	setupRendering(font);
+	for (auto character : text) {
+		addCharacter(font, character, position.x, position.y, color);
+		position.x += renderStyle.getAdvanceX(font, character);
+	}
+
+	drawGlyphs();
+}
+
 void TextRender::renderCaret(Font& font,
 							 const RenderStyle& renderStyle,
 							 const TextMetrics& textMetrics,
@@ -279,26 +346,90 @@ void TextRender::renderCaret(Font& font,
 							 glm::vec2 spacing,
 							 const InputState& inputState) {
 	setupRendering(font);
-	GLfloat charactersVertices[sizeof(GLfloat) * FLOATS_PER_CHARACTER];
-
 	auto& fontCharacter = font['|'];
 
-	auto lineOffset = textMetrics.calculatePositionX(
-		text,
+	// When word wrapped, the caret is shown at the row that contains it
+	auto visualLineIndex = text.getVisualLineIndex(
 		(std::size_t)inputState.caretLineIndex,
 		(std::size_t)inputState.caretCharIndex);
 
-	setCharacterVertices(
-		charactersVertices,
-		0,
+	auto lineOffset = textMetrics.calculatePositionX(
+		text,
+		visualLineIndex,
+		(std::size_t)inputState.caretCharIndex - text.getLine(visualLineIndex).offsetFromTextLine);
+
+	addCharacter(
 		font,
 		'|',
 		inputState.viewPosition.x + spacing.x + lineOffset - fontCharacter.size.x,
-		inputState.viewPosition.y + spacing.y + (inputState.caretLineIndex + 1) * font.lineHeight(),
+		inputState.viewPosition.y + spacing.y + (visualLineIndex + 1) * font.lineHeight(),
 		renderStyle.textColor);
 
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * FLOATS_PER_CHARACTER, charactersVertices);
-	glDrawArrays(GL_TRIANGLES, 0, NUM_TRIANGLES);
+	drawGlyphs();
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-}
\ No newline at end of file
+void TextRender::renderBracketPair(Font& font,
+								   const RenderStyle& renderStyle,
+								   const TextMetrics& textMetrics,
+								   const BaseFormattedText& text,
+								   glm::vec2 spacing,
+								   const InputState& inputState,
+								   const BracketIndex& bracketIndex,
+								   const BracketPosition& first,
+								   const BracketPosition& second) {
+	setupRendering(font);
+	for (auto& position : { first, second }) {
+		auto bracket = bracketIndex.findBracket(position);
+		if (bracket == nullptr) {
+			continue;
+		}
+
+		// The bracket is drawn over the already rendered character
+		auto visualLineIndex = text.getVisualLineIndex(position.lineIndex, position.charIndex);
+		auto lineOffset = textMetrics.calculatePositionX(
+			text,
+			visualLineIndex,
+			position.charIndex - text.getLine(visualLineIndex).offsetFromTextLine);
+
+		addCharacter(
+			font,
+			bracket->character(),
+			inputState.viewPosition.x + spacing.x + lineOffset,
+			inputState.viewPosition.y + spacing.y + (visualLineIndex + 1) * font.lineHeight(),
+			renderStyle.bracketHighlightColor);
+	}
+
+	drawGlyphs();
+}
+
+void TextRender::renderSymbolOccurrences(Font& font,
+										 const RenderStyle& renderStyle,
+										 const TextMetrics& textMetrics,
+										 const BaseFormattedText& text,
+										 glm::vec2 spacing,
+										 const InputState& inputState,
+										 const String& symbol,
+										 const std::vector<SymbolPosition>& positions) {
+	setupRendering(font);
+	for (auto& position : positions) {
+		// The identifier is drawn over the already rendered characters, where each character is placed on its own
+		// row as a word wrapped identifier can span rows
+		for (std::size_t i = 0; i < symbol.size(); i++) {
+			auto charIndex = position.charIndex + i;
+			auto visualLineIndex = text.getVisualLineIndex(position.lineIndex, charIndex);
+			auto lineOffset = textMetrics.calculatePositionX(
+				text,
+				visualLineIndex,
+				charIndex - text.getLine(visualLineIndex).offsetFromTextLine);
+
+			addCharacter(
+				font,
+				symbol[i],
+				inputState.viewPosition.x + spacing.x + lineOffset,
+				inputState.viewPosition.y + spacing.y + (visualLineIndex + 1) * font.lineHeight(),
+				renderStyle.symbolHighlightColor);
+		}
+	}
+
+	drawGlyphs();
+}
@@ -2,6 +2,8 @@
 #include "../text/text.h"
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -15,8 +17,12 @@ class Font;
 struct RenderStyle;
 struct RenderViewPort;
 class BaseFormattedText;
+struct FormattedLine;
 struct InputState;
 class TextMetrics;
+class BracketIndex;
+struct BracketPosition;
+struct SymbolPosition;
 class ShaderProgram;
 
 enum class FormatMode : std::uint8_t;
@@ -26,27 +32,71 @@ enum class FormatMode : std::uint8_t;
  */
 class TextRender {
 private:
+	/**
+	 * A glyph to draw. The metrics and texture coordinates of the glyph are looked up in the glyph texture of the font
+	 * and the color in the palette, which means that a glyph is a single instance of 16 bytes.
+	 */
+	struct GlyphInstance {
+		GLfloat x;
+		GLfloat y;
+		GLuint glyphIndex;
+		GLuint colorIndex;
+	};
+
+	/**
+	 * The glyphs of a formatted line that are kept on the GPU between frames. The glyphs are positioned relative to
+	 * the start of the line and colored by the type of their token, which means that the line is drawn anywhere by
+	 * setting its offset.
+	 */
+	struct CachedLine {
+		GLuint vao = 0;
+		GLuint vbo = 0;
+		GLsizei numGlyphs = 0;
+		std::uint64_t lastUsedFrame = 0;
+	};
+
+	static constexpr std::size_t MAX_GLYPHS = 16384;
+	static constexpr std::size_t MAX_COLORS = 16;
+	static constexpr std::size_t MAX_CACHED_LINES = 2048;
+
 	GLuint mVAO;
 	GLuint mVBO;
 	const ShaderProgram& mShaderProgram;
+	GLint mPaletteUniform;
+	GLint mLineOffsetUniform;
+
+	const Font* mFont = nullptr;
+	std::vector<GlyphInstance> mGlyphs;
+	std::vector<glm::vec3> mPalette;
+
+	std::unordered_map<std::uint64_t, CachedLine> mCachedLines;
+	std::vector<CachedLine> mFreeCachedLines;
+	const Font* mCachedFont = nullptr;
+	std::uint64_t mCachedAdvancesVersion = 0;
+	std::size_t mCachedSpacesPerTab = 0;
+	std::uint64_t mFrame = 0;
+
+	/**
+	 * Sets up the glyph attributes of the currently bound vertex array, sourced from the given buffer
+	 * @param vbo The buffer with the glyphs
+	 */
+	void setupGlyphAttributes(GLuint vbo);
+
+	/**
+	 * Returns the index of the given color in the palette, which is added if new
+	 * @param color The color
+	 */
+	GLuint colorIndex(glm::vec3 color);
 
 	/**
-	 * Sets the vertices for the given character
-	 * @param charactersVertices The array of character vertices
-	 * @param offset The offset for the character
+	 * Adds the given character to the glyphs to draw
 	 * @param font The font
 	 * @param character The character
 	 * @param currentX The x position
 	 * @param currentY The y position
 	 * @param color The color
 	 */
-	void setCharacterVertices(GLfloat* charactersVertices,
-							  std::size_t offset,
-							  Font& font,
-							  Char character,
-							  float currentX,
-							  float currentY,
-							  glm::vec3 color);
+	void addCharacter(Font& font, Char character, float currentX, float currentY, glm::vec3 color);
 
 	/**
 	 * Initializes the rendering
@@ -54,7 +104,37 @@ private:
 	 */
 	void setupRendering(const Font& font);
 
-	using RenderLine = std::function<void (GLfloat* vertices, std::size_t& offset, std::function<void()>, std::int64_t, const RenderViewPort&, glm::vec2&)>;
+	/**
+	 * Binds the texture map and glyph texture of the current font
+	 */
+	void bindFontTextures();
+
+	/**
+	 * Draws the added glyphs in a single draw call
+	 */
+	void drawGlyphs();
+
+	/**
+	 * Removes the cached lines if they were created with another font or render style
+	 * @param font The font
+	 * @param renderStyle The render style
+	 */
+	void validateCachedLines(const Font& font, const RenderStyle& renderStyle);
+
+	/**
+	 * Creates the cached glyphs of the given line, reusing the buffers of an evicted line if possible
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param line The line
+	 */
+	CachedLine& createCachedLine(Font& font, const RenderStyle& renderStyle, const FormattedLine& line);
+
+	/**
+	 * Evicts the lines that were not drawn in the current frame when there are too many cached lines
+	 */
+	void evictCachedLines();
+
+	using RenderLine = std::function<void (std::int64_t, const RenderViewPort&, glm::vec2&)>;
 
 	/**
 	 * Renders the current view
@@ -78,7 +158,9 @@ public:
 	~TextRender();
 
 	/**
-	 * Renders the given text at the given position
+	 * Renders the given text at the given position. The glyphs of each line are cached on the GPU by the version of
+	 * the line, which means that only new or changed lines are created, and the other lines are just drawn at their
+	 * current position.
 	 * @param font The font
 	 * @param renderStyle The render style
 	 * @param viewPort The view port to render to
@@ -107,6 +189,20 @@ public:
 						   const BaseFormattedText& text,
 						   glm::vec2 position);
 
+	/**
+	 * Renders the given text on a single line
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param text The text
+	 * @param position The position of the baseline to render at
+	 * @param color The color
+	 */
+	void renderText(Font& font,
+					const RenderStyle& renderStyle,
+					const String& text,
+					glm::vec2 position,
+					glm::vec3 color);
+
 	/**
 	 * Renders the caret
 	 * @param font The font
@@ -124,4 +220,46 @@ public:
 					 const BaseFormattedText& text,
 					 glm::vec2 spacing,
 					 const InputState& inputState);
+
+	/**
+	 * Renders the brackets of a matching pair in the highlight color
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param textMetrics The text metrics
+	 * @param text The formatted text
+	 * @param spacing The spacing
+	 * @param inputState The input state
+	 * @param bracketIndex The bracket index
+	 * @param first The first bracket
+	 * @param second The second bracket
+	 */
+	void renderBracketPair(Font& font,
+						   const RenderStyle& renderStyle,
+						   const TextMetrics& textMetrics,
+						   const BaseFormattedText& text,
+						   glm::vec2 spacing,
+						   const InputState& inputState,
+						   const BracketIndex& bracketIndex,
+						   const BracketPosition& first,
+						   const BracketPosition& second);
+
+	/**
+	 * Renders the occurrences of an identifier in the highlight color
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param textMetrics The text metrics
+	 * @param text The formatted text
+	 * @param spacing The spacing
+	 * @param inputState The input state
+	 * @param symbol The identifier
+	 * @param positions The positions of the occurrences
+	 */
+	void renderSymbolOccurrences(Font& font,
+								 const RenderStyle& renderStyle,
+								 const TextMetrics& textMetrics,
+								 const BaseFormattedText& text,
+								 glm::vec2 spacing,
+								 const InputState& inputState,
+								 const String& symbol,
+								 const std::vector<SymbolPosition>& positions);
 };
\ No newline at end of file
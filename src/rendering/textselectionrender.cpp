@@ -57,7 +57,7 @@ void TextSelectionRender::render(const WindowState& windowState,
 		std::size_t selectionLineCharStartIndex = 0;
 		auto lineOffset = 0.0f;
 
-		float selectionLineWidth = windowState.width();
+		float selectionLineWidth = windowState.width() / windowState.zoom();
 		float selectionLineHeight = font.lineHeight();
 
 		// Note: formatted line only guaranteed to be available for first and last line.
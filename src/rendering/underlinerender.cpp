@@ -0,0 +1,115 @@
+#include "underlinerender.h"
+#include "common/shadercompiler.h"
+#include "font.h"
+#include "textmetrics.h"
+
+#include "../helpers.h"
+#include "../windowstate.h"
+#include "../text/formattedtext.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+UnderlineRender::UnderlineRender()
+	: mShaderProgram(Helpers::readFileAsUTF8Text("shaders/selectionVertex.glsl"), Helpers::readFileAsUTF8Text("shaders/solid.glsl")) {
+	glGenVertexArrays(1, &mVAO);
+	glGenBuffers(1, &mVBO);
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+
+	glUseProgram(mShaderProgram.id());
+
+	auto posAttribute = glGetAttribLocation(mShaderProgram.id(), "vertexPosition");
+	glEnableVertexAttribArray(posAttribute);
+	glVertexAttribPointer(posAttribute, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), nullptr);
+
+	auto colorAttribute = glGetAttribLocation(mShaderProgram.id(), "vertexColor");
+	glEnableVertexAttribArray(colorAttribute);
+	glVertexAttribPointer(colorAttribute, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)(2 * sizeof(GLfloat)));
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+UnderlineRender::~UnderlineRender() {
+	glDeleteVertexArrays(1, &mVAO);
+	glDeleteBuffers(1, &mVBO);
+}
+
+void UnderlineRender::addUnderline(float left, float right, float baseline, float thickness, glm::vec3 color) {
+	// The y-axis points up in the projection
+	auto top = -baseline;
+	auto bottom = -(baseline + thickness);
+
+	GLfloat vertices[] = {
+		left, top, color.r, color.g, color.b,
+		right, top, color.r, color.g, color.b,
+		left, bottom, color.r, color.g, color.b,
+
+		left, bottom, color.r, color.g, color.b,
+		right, bottom, color.r, color.g, color.b,
+		right, top, color.r, color.g, color.b,
+	};
+
+	mVertices.insert(mVertices.end(), std::begin(vertices), std::end(vertices));
+}
+
+void UnderlineRender::render(const WindowState& windowState,
+							 const Font& font,
+							 const TextMetrics& textMetrics,
+							 const BaseFormattedText& formattedText,
+							 glm::vec2 offset,
+							 const std::vector<Misspelling>& ranges,
+							 glm::vec3 color) {
+	if (ranges.empty()) {
+		return;
+	}
+
+	// The line is placed halfway into the descent of '|'
+	auto& fontCharacter = font['|'];
+	auto descent = fontCharacter.size.y - fontCharacter.bearing.y;
+	auto thickness = std::max(std::round(font.lineHeight() / 16.0f), 1.0f);
+
+	mVertices.clear();
+	for (auto& range : ranges) {
+		auto endCharIndex = range.charIndex + range.length;
+		auto firstVisualLineIndex = formattedText.getVisualLineIndex(range.lineIndex, range.charIndex);
+		auto lastVisualLineIndex = formattedText.getVisualLineIndex(range.lineIndex, endCharIndex - 1);
+
+		// A word wrapped range is underlined on each row that it spans
+		for (auto visualLineIndex = firstVisualLineIndex; visualLineIndex <= lastVisualLineIndex; visualLineIndex++) {
+			auto& line = formattedText.getLine(visualLineIndex);
+			auto lineStart = line.offsetFromTextLine;
+			auto lineEnd = lineStart + line.length();
+			auto start = std::max(range.charIndex, lineStart);
+			auto end = std::min(endCharIndex, lineEnd);
+			if (start >= end) {
+				continue;
+			}
+
+			addUnderline(
+				offset.x + textMetrics.calculatePositionX(formattedText, visualLineIndex, start - lineStart),
+				offset.x + textMetrics.calculatePositionX(formattedText, visualLineIndex, end - lineStart),
+				offset.y + (visualLineIndex + 1) * font.lineHeight() + std::round(descent / 2.0f),
+				thickness,
+				color);
+		}
+	}
+
+	glUseProgram(mShaderProgram.id());
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	mShaderProgram.setParameters({ ShaderParameter::float4x4MatrixParameter("projection", windowState.projection()) });
+
+	if (mVertices.size() > mBufferSize) {
+		mBufferSize = mVertices.size();
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * mBufferSize, nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * mVertices.size(), mVertices.data());
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(mVertices.size() / 5));
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
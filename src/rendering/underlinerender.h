@@ -0,0 +1,58 @@
+#pragma once
+#include "common/shaderprogram.h"
+#include "../text/spellchecker.h"
+
+#include <GL/glew.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+
+class WindowState;
+class Font;
+class TextMetrics;
+class BaseFormattedText;
+
+/**
+ * Represents a render for underlined ranges of text
+ */
+class UnderlineRender {
+private:
+	ShaderProgram mShaderProgram;
+
+	GLuint mVAO;
+	GLuint mVBO;
+	std::size_t mBufferSize = 0;
+
+	std::vector<GLfloat> mVertices;
+
+	/**
+	 * Adds the vertices of an underline
+	 * @param left The left position
+	 * @param right The right position
+	 * @param baseline The position of the baseline
+	 * @param thickness The thickness of the line
+	 * @param color The color
+	 */
+	void addUnderline(float left, float right, float baseline, float thickness, glm::vec3 color);
+public:
+	UnderlineRender();
+	~UnderlineRender();
+
+	/**
+	 * Renders an underline below the given ranges
+	 * @param windowState The window state
+	 * @param font The font
+	 * @param textMetrics The text metrics
+	 * @param formattedText The formatted text
+	 * @param offset The draw offset
+	 * @param ranges The ranges of text
+	 * @param color The color
+	 */
+	void render(const WindowState& windowState,
+				const Font& font,
+				const TextMetrics& textMetrics,
+				const BaseFormattedText& formattedText,
+				glm::vec2 offset,
+				const std::vector<Misspelling>& ranges,
+				glm::vec3 color);
+};
\ No newline at end of file
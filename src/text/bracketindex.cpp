@@ -0,0 +1,609 @@
+#include "bracketindex.h"
+
+#include <algorithm>
+
+Char Bracket::character() const {
+	switch (type) {
+		case BracketType::Round:
+			return isOpen ? '(' : ')';
+		case BracketType::Square:
+			return isOpen ? '[' : ']';
+		case BracketType::Curly:
+			return isOpen ? '{' : '}';
+	}
+
+	return '\0';
+}
+
+BracketIndex::Node BracketIndex::combine(const Node& left, const Node& right) {
+	Node node;
+	node.sum = left.sum + right.sum;
+	node.minPrefix = std::min(left.minPrefix, left.sum + right.minPrefix);
+	node.maxSuffix = std::max(right.maxSuffix, right.sum + left.maxSuffix);
+	node.numLines = left.numLines + right.numLines;
+	return node;
+}
+
+BracketIndex::Node BracketIndex::createLeaf(const std::vector<Bracket>& brackets) {
+	Node node;
+	node.numLines = 1;
+	for (auto& bracket : brackets) {
+		node.sum += bracket.isOpen ? 1 : -1;
+		node.minPrefix = std::min(node.minPrefix, node.sum);
+	}
+
+	std::int32_t suffix = 0;
+	for (auto it = brackets.rbegin(); it != brackets.rend(); ++it) {
+		suffix += it->isOpen ? 1 : -1;
+		node.maxSuffix = std::max(node.maxSuffix, suffix);
+	}
+
+	return node;
+}
+
+void BracketIndex::findBrackets(const FormattedLine& line, std::vector<Bracket>& brackets) {
+	brackets.clear();
+
+	std::size_t charIndex = 0;
+	for (auto& token : line.tokens) {
+		if (token.type != TokenType::String && token.type != TokenType::Comment) {
+			for (std::size_t i = 0; i < token.text.size(); i++) {
+				Bracket bracket;
+				bracket.charIndex = charIndex + i;
+
+				switch (token.text[i]) {
+					case '(':
+					case ')':
+						bracket.type = BracketType::Round;
+						break;
+					case '[':
+					case ']':
+						bracket.type = BracketType::Square;
+						break;
+					case '{':
+					case '}':
+						bracket.type = BracketType::Curly;
+						break;
+					default:
+						continue;
+				}
+
+				bracket.isOpen = token.text[i] == '(' || token.text[i] == '[' || token.text[i] == '{';
+				brackets.push_back(bracket);
+			}
+		}
+
+		charIndex += token.text.size();
+	}
+}
+
+const Bracket* BracketIndex::findLastUnmatchedOpen(const std::vector<Bracket>& brackets) {
+	std::int32_t depth = 0;
+	for (auto it = brackets.rbegin(); it != brackets.rend(); ++it) {
+		depth += it->isOpen ? 1 : -1;
+		if (depth == 1) {
+			return &*it;
+		}
+	}
+
+	return nullptr;
+}
+
+void BracketIndex::SummaryTree::resize(std::size_t size) {
+	mNumLeaves = 1;
+	while (mNumLeaves < size) {
+		mNumLeaves *= 2;
+	}
+
+	mNodes.assign(2 * mNumLeaves, Node());
+}
+
+void BracketIndex::SummaryTree::setLeaf(std::size_t index, const Node& node) {
+	mNodes[mNumLeaves + index] = node;
+}
+
+void BracketIndex::SummaryTree::build() {
+	for (auto i = mNumLeaves - 1; i > 0; i--) {
+		mNodes[i] = combine(mNodes[2 * i], mNodes[2 * i + 1]);
+	}
+}
+
+void BracketIndex::SummaryTree::update(std::size_t index, const Node& node) {
+	auto current = mNumLeaves + index;
+	mNodes[current] = node;
+
+	for (current /= 2; current > 0; current /= 2) {
+		mNodes[current] = combine(mNodes[2 * current], mNodes[2 * current + 1]);
+	}
+}
+
+const BracketIndex::Node& BracketIndex::SummaryTree::root() const {
+	return mNodes[1];
+}
+
+std::size_t BracketIndex::SummaryTree::numLinesBefore(std::size_t index) const {
+	std::size_t numLines = 0;
+	for (auto node = mNumLeaves + index; node > 1; node /= 2) {
+		if (node % 2 == 1) {
+			numLines += mNodes[node - 1].numLines;
+		}
+	}
+
+	return numLines;
+}
+
+std::size_t BracketIndex::SummaryTree::findLine(std::size_t& lineIndex) const {
+	std::size_t node = 1;
+	while (node < mNumLeaves) {
+		auto& left = mNodes[2 * node];
+		if (lineIndex < left.numLines) {
+			node = 2 * node;
+		} else {
+			lineIndex -= left.numLines;
+			node = 2 * node + 1;
+		}
+	}
+
+	return node - mNumLeaves;
+}
+
+std::size_t BracketIndex::SummaryTree::findForward(std::size_t node,
+												   std::size_t nodeStart,
+												   std::size_t nodeEnd,
+												   std::size_t startIndex,
+												   std::int32_t& depth,
+												   std::int32_t target) const {
+	if (nodeEnd <= startIndex) {
+		return NOT_FOUND;
+	}
+
+	auto& current = mNodes[node];
+	if (nodeStart >= startIndex && depth + current.minPrefix > target) {
+		depth += current.sum;
+		return NOT_FOUND;
+	}
+
+	if (nodeEnd - nodeStart == 1) {
+		return nodeStart;
+	}
+
+	auto middle = (nodeStart + nodeEnd) / 2;
+	auto index = findForward(2 * node, nodeStart, middle, startIndex, depth, target);
+	if (index != NOT_FOUND) {
+		return index;
+	}
+
+	return findForward(2 * node + 1, middle, nodeEnd, startIndex, depth, target);
+}
+
+std::size_t BracketIndex::SummaryTree::findBackward(std::size_t node,
+													std::size_t nodeStart,
+													std::size_t nodeEnd,
+													std::size_t endIndex,
+													std::int32_t& depth,
+													std::int32_t target) const {
+	if (nodeStart > endIndex) {
+		return NOT_FOUND;
+	}
+
+	auto& current = mNodes[node];
+	if (nodeEnd <= endIndex + 1 && depth + current.maxSuffix < target) {
+		depth += current.sum;
+		return NOT_FOUND;
+	}
+
+	if (nodeEnd - nodeStart == 1) {
+		return nodeStart;
+	}
+
+	auto middle = (nodeStart + nodeEnd) / 2;
+	auto index = findBackward(2 * node + 1, middle, nodeEnd, endIndex, depth, target);
+	if (index != NOT_FOUND) {
+		return index;
+	}
+
+	return findBackward(2 * node, nodeStart, middle, endIndex, depth, target);
+}
+
+std::size_t BracketIndex::SummaryTree::findForward(std::size_t startIndex,
+												   std::int32_t& depth,
+												   std::int32_t target) const {
+	return findForward(1, 0, mNumLeaves, startIndex, depth, target);
+}
+
+std::size_t BracketIndex::SummaryTree::findBackward(std::size_t endIndex,
+													std::int32_t& depth,
+													std::int32_t target) const {
+	return findBackward(1, 0, mNumLeaves, endIndex, depth, target);
+}
+
+void BracketIndex::buildChunk(Chunk& chunk) {
+	chunk.tree.resize(chunk.lineBrackets.size());
+	for (std::size_t i = 0; i < chunk.lineBrackets.size(); i++) {
+		chunk.tree.setLeaf(i, createLeaf(chunk.lineBrackets[i]));
+	}
+
+	chunk.tree.build();
+}
+
+void BracketIndex::buildChunkTree() {
+	mChunkTree.resize(mChunks.size());
+	for (std::size_t i = 0; i < mChunks.size(); i++) {
+		mChunkTree.setLeaf(i, mChunks[i].tree.root());
+	}
+
+	mChunkTree.build();
+}
+
+std::pair<std::size_t, std::size_t> BracketIndex::findLine(std::size_t lineIndex) const {
+	if (lineIndex >= mNumLines) {
+		return std::make_pair(mChunks.size() - 1, mChunks.back().lineBrackets.size());
+	}
+
+	auto chunkIndex = mChunkTree.findLine(lineIndex);
+	return std::make_pair(chunkIndex, lineIndex);
+}
+
+const std::vector<Bracket>& BracketIndex::lineBrackets(std::size_t lineIndex) const {
+	auto position = findLine(lineIndex);
+	return mChunks[position.first].lineBrackets[position.second];
+}
+
+void BracketIndex::insertLines(std::size_t lineIndex, std::vector<std::vector<Bracket>> lineBrackets) {
+	if (lineBrackets.empty()) {
+		return;
+	}
+
+	if (mChunks.empty()) {
+		mChunks.emplace_back();
+		buildChunk(mChunks.back());
+		buildChunkTree();
+	}
+
+	auto position = findLine(std::min(lineIndex, mNumLines));
+	auto& chunk = mChunks[position.first];
+	chunk.lineBrackets.insert(
+		chunk.lineBrackets.begin() + (std::ptrdiff_t)position.second,
+		std::make_move_iterator(lineBrackets.begin()),
+		std::make_move_iterator(lineBrackets.end()));
+	mNumLines += lineBrackets.size();
+
+	if (chunk.lineBrackets.size() <= MAX_CHUNK_SIZE) {
+		buildChunk(chunk);
+		mChunkTree.update(position.first, chunk.tree.root());
+		return;
+	}
+
+	// The chunk is split when it has become too large
+	auto lines = std::move(chunk.lineBrackets);
+	std::vector<Chunk> parts;
+	for (std::size_t start = 0; start < lines.size(); start += MAX_CHUNK_SIZE / 2) {
+		auto end = std::min(start + MAX_CHUNK_SIZE / 2, lines.size());
+		Chunk part;
+		part.lineBrackets.assign(
+			std::make_move_iterator(lines.begin() + (std::ptrdiff_t)start),
+			std::make_move_iterator(lines.begin() + (std::ptrdiff_t)end));
+		buildChunk(part);
+		parts.push_back(std::move(part));
+	}
+
+	mChunks.erase(mChunks.begin() + (std::ptrdiff_t)position.first);
+	mChunks.insert(
+		mChunks.begin() + (std::ptrdiff_t)position.first,
+		std::make_move_iterator(parts.begin()),
+		std::make_move_iterator(parts.end()));
+	buildChunkTree();
+}
+
+void BracketIndex::eraseLines(std::size_t lineIndex, std::size_t count) {
+	if (lineIndex >= mNumLines) {
+		return;
+	}
+
+	count = std::min(count, mNumLines - lineIndex);
+	auto position = findLine(lineIndex);
+	auto chunkIndex = position.first;
+	auto index = position.second;
+	bool emptiedChunk = false;
+
+	for (auto remaining = count; remaining > 0; chunkIndex++, index = 0) {
+		auto& chunk = mChunks[chunkIndex];
+		auto numErased = std::min(remaining, chunk.lineBrackets.size() - index);
+		auto begin = chunk.lineBrackets.begin() + (std::ptrdiff_t)index;
+		chunk.lineBrackets.erase(begin, begin + (std::ptrdiff_t)numErased);
+		remaining -= numErased;
+
+		if (chunk.lineBrackets.empty()) {
+			emptiedChunk = true;
+		} else {
+			buildChunk(chunk);
+		}
+	}
+
+	mNumLines -= count;
+
+	if (emptiedChunk) {
+		auto firstChunk = mChunks.begin() + (std::ptrdiff_t)position.first;
+		auto lastChunk = mChunks.begin() + (std::ptrdiff_t)chunkIndex;
+		auto isEmpty = [](const Chunk& chunk) { return chunk.lineBrackets.empty(); };
+		mChunks.erase(std::remove_if(firstChunk, lastChunk, isEmpty), lastChunk);
+	}
+
+	// Small chunks are merged to keep the number of chunks proportional to the number of lines
+	bool mergedChunk = false;
+	if (position.first + 1 < mChunks.size()
+		&& mChunks[position.first].lineBrackets.size() + mChunks[position.first + 1].lineBrackets.size() <= MAX_CHUNK_SIZE / 2) {
+		auto& chunk = mChunks[position.first];
+		auto& nextChunk = mChunks[position.first + 1];
+		chunk.lineBrackets.insert(
+			chunk.lineBrackets.end(),
+			std::make_move_iterator(nextChunk.lineBrackets.begin()),
+			std::make_move_iterator(nextChunk.lineBrackets.end()));
+		buildChunk(chunk);
+		mChunks.erase(mChunks.begin() + (std::ptrdiff_t)position.first + 1);
+		mergedChunk = true;
+	}
+
+	if (emptiedChunk || mergedChunk) {
+		buildChunkTree();
+	} else {
+		for (auto i = position.first; i < chunkIndex; i++) {
+			mChunkTree.update(i, mChunks[i].tree.root());
+		}
+	}
+}
+
+std::size_t BracketIndex::findForward(std::size_t startLineIndex, std::int32_t& depth, std::int32_t target) const {
+	if (startLineIndex >= mNumLines) {
+		return NOT_FOUND;
+	}
+
+	auto position = findLine(startLineIndex);
+	auto chunkIndex = position.first;
+	auto index = mChunks[chunkIndex].tree.findForward(position.second, depth, target);
+	if (index == NOT_FOUND) {
+		// The chunks that cannot reach the target are skipped, and the found chunk is searched from its start
+		chunkIndex = mChunkTree.findForward(chunkIndex + 1, depth, target);
+		if (chunkIndex == NOT_FOUND) {
+			return NOT_FOUND;
+		}
+
+		index = mChunks[chunkIndex].tree.findForward(0, depth, target);
+	}
+
+	return mChunkTree.numLinesBefore(chunkIndex) + index;
+}
+
+std::size_t BracketIndex::findBackward(std::size_t endLineIndex, std::int32_t& depth, std::int32_t target) const {
+	if (endLineIndex >= mNumLines) {
+		return NOT_FOUND;
+	}
+
+	auto position = findLine(endLineIndex);
+	auto chunkIndex = position.first;
+	auto index = mChunks[chunkIndex].tree.findBackward(position.second, depth, target);
+	if (index == NOT_FOUND) {
+		if (chunkIndex == 0) {
+			return NOT_FOUND;
+		}
+
+		chunkIndex = mChunkTree.findBackward(chunkIndex - 1, depth, target);
+		if (chunkIndex == NOT_FOUND) {
+			return NOT_FOUND;
+		}
+
+		index = mChunks[chunkIndex].tree.findBackward(mChunks[chunkIndex].lineBrackets.size() - 1, depth, target);
+	}
+
+	return mChunkTree.numLinesBefore(chunkIndex) + index;
+}
+
+bool BracketIndex::findClose(const BracketPosition& position, BracketPosition& close) const {
+	if (position.lineIndex >= mNumLines) {
+		return false;
+	}
+
+	std::int32_t depth = 0;
+	for (auto& bracket : lineBrackets(position.lineIndex)) {
+		if (bracket.charIndex < position.charIndex) {
+			continue;
+		}
+
+		depth += bracket.isOpen ? 1 : -1;
+		if (depth == -1) {
+			close = { position.lineIndex, bracket.charIndex };
+			return true;
+		}
+	}
+
+	// The depth changes by one at a time, which means that the found line reaches the target exactly
+	auto target = -1 - depth;
+	depth = 0;
+	auto lineIndex = findForward(position.lineIndex + 1, depth, target);
+	if (lineIndex == NOT_FOUND) {
+		return false;
+	}
+
+	for (auto& bracket : lineBrackets(lineIndex)) {
+		depth += bracket.isOpen ? 1 : -1;
+		if (depth == target) {
+			close = { lineIndex, bracket.charIndex };
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool BracketIndex::findOpen(const BracketPosition& position, BracketPosition& open) const {
+	if (position.lineIndex >= mNumLines) {
+		return false;
+	}
+
+	std::int32_t depth = 0;
+	auto& brackets = lineBrackets(position.lineIndex);
+	for (auto it = brackets.rbegin(); it != brackets.rend(); ++it) {
+		if (it->charIndex >= position.charIndex) {
+			continue;
+		}
+
+		depth += it->isOpen ? 1 : -1;
+		if (depth == 1) {
+			open = { position.lineIndex, it->charIndex };
+			return true;
+		}
+	}
+
+	if (position.lineIndex == 0) {
+		return false;
+	}
+
+	auto target = 1 - depth;
+	depth = 0;
+	auto lineIndex = findBackward(position.lineIndex - 1, depth, target);
+	if (lineIndex == NOT_FOUND) {
+		return false;
+	}
+
+	auto& foundBrackets = lineBrackets(lineIndex);
+	for (auto it = foundBrackets.rbegin(); it != foundBrackets.rend(); ++it) {
+		depth += it->isOpen ? 1 : -1;
+		if (depth == target) {
+			open = { lineIndex, it->charIndex };
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void BracketIndex::assign(const BaseFormattedText& text) {
+	// The lines are read without keeping the formatting of lines that are formatted when accessed
+	ReadLinesBuffer readLines;
+	std::vector<std::vector<Bracket>> lineBrackets(text.numLines());
+	for (std::size_t i = 0; i < text.numLines(); i++) {
+		findBrackets(text.readLine(i, readLines), lineBrackets[i]);
+	}
+
+	clear();
+	insertLines(0, std::move(lineBrackets));
+}
+
+void BracketIndex::clear() {
+	mChunks.clear();
+	mNumLines = 0;
+	buildChunkTree();
+}
+
+void BracketIndex::replaceLines(const BaseFormattedText& text,
+								std::size_t lineIndex,
+								std::size_t numOldLines,
+								std::size_t numNewLines) {
+	if (lineIndex + numOldLines > mNumLines
+		|| mNumLines - numOldLines + numNewLines != text.numLines()) {
+		// The index does not match the text before the change, so it is indexed from scratch
+		assign(text);
+		return;
+	}
+
+	ReadLinesBuffer readLines;
+	if (numOldLines == numNewLines) {
+		for (auto i = lineIndex; i < lineIndex + numNewLines; i++) {
+			auto position = findLine(i);
+			auto& chunk = mChunks[position.first];
+			auto& brackets = chunk.lineBrackets[position.second];
+			findBrackets(text.readLine(i, readLines), brackets);
+			chunk.tree.update(position.second, createLeaf(brackets));
+			mChunkTree.update(position.first, chunk.tree.root());
+		}
+
+		return;
+	}
+
+	std::vector<std::vector<Bracket>> lineBrackets(numNewLines);
+	for (std::size_t i = 0; i < numNewLines; i++) {
+		findBrackets(text.readLine(lineIndex + i, readLines), lineBrackets[i]);
+	}
+
+	eraseLines(lineIndex, numOldLines);
+	insertLines(lineIndex, std::move(lineBrackets));
+}
+
+std::size_t BracketIndex::numLines() const {
+	return mNumLines;
+}
+
+const Bracket* BracketIndex::findBracket(const BracketPosition& position) const {
+	if (position.lineIndex >= mNumLines) {
+		return nullptr;
+	}
+
+	auto& brackets = lineBrackets(position.lineIndex);
+	auto bracket = std::lower_bound(
+		brackets.begin(),
+		brackets.end(),
+		position.charIndex,
+		[](const Bracket& current, std::size_t charIndex) { return current.charIndex < charIndex; });
+
+	if (bracket == brackets.end() || bracket->charIndex != position.charIndex) {
+		return nullptr;
+	}
+
+	return &*bracket;
+}
+
+bool BracketIndex::findMatchingBracket(const BracketPosition& position, BracketPosition& match) const {
+	auto bracket = findBracket(position);
+	if (bracket == nullptr) {
+		return false;
+	}
+
+	bool found;
+	if (bracket->isOpen) {
+		found = findClose({ position.lineIndex, position.charIndex + 1 }, match);
+	} else {
+		found = findOpen(position, match);
+	}
+
+	return found && findBracket(match)->type == bracket->type;
+}
+
+bool BracketIndex::findEnclosingBlock(const BracketPosition& position,
+									  BracketPosition& open,
+									  BracketPosition& close) const {
+	if (!findOpen(position, open) || !findClose(position, close)) {
+		return false;
+	}
+
+	return findBracket(open)->type == findBracket(close)->type;
+}
+
+bool BracketIndex::findBlockAtLine(std::size_t lineIndex, BracketPosition& open, BracketPosition& close) const {
+	if (lineIndex >= mNumLines) {
+		return false;
+	}
+
+	auto bracket = findLastUnmatchedOpen(lineBrackets(lineIndex));
+	if (bracket == nullptr) {
+		return false;
+	}
+
+	open = { lineIndex, bracket->charIndex };
+	return findMatchingBracket(open, close) && close.lineIndex > lineIndex;
+}
+
+bool BracketIndex::findPairAtCaret(const BracketPosition& caret,
+								   BracketPosition& first,
+								   BracketPosition& second) const {
+	first = caret;
+	if (findMatchingBracket(first, second)) {
+		return true;
+	}
+
+	if (caret.charIndex > 0) {
+		first = { caret.lineIndex, caret.charIndex - 1 };
+		return findMatchingBracket(first, second);
+	}
+
+	return false;
+}
@@ -0,0 +1,338 @@
+#pragma once
+#include "formattedtext.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * The type of a bracket
+ */
+enum class BracketType : std::uint8_t {
+	Round,
+	Square,
+	Curly
+};
+
+/**
+ * Represents a bracket on a line
+ */
+struct Bracket {
+	std::size_t charIndex = 0;
+	BracketType type = BracketType::Round;
+	bool isOpen = false;
+
+	/**
+	 * Returns the character of the bracket
+	 */
+	Char character() const;
+};
+
+/**
+ * Represents the position of a bracket in the text
+ */
+struct BracketPosition {
+	std::size_t lineIndex = 0;
+	std::size_t charIndex = 0;
+};
+
+/**
+ * Indexes the brackets of a formatted text, which allows finding matching brackets and enclosing blocks.
+ * Brackets inside strings and comments are ignored, as given by the token types of the formatted lines.
+ *
+ * The brackets are kept per line, where each line is summarized by its depth change (open is +1 and close is -1), its
+ * lowest prefix depth and its highest suffix depth. The lines are stored in chunks of bounded size, where a segment
+ * tree over the lines of each chunk combines their summaries, and a segment tree over the chunks combines the
+ * summaries and the number of lines of each chunk. A search skips every range of lines that cannot contain the match,
+ * and an edit only rebuilds the tree of the changed chunks. Queries and edits are logarithmic in the number of lines,
+ * plus the size of a chunk and the changed lines.
+ */
+class BracketIndex {
+private:
+	static constexpr std::size_t MAX_CHUNK_SIZE = 512;
+	static constexpr std::size_t NOT_FOUND = (std::size_t)-1;
+
+	/**
+	 * The summary of a range of lines
+	 */
+	struct Node {
+		std::int32_t sum = 0;
+		std::int32_t minPrefix = 0;
+		std::int32_t maxSuffix = 0;
+		std::size_t numLines = 0;
+	};
+
+	/**
+	 * A segment tree that combines the summaries of consecutive ranges
+	 */
+	class SummaryTree {
+	private:
+		std::vector<Node> mNodes;
+		std::size_t mNumLeaves = 0;
+
+		/**
+		 * Finds the first range at or after the given range within the given node where the depth reaches the target
+		 * @param node The current node
+		 * @param nodeStart The first range of the node
+		 * @param nodeEnd The range after the last range of the node
+		 * @param startIndex The range to search from
+		 * @param depth The depth before the node, updated with the ranges that were skipped
+		 * @param target The target depth
+		 */
+		std::size_t findForward(std::size_t node,
+								std::size_t nodeStart,
+								std::size_t nodeEnd,
+								std::size_t startIndex,
+								std::int32_t& depth,
+								std::int32_t target) const;
+
+		/**
+		 * Finds the last range at or before the given range within the given node where the depth, counted backwards,
+		 * reaches the target
+		 * @param node The current node
+		 * @param nodeStart The first range of the node
+		 * @param nodeEnd The range after the last range of the node
+		 * @param endIndex The range to search from
+		 * @param depth The depth after the node, updated with the ranges that were skipped
+		 * @param target The target depth
+		 */
+		std::size_t findBackward(std::size_t node,
+								 std::size_t nodeStart,
+								 std::size_t nodeEnd,
+								 std::size_t endIndex,
+								 std::int32_t& depth,
+								 std::int32_t target) const;
+	public:
+		/**
+		 * Resizes the tree to the given number of ranges, which are all empty
+		 * @param size The number of ranges
+		 */
+		void resize(std::size_t size);
+
+		/**
+		 * Sets the summary of the given range without updating the ranges that contain it
+		 * @param index The index of the range
+		 * @param node The summary
+		 */
+		void setLeaf(std::size_t index, const Node& node);
+
+		/**
+		 * Combines the summaries of all ranges after they have been set
+		 */
+		void build();
+
+		/**
+		 * Updates the summary of the given range
+		 * @param index The index of the range
+		 * @param node The summary
+		 */
+		void update(std::size_t index, const Node& node);
+
+		/**
+		 * Returns the summary of all ranges
+		 */
+		const Node& root() const;
+
+		/**
+		 * Returns the number of lines of the ranges before the given range
+		 * @param index The index of the range
+		 */
+		std::size_t numLinesBefore(std::size_t index) const;
+
+		/**
+		 * Finds the range that contains the given line
+		 * @param lineIndex The index of the line, which is changed to the index within the found range
+		 */
+		std::size_t findLine(std::size_t& lineIndex) const;
+
+		/**
+		 * Finds the first range at or after the given range where the depth reaches the target
+		 * @param startIndex The range to search from
+		 * @param depth The depth before the range, updated with the ranges that were skipped
+		 * @param target The target depth
+		 */
+		std::size_t findForward(std::size_t startIndex, std::int32_t& depth, std::int32_t target) const;
+
+		/**
+		 * Finds the last range at or before the given range where the depth, counted backwards, reaches the target
+		 * @param endIndex The range to search from
+		 * @param depth The depth after the range, updated with the ranges that were skipped
+		 * @param target The target depth
+		 */
+		std::size_t findBackward(std::size_t endIndex, std::int32_t& depth, std::int32_t target) const;
+	};
+
+	/**
+	 * A chunk of lines
+	 */
+	struct Chunk {
+		std::vector<std::vector<Bracket>> lineBrackets;
+		SummaryTree tree;
+	};
+
+	std::vector<Chunk> mChunks;
+	SummaryTree mChunkTree;
+	std::size_t mNumLines = 0;
+
+	/**
+	 * Combines the summaries of two adjacent ranges
+	 * @param left The first range
+	 * @param right The range after it
+	 */
+	static Node combine(const Node& left, const Node& right);
+
+	/**
+	 * Creates the summary of a line
+	 * @param brackets The brackets on the line
+	 */
+	static Node createLeaf(const std::vector<Bracket>& brackets);
+
+	/**
+	 * Builds the tree of the given chunk from the brackets of its lines
+	 * @param chunk The chunk
+	 */
+	static void buildChunk(Chunk& chunk);
+
+	/**
+	 * Builds the tree over the chunks from the summaries of the chunks
+	 */
+	void buildChunkTree();
+
+	/**
+	 * Finds the chunk that contains the given line. The number of lines maps to the end of the last chunk.
+	 * @param lineIndex The index of the line
+	 * @return The index of the chunk and the index within the chunk
+	 */
+	std::pair<std::size_t, std::size_t> findLine(std::size_t lineIndex) const;
+
+	/**
+	 * Returns the brackets of the given line
+	 * @param lineIndex The index of the line
+	 */
+	const std::vector<Bracket>& lineBrackets(std::size_t lineIndex) const;
+
+	/**
+	 * Inserts lines before the given line
+	 * @param lineIndex The index to insert at
+	 * @param lineBrackets The brackets of each inserted line
+	 */
+	void insertLines(std::size_t lineIndex, std::vector<std::vector<Bracket>> lineBrackets);
+
+	/**
+	 * Erases the given lines
+	 * @param lineIndex The index of the first line
+	 * @param count The number of lines
+	 */
+	void eraseLines(std::size_t lineIndex, std::size_t count);
+
+	/**
+	 * Finds the first line at or after the given line where the depth reaches the target
+	 * @param startLineIndex The line to search from
+	 * @param depth The depth before the line, updated with the lines that were skipped
+	 * @param target The target depth
+	 */
+	std::size_t findForward(std::size_t startLineIndex, std::int32_t& depth, std::int32_t target) const;
+
+	/**
+	 * Finds the last line at or before the given line where the depth, counted backwards, reaches the target
+	 * @param endLineIndex The line to search from
+	 * @param depth The depth after the line, updated with the lines that were skipped
+	 * @param target The target depth
+	 */
+	std::size_t findBackward(std::size_t endLineIndex, std::int32_t& depth, std::int32_t target) const;
+
+	/**
+	 * Finds the first unmatched close bracket at or after the given position
+	 * @param position The position
+	 * @param close The close bracket
+	 */
+	bool findClose(const BracketPosition& position, BracketPosition& close) const;
+
+	/**
+	 * Finds the last unmatched open bracket before the given position
+	 * @param position The position
+	 * @param open The open bracket
+	 */
+	bool findOpen(const BracketPosition& position, BracketPosition& open) const;
+public:
+	/**
+	 * Finds the brackets of the given line, ignoring strings and comments
+	 * @param line The line
+	 * @param brackets The brackets
+	 */
+	static void findBrackets(const FormattedLine& line, std::vector<Bracket>& brackets);
+
+	/**
+	 * Returns the last open bracket that is not closed within the given brackets, or null if there is none
+	 * @param brackets The brackets
+	 */
+	static const Bracket* findLastUnmatchedOpen(const std::vector<Bracket>& brackets);
+
+	/**
+	 * Indexes all lines of the given text
+	 * @param text The formatted text
+	 */
+	void assign(const BaseFormattedText& text);
+
+	/**
+	 * Removes all lines
+	 */
+	void clear();
+
+	/**
+	 * Replaces the given lines with the lines of the text. Only the chunks that contain the changed lines are rebuilt,
+	 * and the tree over the chunks is rebuilt when chunks are split or merged.
+	 * @param text The formatted text
+	 * @param lineIndex The index of the first changed line
+	 * @param numOldLines The number of lines before the change
+	 * @param numNewLines The number of lines after the change
+	 */
+	void replaceLines(const BaseFormattedText& text,
+					  std::size_t lineIndex,
+					  std::size_t numOldLines,
+					  std::size_t numNewLines);
+
+	/**
+	 * Returns the number of indexed lines
+	 */
+	std::size_t numLines() const;
+
+	/**
+	 * Returns the bracket at the given position, or null if there is none
+	 * @param position The position
+	 */
+	const Bracket* findBracket(const BracketPosition& position) const;
+
+	/**
+	 * Finds the bracket that matches the bracket at the given position
+	 * @param position The position of the bracket
+	 * @param match The matching bracket
+	 * @return True if the position has a bracket with a match of the same type
+	 */
+	bool findMatchingBracket(const BracketPosition& position, BracketPosition& match) const;
+
+	/**
+	 * Finds the innermost pair of brackets that encloses the given position
+	 * @param position The position
+	 * @param open The open bracket
+	 * @param close The close bracket
+	 * @return True if there is a block of matching type
+	 */
+	bool findEnclosingBlock(const BracketPosition& position, BracketPosition& open, BracketPosition& close) const;
+
+	/**
+	 * Finds the innermost block that is opened on the given line and closed on a later line
+	 * @param lineIndex The index of the line
+	 * @param open The open bracket
+	 * @param close The close bracket
+	 */
+	bool findBlockAtLine(std::size_t lineIndex, BracketPosition& open, BracketPosition& close) const;
+
+	/**
+	 * Finds the pair of brackets at the caret, where the bracket can be either after or before the caret
+	 * @param caret The position of the caret
+	 * @param first The bracket at the caret
+	 * @param second The matching bracket
+	 */
+	bool findPairAtCaret(const BracketPosition& caret, BracketPosition& first, BracketPosition& second) const;
+};
\ No newline at end of file
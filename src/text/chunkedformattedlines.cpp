@@ -0,0 +1,292 @@
+#include "chunkedformattedlines.h"
+
+#include <algorithm>
+#include <iterator>
+
+FormattedLineState::FormattedLineState(const FormattedLine& formattedLine)
+	: width(formattedLine.width),
+	  reformatAmount((std::int32_t)formattedLine.reformatAmount),
+	  reformatStartSearch((std::int32_t)formattedLine.reformatStartSearch),
+	  mayRequireSearch(formattedLine.mayRequireSearch),
+	  endsInBlockComment(formattedLine.endsInBlockComment) {
+
+}
+
+void FormattedLineState::applyReformatInformation(FormattedLine& formattedLine) const {
+	formattedLine.reformatAmount = reformatAmount;
+	formattedLine.reformatStartSearch = reformatStartSearch;
+	formattedLine.mayRequireSearch = mayRequireSearch;
+	formattedLine.endsInBlockComment = endsInBlockComment;
+}
+
+std::size_t ChunkedFormattedLines::Chunk::size() const {
+	return isEvicted ? lineStates.size() : lines.size();
+}
+
+void ChunkedFormattedLines::invalidateFrom(std::size_t chunkIndex) {
+	mFirstInvalidChunk = std::min(mFirstInvalidChunk, chunkIndex);
+}
+
+void ChunkedFormattedLines::updateChunkStarts() const {
+	if (mFirstInvalidChunk >= mChunks.size() && mChunkStarts.size() == mChunks.size()) {
+		return;
+	}
+
+	mChunkStarts.resize(mChunks.size());
+	auto start = mFirstInvalidChunk > 0 ? mChunkStarts[mFirstInvalidChunk - 1] + mChunks[mFirstInvalidChunk - 1].size() : 0;
+	for (std::size_t i = mFirstInvalidChunk; i < mChunks.size(); i++) {
+		mChunkStarts[i] = start;
+		start += mChunks[i].size();
+	}
+
+	mFirstInvalidChunk = mChunks.size();
+}
+
+std::pair<std::size_t, std::size_t> ChunkedFormattedLines::findChunk(std::size_t index) const {
+	updateChunkStarts();
+	auto chunkIterator = std::upper_bound(mChunkStarts.begin(), mChunkStarts.end(), index);
+	auto chunkIndex = (std::size_t)std::distance(mChunkStarts.begin(), chunkIterator) - 1;
+	return std::make_pair(chunkIndex, index - mChunkStarts[chunkIndex]);
+}
+
+namespace {
+	template<typename T>
+	std::vector<std::vector<T>> splitIntoParts(std::vector<T>& elements, std::size_t partSize) {
+		std::vector<std::vector<T>> parts;
+		for (std::size_t start = 0; start < elements.size(); start += partSize) {
+			auto end = std::min(start + partSize, elements.size());
+			parts.emplace_back(
+				std::make_move_iterator(elements.begin() + start),
+				std::make_move_iterator(elements.begin() + end));
+		}
+
+		return parts;
+	}
+}
+
+void ChunkedFormattedLines::splitChunk(std::size_t chunkIndex) {
+	if (mChunks[chunkIndex].size() <= MAX_CHUNK_SIZE) {
+		return;
+	}
+
+	auto chunk = std::move(mChunks[chunkIndex]);
+	std::vector<Chunk> newChunks;
+	if (chunk.isEvicted) {
+		for (auto& lineStates : splitIntoParts(chunk.lineStates, MAX_CHUNK_SIZE / 2)) {
+			newChunks.emplace_back();
+			newChunks.back().isEvicted = true;
+			newChunks.back().lineStates = std::move(lineStates);
+		}
+	} else {
+		for (auto& lines : splitIntoParts(chunk.lines, MAX_CHUNK_SIZE / 2)) {
+			newChunks.emplace_back();
+			newChunks.back().lines = std::move(lines);
+		}
+	}
+
+	mChunks.erase(mChunks.begin() + chunkIndex);
+	mChunks.insert(
+		mChunks.begin() + chunkIndex,
+		std::make_move_iterator(newChunks.begin()),
+		std::make_move_iterator(newChunks.end()));
+}
+
+void ChunkedFormattedLines::assign(std::vector<FormattedLine> lines) {
+	mChunks.clear();
+	mSize = lines.size();
+	mChunks.emplace_back();
+	mChunks.back().lines = std::move(lines);
+	splitChunk(0);
+
+	mChunkStarts.clear();
+	mFirstInvalidChunk = 0;
+}
+
+std::size_t ChunkedFormattedLines::size() const {
+	return mSize;
+}
+
+FormattedLine& ChunkedFormattedLines::operator[](std::size_t index) {
+	auto location = findChunk(index);
+	return mChunks[location.first].lines.at(location.second);
+}
+
+const FormattedLine& ChunkedFormattedLines::operator[](std::size_t index) const {
+	auto location = findChunk(index);
+	return mChunks[location.first].lines.at(location.second);
+}
+
+void ChunkedFormattedLines::set(std::size_t index, FormattedLine line) {
+	auto location = findChunk(index);
+	auto& chunk = mChunks[location.first];
+	if (chunk.isEvicted) {
+		chunk.lineStates[location.second] = FormattedLineState(line);
+	} else {
+		chunk.lines[location.second] = std::move(line);
+	}
+}
+
+FormattedLine ChunkedFormattedLines::exchange(std::size_t index, FormattedLine line) {
+	auto location = findChunk(index);
+	auto& chunk = mChunks[location.first];
+	if (chunk.isEvicted) {
+		chunk.lineStates[location.second] = FormattedLineState(line);
+		return {};
+	}
+
+	auto previousLine = std::move(chunk.lines[location.second]);
+	chunk.lines[location.second] = std::move(line);
+	return previousLine;
+}
+
+FormattedLineState ChunkedFormattedLines::getState(std::size_t index) const {
+	auto location = findChunk(index);
+	auto& chunk = mChunks[location.first];
+	if (chunk.isEvicted) {
+		return chunk.lineStates[location.second];
+	} else {
+		return FormattedLineState(chunk.lines[location.second]);
+	}
+}
+
+void ChunkedFormattedLines::updateReformatInformation(std::size_t index, const FormattedLine& line) {
+	auto location = findChunk(index);
+	auto& chunk = mChunks[location.first];
+	FormattedLineState lineState(line);
+	if (chunk.isEvicted) {
+		lineState.width = chunk.lineStates[location.second].width;
+		chunk.lineStates[location.second] = lineState;
+	} else {
+		lineState.applyReformatInformation(chunk.lines[location.second]);
+	}
+}
+
+void ChunkedFormattedLines::insert(std::size_t index, std::vector<FormattedLine> lines) {
+	if (lines.empty()) {
+		return;
+	}
+
+	// Inserting at the end appends to the last chunk
+	std::pair<std::size_t, std::size_t> location;
+	if (mChunks.empty()) {
+		mChunks.emplace_back();
+		location = std::make_pair(0, 0);
+	} else if (index == mSize) {
+		location = std::make_pair(mChunks.size() - 1, mChunks.back().size());
+	} else {
+		location = findChunk(index);
+	}
+
+	auto& chunk = mChunks[location.first];
+	mSize += lines.size();
+	if (chunk.isEvicted) {
+		std::vector<FormattedLineState> lineStates;
+		lineStates.reserve(lines.size());
+		for (auto& line : lines) {
+			lineStates.emplace_back(line);
+		}
+
+		chunk.lineStates.insert(chunk.lineStates.begin() + location.second, lineStates.begin(), lineStates.end());
+	} else {
+		chunk.lines.insert(
+			chunk.lines.begin() + location.second,
+			std::make_move_iterator(lines.begin()),
+			std::make_move_iterator(lines.end()));
+	}
+
+	splitChunk(location.first);
+	invalidateFrom(location.first);
+}
+
+void ChunkedFormattedLines::erase(std::size_t index, std::size_t count) {
+	if (count == 0) {
+		return;
+	}
+
+	auto location = findChunk(index);
+	auto chunkIndex = location.first;
+	auto offset = location.second;
+
+	while (count > 0 && chunkIndex < mChunks.size()) {
+		auto& chunk = mChunks[chunkIndex];
+		auto numErase = std::min(count, chunk.size() - offset);
+		if (chunk.isEvicted) {
+			chunk.lineStates.erase(chunk.lineStates.begin() + offset, chunk.lineStates.begin() + offset + numErase);
+		} else {
+			chunk.lines.erase(chunk.lines.begin() + offset, chunk.lines.begin() + offset + numErase);
+		}
+
+		count -= numErase;
+		mSize -= numErase;
+
+		if (chunk.size() == 0) {
+			mChunks.erase(mChunks.begin() + chunkIndex);
+		} else {
+			chunkIndex++;
+		}
+
+		offset = 0;
+	}
+
+	invalidateFrom(location.first);
+}
+
+bool ChunkedFormattedLines::isEvicted(std::size_t index) const {
+	return mChunks[findChunk(index).first].isEvicted;
+}
+
+std::pair<std::size_t, std::size_t> ChunkedFormattedLines::chunkRange(std::size_t index) const {
+	auto location = findChunk(index);
+	return std::make_pair(index - location.second, mChunks[location.first].size());
+}
+
+void ChunkedFormattedLines::restore(std::size_t index, std::vector<FormattedLine> lines) {
+	auto& chunk = mChunks[findChunk(index).first];
+	if (!chunk.isEvicted) {
+		return;
+	}
+
+	for (std::size_t i = 0; i < lines.size() && i < chunk.lineStates.size(); i++) {
+		chunk.lineStates[i].applyReformatInformation(lines[i]);
+	}
+
+	lines.resize(chunk.lineStates.size());
+	chunk.lines = std::move(lines);
+	chunk.lineStates = {};
+	chunk.isEvicted = false;
+}
+
+std::size_t ChunkedFormattedLines::evictOutside(const std::vector<std::pair<std::size_t, std::size_t>>& ranges) {
+	updateChunkStarts();
+
+	std::size_t numEvictedLines = 0;
+	for (std::size_t chunkIndex = 0; chunkIndex < mChunks.size(); chunkIndex++) {
+		auto& chunk = mChunks[chunkIndex];
+		if (chunk.isEvicted) {
+			continue;
+		}
+
+		auto chunkStart = mChunkStarts[chunkIndex];
+		auto chunkEnd = chunkStart + chunk.size();
+		bool keep = false;
+		for (auto& range : ranges) {
+			if (range.first < chunkEnd && range.second >= chunkStart) {
+				keep = true;
+				break;
+			}
+		}
+
+		if (!keep) {
+			chunk.lineStates.reserve(chunk.lines.size());
+			for (auto& line : chunk.lines) {
+				chunk.lineStates.emplace_back(line);
+			}
+
+			chunk.lines = {};
+			chunk.isEvicted = true;
+			numEvictedLines += chunk.lineStates.size();
+		}
+	}
+
+	return numEvictedLines;
+}
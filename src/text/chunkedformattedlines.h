@@ -0,0 +1,175 @@
+#pragma once
+#include "formattedtext.h"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+/**
+ * The state kept for a line whose tokens have been evicted
+ */
+struct FormattedLineState {
+	float width = 0.0f;
+	std::int32_t reformatAmount = 0;
+	std::int32_t reformatStartSearch = 0;
+	bool mayRequireSearch = false;
+	bool endsInBlockComment = false;
+
+	FormattedLineState() = default;
+
+	/**
+	 * Creates the state of the given line
+	 * @param formattedLine The formatted line
+	 */
+	explicit FormattedLineState(const FormattedLine& formattedLine);
+
+	/**
+	 * Copies the information about multi-line constructs to the given line
+	 * @param formattedLine The formatted line
+	 */
+	void applyReformatInformation(FormattedLine& formattedLine) const;
+};
+
+/**
+ * Stores formatted lines in chunks of bounded size. Inserting or erasing lines only moves the lines within a chunk,
+ * and the position of a line is implicit from the chunk sizes, which means that no per-line state needs to be updated
+ * after a structural edit.
+ *
+ * A chunk can be evicted, in which case only the state of each line is kept. Lines assigned to an evicted chunk are
+ * reduced to their state.
+ */
+class ChunkedFormattedLines {
+private:
+	static constexpr std::size_t MAX_CHUNK_SIZE = 512;
+
+	/**
+	 * A chunk of lines
+	 */
+	struct Chunk {
+		bool isEvicted = false;
+		std::vector<FormattedLine> lines;
+		std::vector<FormattedLineState> lineStates;
+
+		/**
+		 * Returns the number of lines in the chunk
+		 */
+		std::size_t size() const;
+	};
+
+	std::vector<Chunk> mChunks;
+	std::size_t mSize = 0;
+
+	mutable std::vector<std::size_t> mChunkStarts;
+	mutable std::size_t mFirstInvalidChunk = 0;
+
+	/**
+	 * Marks that the start of the given chunk and the chunks after it needs to be recomputed
+	 * @param chunkIndex The index of the chunk
+	 */
+	void invalidateFrom(std::size_t chunkIndex);
+
+	/**
+	 * Recomputes the start of the invalid chunks
+	 */
+	void updateChunkStarts() const;
+
+	/**
+	 * Finds the chunk that contains the given line
+	 * @param index The index of the line
+	 * @return The index of the chunk and the index within the chunk
+	 */
+	std::pair<std::size_t, std::size_t> findChunk(std::size_t index) const;
+
+	/**
+	 * Splits the given chunk if it has become too large
+	 * @param chunkIndex The index of the chunk
+	 */
+	void splitChunk(std::size_t chunkIndex);
+public:
+	/**
+	 * Replaces all lines with the given lines
+	 * @param lines The lines
+	 */
+	void assign(std::vector<FormattedLine> lines);
+
+	/**
+	 * Returns the number of lines
+	 */
+	std::size_t size() const;
+
+	/**
+	 * Returns the given line, which must not be evicted
+	 * @param index The index of the line
+	 */
+	FormattedLine& operator[](std::size_t index);
+	const FormattedLine& operator[](std::size_t index) const;
+
+	/**
+	 * Sets the given line
+	 * @param index The index of the line
+	 * @param line The line
+	 */
+	void set(std::size_t index, FormattedLine line);
+
+	/**
+	 * Sets the given line and returns the previous line, which lets the caller reuse its memory
+	 * @param index The index of the line
+	 * @param line The line
+	 * @return The previous line, or an empty line if evicted
+	 */
+	FormattedLine exchange(std::size_t index, FormattedLine line);
+
+	/**
+	 * Returns the state of the given line
+	 * @param index The index of the line
+	 */
+	FormattedLineState getState(std::size_t index) const;
+
+	/**
+	 * Updates the information about multi-line constructs of the given line
+	 * @param index The index of the line
+	 * @param line The line to take the information from
+	 */
+	void updateReformatInformation(std::size_t index, const FormattedLine& line);
+
+	/**
+	 * Inserts the given lines before the given line
+	 * @param index The index to insert at
+	 * @param lines The lines
+	 */
+	void insert(std::size_t index, std::vector<FormattedLine> lines);
+
+	/**
+	 * Erases the given lines
+	 * @param index The index of the first line
+	 * @param count The number of lines
+	 */
+	void erase(std::size_t index, std::size_t count);
+
+	/**
+	 * Indicates if the chunk of the given line is evicted
+	 * @param index The index of the line
+	 */
+	bool isEvicted(std::size_t index) const;
+
+	/**
+	 * Returns the lines in the chunk of the given line
+	 * @param index The index of the line
+	 * @return The index of the first line and the number of lines
+	 */
+	std::pair<std::size_t, std::size_t> chunkRange(std::size_t index) const;
+
+	/**
+	 * Restores the evicted chunk of the given line
+	 * @param index The index of the line
+	 * @param lines The formatted lines of the chunk. Only the tokens and width are used.
+	 */
+	void restore(std::size_t index, std::vector<FormattedLine> lines);
+
+	/**
+	 * Evicts the chunks that do not contain any line in the given ranges
+	 * @param ranges The ranges of lines (first and last line) to keep
+	 * @return The number of evicted lines
+	 */
+	std::size_t evictOutside(const std::vector<std::pair<std::size_t, std::size_t>>& ranges);
+};
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "foldedformattedtext.h"
+
+FoldedFormattedText::FoldedFormattedText(const FoldIndex& folds)
+	: mFolds(folds) {
+
+}
+
+void FoldedFormattedText::setText(const BaseFormattedText& text) {
+	mText = &text;
+}
+
+std::size_t FoldedFormattedText::numLines() const {
+	return mText->numLines() - mFolds.numHiddenLines();
+}
+
+const FormattedLine& FoldedFormattedText::getLine(std::size_t index) const {
+	return mText->getLine(mFolds.getTextLineIndex(index));
+}
+
+float FoldedFormattedText::getLineWidth(std::size_t index) const {
+	return mText->getLineWidth(mFolds.getTextLineIndex(index));
+}
+
+std::size_t FoldedFormattedText::getVisualLineIndex(std::size_t lineIndex, std::size_t charIndex) const {
+	return mFolds.getVisualLineIndex(lineIndex);
+}
+
+std::size_t FoldedFormattedText::getTextLineIndex(std::size_t visualLineIndex) const {
+	return mFolds.getTextLineIndex(visualLineIndex);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "formattedtext.h"
+#include "foldindex.h"
+
+/**
+ * Represents formatted text where folded lines are hidden. The lines are mapped through the folds when accessed,
+ * which means that only the shown lines are touched.
+ */
+class FoldedFormattedText : public BaseFormattedText {
+private:
+	const FoldIndex& mFolds;
+	const BaseFormattedText* mText = nullptr;
+public:
+	/**
+	 * Creates a new folded formatted text
+	 * @param folds The folds
+	 */
+	explicit FoldedFormattedText(const FoldIndex& folds);
+
+	/**
+	 * Sets the formatted text to show
+	 * @param text The formatted text
+	 */
+	void setText(const BaseFormattedText& text);
+
+	/**
+	 * Returns the number of lines
+	 */
+	virtual std::size_t numLines() const override;
+
+	/**
+	 * Returns the formatting for the given line
+	 * @param index The index
+	 */
+	virtual const FormattedLine& getLine(std::size_t index) const override;
+
+	/**
+	 * Returns the width of the given line
+	 * @param index The index
+	 */
+	virtual float getLineWidth(std::size_t index) const override;
+
+	/**
+	 * Returns the index of the visual line that the given position in the text is shown at
+	 * @param lineIndex The index of the text line
+	 * @param charIndex The index of the character in the text line
+	 */
+	virtual std::size_t getVisualLineIndex(std::size_t lineIndex, std::size_t charIndex) const override;
+
+	/**
+	 * Returns the index of the text line that the given visual line shows
+	 * @param visualLineIndex The index of the visual line
+	 */
+	virtual std::size_t getTextLineIndex(std::size_t visualLineIndex) const override;
+};
\ No newline at end of file
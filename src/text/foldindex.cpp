@@ -0,0 +1,154 @@
+#include "foldindex.h"
+
+#include <algorithm>
+#include <cstdint>
+
+std::size_t Fold::numHiddenLines() const {
+	return lastLineIndex - headerLineIndex;
+}
+
+void FoldIndex::update() {
+	mNumHiddenBefore.assign(mFolds.size() + 1, 0);
+	mVisualHeaderLineIndices.resize(mFolds.size());
+
+	for (std::size_t i = 0; i < mFolds.size(); i++) {
+		mVisualHeaderLineIndices[i] = mFolds[i].headerLineIndex - mNumHiddenBefore[i];
+		mNumHiddenBefore[i + 1] = mNumHiddenBefore[i] + mFolds[i].numHiddenLines();
+	}
+}
+
+std::size_t FoldIndex::numFoldsBefore(std::size_t lineIndex) const {
+	auto fold = std::lower_bound(
+		mFolds.begin(),
+		mFolds.end(),
+		lineIndex,
+		[](const Fold& current, std::size_t lineIndex) { return current.headerLineIndex < lineIndex; });
+	return (std::size_t)(fold - mFolds.begin());
+}
+
+bool FoldIndex::empty() const {
+	return mFolds.empty();
+}
+
+const std::vector<Fold>& FoldIndex::folds() const {
+	return mFolds;
+}
+
+std::size_t FoldIndex::numHiddenLines() const {
+	return mNumHiddenBefore.empty() ? 0 : mNumHiddenBefore.back();
+}
+
+const Fold* FoldIndex::findFold(std::size_t headerLineIndex) const {
+	auto index = numFoldsBefore(headerLineIndex);
+	if (index < mFolds.size() && mFolds[index].headerLineIndex == headerLineIndex) {
+		return &mFolds[index];
+	}
+
+	return nullptr;
+}
+
+void FoldIndex::fold(std::size_t headerLineIndex, std::size_t lastLineIndex) {
+	if (lastLineIndex <= headerLineIndex || isHidden(headerLineIndex)) {
+		return;
+	}
+
+	auto isInside = [&](const Fold& fold) {
+		return fold.headerLineIndex >= headerLineIndex && fold.headerLineIndex <= lastLineIndex;
+	};
+
+	mFolds.erase(std::remove_if(mFolds.begin(), mFolds.end(), isInside), mFolds.end());
+	mFolds.insert(mFolds.begin() + (std::ptrdiff_t)numFoldsBefore(headerLineIndex), Fold { headerLineIndex, lastLineIndex });
+	update();
+	mVersion++;
+}
+
+bool FoldIndex::unfold(std::size_t headerLineIndex) {
+	auto index = numFoldsBefore(headerLineIndex);
+	if (index >= mFolds.size() || mFolds[index].headerLineIndex != headerLineIndex) {
+		return false;
+	}
+
+	mFolds.erase(mFolds.begin() + (std::ptrdiff_t)index);
+	update();
+	mVersion++;
+	return true;
+}
+
+bool FoldIndex::reveal(std::size_t lineIndex) {
+	auto index = numFoldsBefore(lineIndex);
+	if (index == 0 || lineIndex > mFolds[index - 1].lastLineIndex) {
+		return false;
+	}
+
+	return unfold(mFolds[index - 1].headerLineIndex);
+}
+
+void FoldIndex::clear() {
+	if (mFolds.empty()) {
+		return;
+	}
+
+	mFolds.clear();
+	update();
+	mVersion++;
+}
+
+bool FoldIndex::isHidden(std::size_t lineIndex) const {
+	auto index = numFoldsBefore(lineIndex);
+	return index > 0 && lineIndex <= mFolds[index - 1].lastLineIndex;
+}
+
+std::size_t FoldIndex::getVisualLineIndex(std::size_t lineIndex) const {
+	auto index = numFoldsBefore(lineIndex);
+	if (index > 0 && lineIndex <= mFolds[index - 1].lastLineIndex) {
+		return mVisualHeaderLineIndices[index - 1];
+	}
+
+	return lineIndex - (index > 0 ? mNumHiddenBefore[index] : 0);
+}
+
+std::size_t FoldIndex::getTextLineIndex(std::size_t visualLineIndex) const {
+	// The lines after a header are the lines after the fold
+	auto header = std::lower_bound(mVisualHeaderLineIndices.begin(), mVisualHeaderLineIndices.end(), visualLineIndex);
+	auto index = (std::size_t)(header - mVisualHeaderLineIndices.begin());
+	return visualLineIndex + (index > 0 ? mNumHiddenBefore[index] : 0);
+}
+
+void FoldIndex::replaceLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines) {
+	if (mFolds.empty()) {
+		return;
+	}
+
+	auto diff = (std::int64_t)numNewLines - (std::int64_t)numOldLines;
+	auto endLineIndex = lineIndex + numOldLines;
+	auto isHeaderEdit = numOldLines == 1 && numNewLines == 1;
+
+	std::vector<Fold> folds;
+	for (auto& fold : mFolds) {
+		if (fold.lastLineIndex < lineIndex || (isHeaderEdit && fold.headerLineIndex == lineIndex)) {
+			folds.push_back(fold);
+		} else if (fold.headerLineIndex >= endLineIndex) {
+			folds.push_back(Fold {
+				(std::size_t)((std::int64_t)fold.headerLineIndex + diff),
+				(std::size_t)((std::int64_t)fold.lastLineIndex + diff)
+			});
+		}
+	}
+
+	// Moving the folds does not change which lines are hidden, but removing them does
+	if (folds.size() != mFolds.size()) {
+		mVersion++;
+	}
+
+	mFolds = std::move(folds);
+	update();
+}
+
+bool FoldIndex::hasChanged(std::size_t& version) const {
+	if (mVersion != version) {
+		version = mVersion;
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/**
+ * Represents a folded region, where the lines after the header line up to and including the last line are hidden
+ */
+struct Fold {
+	std::size_t headerLineIndex = 0;
+	std::size_t lastLineIndex = 0;
+
+	/**
+	 * Returns the number of hidden lines
+	 */
+	std::size_t numHiddenLines() const;
+};
+
+/**
+ * Keeps the folded regions of a text, and maps between text lines and visible lines. Nested folds are merged into the
+ * outer fold, which keeps the folds ordered and disjoint. A mapping is a binary search over the folds, which means
+ * that it does not depend on the number of lines in the text or in the folds.
+ */
+class FoldIndex {
+private:
+	std::vector<Fold> mFolds;
+	std::vector<std::size_t> mNumHiddenBefore;
+	std::vector<std::size_t> mVisualHeaderLineIndices;
+	std::size_t mVersion = 0;
+
+	/**
+	 * Recomputes the number of lines hidden before each fold after the folds have changed or moved
+	 */
+	void update();
+
+	/**
+	 * Returns the number of folds that start before the given line
+	 * @param lineIndex The index of the line
+	 */
+	std::size_t numFoldsBefore(std::size_t lineIndex) const;
+public:
+	/**
+	 * Indicates if there are no folds
+	 */
+	bool empty() const;
+
+	/**
+	 * Returns the folds, ordered by their header line
+	 */
+	const std::vector<Fold>& folds() const;
+
+	/**
+	 * Returns the number of hidden lines
+	 */
+	std::size_t numHiddenLines() const;
+
+	/**
+	 * Returns the fold with the given header line, or null if there is none
+	 * @param headerLineIndex The index of the header line
+	 */
+	const Fold* findFold(std::size_t headerLineIndex) const;
+
+	/**
+	 * Folds the given lines, which replaces the folds inside them
+	 * @param headerLineIndex The index of the header line, which is still shown
+	 * @param lastLineIndex The index of the last hidden line
+	 */
+	void fold(std::size_t headerLineIndex, std::size_t lastLineIndex);
+
+	/**
+	 * Removes the fold with the given header line
+	 * @param headerLineIndex The index of the header line
+	 * @return True if there was a fold
+	 */
+	bool unfold(std::size_t headerLineIndex);
+
+	/**
+	 * Removes the fold that hides the given line
+	 * @param lineIndex The index of the line
+	 * @return True if the line was hidden
+	 */
+	bool reveal(std::size_t lineIndex);
+
+	/**
+	 * Removes all folds
+	 */
+	void clear();
+
+	/**
+	 * Indicates if the given line is hidden
+	 * @param lineIndex The index of the line
+	 */
+	bool isHidden(std::size_t lineIndex) const;
+
+	/**
+	 * Returns the index of the visible line that shows the given text line, which is the header for a hidden line
+	 * @param lineIndex The index of the text line
+	 */
+	std::size_t getVisualLineIndex(std::size_t lineIndex) const;
+
+	/**
+	 * Returns the index of the text line shown at the given visible line
+	 * @param visualLineIndex The index of the visible line
+	 */
+	std::size_t getTextLineIndex(std::size_t visualLineIndex) const;
+
+	/**
+	 * Updates the folds after the given lines have been replaced. Folds after the lines are moved, and folds that
+	 * overlap them are removed, except when only the header line has been edited.
+	 * @param lineIndex The index of the first replaced line
+	 * @param numOldLines The number of lines before the change
+	 * @param numNewLines The number of lines after the change
+	 */
+	void replaceLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines);
+
+	/**
+	 * Indicates if the hidden lines have changed, other than by moving with the text
+	 * @param version The version to check for. If changed, updates version
+	 */
+	bool hasChanged(std::size_t& version) const;
+};
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "formattedlinecache.h"
+
+FormattedLineCache::FormattedLineCache(std::size_t capacity)
+	: mCapacity(capacity) {
+
+}
+
+std::size_t FormattedLineCache::size() const {
+	return mEntries.size();
+}
+
+std::size_t FormattedLineCache::numHits() const {
+	return mNumHits;
+}
+
+std::size_t FormattedLineCache::numMisses() const {
+	return mNumMisses;
+}
+
+std::shared_ptr<const FormattedLine> FormattedLineCache::get(std::size_t lineVersion) {
+	auto entryIterator = mEntryLookup.find(lineVersion);
+	if (entryIterator == mEntryLookup.end()) {
+		mNumMisses++;
+		return {};
+	}
+
+	mNumHits++;
+	mEntries.splice(mEntries.begin(), mEntries, entryIterator->second);
+	return entryIterator->second->second;
+}
+
+void FormattedLineCache::put(std::size_t lineVersion, std::shared_ptr<const FormattedLine> formattedLine) {
+	auto entryIterator = mEntryLookup.find(lineVersion);
+	if (entryIterator != mEntryLookup.end()) {
+		entryIterator->second->second = std::move(formattedLine);
+		mEntries.splice(mEntries.begin(), mEntries, entryIterator->second);
+		return;
+	}
+
+	mEntries.emplace_front(lineVersion, std::move(formattedLine));
+	mEntryLookup[lineVersion] = mEntries.begin();
+
+	while (mEntries.size() > mCapacity) {
+		mEntryLookup.erase(mEntries.back().first);
+		mEntries.pop_back();
+	}
+}
+
+void FormattedLineCache::clear() {
+	mEntries.clear();
+	mEntryLookup.clear();
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "formattedtext.h"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+/**
+ * A least recently used cache of formatted lines keyed by the version of the text line. As the version of a line only
+ * changes when its content changes, cached lines survive view moves as well as edits to other lines.
+ */
+class FormattedLineCache {
+private:
+	using Entry = std::pair<std::size_t, std::shared_ptr<const FormattedLine>>;
+
+	std::size_t mCapacity;
+	std::list<Entry> mEntries;
+	std::unordered_map<std::size_t, std::list<Entry>::iterator> mEntryLookup;
+
+	std::size_t mNumHits = 0;
+	std::size_t mNumMisses = 0;
+public:
+	/**
+	 * Creates a new cache
+	 * @param capacity The maximum number of lines in the cache
+	 */
+	explicit FormattedLineCache(std::size_t capacity = 4096);
+
+	/**
+	 * Returns the number of lines in the cache
+	 */
+	std::size_t size() const;
+
+	/**
+	 * Returns the number of lookups that found a line
+	 */
+	std::size_t numHits() const;
+
+	/**
+	 * Returns the number of lookups that did not find a line
+	 */
+	std::size_t numMisses() const;
+
+	/**
+	 * Returns the formatted line for the given line version, or null if not cached
+	 * @param lineVersion The version of the line
+	 */
+	std::shared_ptr<const FormattedLine> get(std::size_t lineVersion);
+
+	/**
+	 * Adds the given formatted line. If the cache is full, the least recently used line is removed.
+	 * @param lineVersion The version of the line
+	 * @param formattedLine The formatted line
+	 */
+	void put(std::size_t lineVersion, std::shared_ptr<const FormattedLine> formattedLine);
+
+	/**
+	 * Removes all lines
+	 */
+	void clear();
+};
\ No newline at end of file
@@ -1,11 +1,18 @@
 #include "formattedtext.h"
 
-FormattedLine::FormattedLine() {
+FormattedLine::FormattedLine()
+	: version(nextVersion()) {
 
 }
 
+std::uint64_t FormattedLine::nextVersion() {
+	static std::uint64_t currentVersion = 0;
+	return ++currentVersion;
+}
+
 void FormattedLine::addToken(Token token) {
 	tokens.push_back(std::move(token));
+	version = nextVersion();
 }
 
 std::size_t FormattedLine::length() const {
@@ -28,6 +35,22 @@ String FormattedLine::toString() const {
 	return line;
 }
 
+const FormattedLine& BaseFormattedText::readLine(std::size_t index, ReadLinesBuffer& buffer) const {
+	return getLine(index);
+}
+
+float BaseFormattedText::getLineWidth(std::size_t index) const {
+	return getLine(index).width;
+}
+
+std::size_t BaseFormattedText::getVisualLineIndex(std::size_t lineIndex, std::size_t charIndex) const {
+	return lineIndex;
+}
+
+std::size_t BaseFormattedText::getTextLineIndex(std::size_t visualLineIndex) const {
+	return visualLineIndex;
+}
+
 std::size_t FormattedText::numLines() const {
 	return mLines.size();
 }
@@ -53,11 +76,15 @@ void PartialFormattedText::setNumLines(std::size_t count) {
 }
 
 const FormattedLine& PartialFormattedText::getLine(std::size_t index) const {
-	return mLines.at(index);
+	return *mLines.at(index);
 }
 
 void PartialFormattedText::addLine(std::size_t index, FormattedLine tokens) {
-	mLines[index] = std::move(tokens);
+	mLines[index] = std::make_shared<const FormattedLine>(std::move(tokens));
+}
+
+void PartialFormattedText::addLine(std::size_t index, std::shared_ptr<const FormattedLine> formattedLine) {
+	mLines[index] = std::move(formattedLine);
 }
 
 bool PartialFormattedText::hasLine(std::size_t index) const {
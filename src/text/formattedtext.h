@@ -2,6 +2,7 @@
 #include "text.h"
 
 #include <list>
+#include <memory>
 #include <unordered_map>
 
 /**
@@ -31,12 +32,22 @@ struct FormattedLine {
 	std::vector<Token> tokens;
 	std::size_t offsetFromTextLine = 0;
 	bool isContinuation = false;
+	float width = 0.0f;
 	std::int64_t reformatAmount = 0;
 	std::int64_t reformatStartSearch = 0;
 	bool mayRequireSearch = false;
+	bool endsInBlockComment = false;
+
+	// Identifies the tokens of the line. A new version is given when the tokens change, while copies share it.
+	std::uint64_t version;
 
 	FormattedLine();
 
+	/**
+	 * Returns a version that has not been given to any line
+	 */
+	static std::uint64_t nextVersion();
+
 	/**
 	 * Adds the given token
 	 * @param token The token
@@ -54,6 +65,14 @@ struct FormattedLine {
 	String toString() const;
 };
 
+/**
+ * Holds the lines that are formatted when read once, such as for indexing, which are not kept by the formatted text
+ */
+struct ReadLinesBuffer {
+	std::size_t startLineIndex = 0;
+	std::vector<FormattedLine> lines;
+};
+
 /**
  * Represents a base class for formatted text
  */
@@ -71,6 +90,33 @@ public:
 	 * @param index The index
 	 */
 	virtual const FormattedLine& getLine(std::size_t index) const = 0;
+
+	/**
+	 * Returns the formatting for the given line when it is read once. Unlike getLine, a line that is formatted when
+	 * accessed is not kept by the text, but formatted into the given buffer.
+	 * @param index The index
+	 * @param buffer The buffer
+	 */
+	virtual const FormattedLine& readLine(std::size_t index, ReadLinesBuffer& buffer) const;
+
+	/**
+	 * Returns the width of the given line
+	 * @param index The index
+	 */
+	virtual float getLineWidth(std::size_t index) const;
+
+	/**
+	 * Returns the index of the visual line that the given position in the text is shown at
+	 * @param lineIndex The index of the text line
+	 * @param charIndex The index of the character in the text line
+	 */
+	virtual std::size_t getVisualLineIndex(std::size_t lineIndex, std::size_t charIndex) const;
+
+	/**
+	 * Returns the index of the text line that the given visual line shows
+	 * @param visualLineIndex The index of the visual line
+	 */
+	virtual std::size_t getTextLineIndex(std::size_t visualLineIndex) const;
 };
 
 /**
@@ -109,7 +155,7 @@ public:
 class PartialFormattedText : public BaseFormattedText {
 private:
 	std::size_t mTotalLines;
-	std::unordered_map<std::size_t, FormattedLine> mLines;
+	std::unordered_map<std::size_t, std::shared_ptr<const FormattedLine>> mLines;
 public:
 	/**
 	 * Returns the number of lines
@@ -135,6 +181,13 @@ public:
 	 */
 	void addLine(std::size_t index, FormattedLine tokens);
 
+	/**
+	 * Adds the given line, which can be shared with other formatted texts
+	 * @param index The index for the line
+	 * @param formattedLine The formatted line
+	 */
+	void addLine(std::size_t index, std::shared_ptr<const FormattedLine> formattedLine);
+
 	/**
 	 * Indicates if the given line exists
 	 * @param index The index
@@ -1,6 +1,9 @@
 #pragma once
 #include "text.h"
 
+#include <cctype>
+#include <vector>
+
 /**
  * The format mode
  */
@@ -10,41 +13,41 @@ enum class FormatMode : std::uint8_t {
 };
 
 /**
- * The rules formatting
+ * The formatting rules are compile-time policies used by the formatter state machine. A rules type must provide:
+ *
+ *  - mode: the mode
+ *  - lineCommentStart, blockCommentStart, blockCommentEnd: the comment delimiters, either as null-terminated Char
+ *    arrays or as Strings
+ *  - bool isKeyword(const String& string) const: indicates if the given string is a keyword
+ *  - bool isStringDelimiter(Char current) const: indicates if the given char is a string delimiter
+ *  - bool isNumberChar(Char current) const: indicates if the given char continues a number
+ *  - bool isOperator(Char current) const: indicates if the given char is a token of its own
+ *  - std::vector<String> keywords() const: returns the keywords, which are offered as completions
+ *
+ * For the built-in rules, the delimiters and mode are static constants, which lets the compiler fold the checks in
+ * the state machine. Rules loaded at runtime use members instead.
  */
-class FormatterRules {
+class BaseFormatterRules {
 public:
-	virtual ~FormatterRules() = default;
-
-	/**
-	 * Returns the mode
-	 */
-	virtual FormatMode mode() const = 0;
-
-	/**
-	 * Indicates if the given string is a keyword
-	 * @param string The string
-	 */
-	virtual bool isKeyword(const String& string) const = 0;
-
-	/**
-	 * The start of a line comment
-	 */
-	virtual const String& lineCommentStart() const = 0;
-
-	/**
-	 * The start of a block comment
-	 */
-	virtual const String& blockCommentStart() const = 0;
-
-	/**
-	 * The end of a block comment
-	 */
-	virtual const String& blockCommentEnd() const = 0;
-
-	/**
-	 * Indicates if the given char is a string delimiter
-	 * @param current The character
-	 */
-	virtual bool isStringDelimiter(Char current) const = 0;
-};
\ No newline at end of file
+	inline bool isNumberChar(Char current) const {
+		return std::isdigit(current) || current == '.' || current == 'f';
+	}
+
+	inline bool isOperator(Char current) const {
+		switch (current) {
+			case ',':
+			case '(':
+			case ')':
+			case '&':
+			case ':':
+			case '*':
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	inline std::vector<String> keywords() const {
+		return {};
+	}
+};
@@ -1,5 +1,10 @@
 #include "cpp.h"
 
+constexpr FormatMode CppFormatterRules::mode;
+constexpr Char CppFormatterRules::lineCommentStart[];
+constexpr Char CppFormatterRules::blockCommentStart[];
+constexpr Char CppFormatterRules::blockCommentEnd[];
+
 CppFormatterRules::CppFormatterRules()
 	: mKeywords { {
 		  "if",
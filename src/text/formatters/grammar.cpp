@@ -0,0 +1,30 @@
+#include "grammar.h"
+
+namespace {
+	std::unordered_set<std::string> createKeywordSet(const std::vector<std::string>& keywords) {
+		return std::unordered_set<std::string>(keywords.begin(), keywords.end());
+	}
+}
+
+GrammarFormatterRules::GrammarFormatterRules(const Grammar& grammar)
+	: mKeywords(createKeywordSet(grammar.keywords)),
+	  mStringDelimiters(createCharTable(grammar.stringDelimiters)),
+	  mNumberChars(createCharTable(grammar.numberChars)),
+	  mOperators(createCharTable(grammar.operators)),
+	  mode(grammar.mode),
+	  lineCommentStart(grammar.lineCommentStart),
+	  blockCommentStart(grammar.blockCommentStart),
+	  blockCommentEnd(grammar.blockCommentEnd) {
+
+}
+
+GrammarFormatterRules::CharTable GrammarFormatterRules::createCharTable(const String& chars) {
+	CharTable table;
+	for (auto current : chars) {
+		if (current < table.size()) {
+			table[current] = true;
+		}
+	}
+
+	return table;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "../formatterrules.h"
+#include "../helpers.h"
+#include "../grammar.h"
+
+#include <bitset>
+
+/**
+ * Defines formatting rules loaded from a grammar file. The chars are looked up in tables, and the keywords use the
+ * same keyword list as the built-in rules.
+ */
+class GrammarFormatterRules {
+private:
+	using CharTable = std::bitset<256>;
+
+	KeywordList mKeywords;
+	CharTable mStringDelimiters;
+	CharTable mNumberChars;
+	CharTable mOperators;
+
+	/**
+	 * Creates a table for the given chars
+	 * @param chars The chars
+	 */
+	static CharTable createCharTable(const String& chars);
+
+	inline static bool isInTable(const CharTable& table, Char current) {
+		return current < table.size() && table[current];
+	}
+public:
+	FormatMode mode;
+	String lineCommentStart;
+	String blockCommentStart;
+	String blockCommentEnd;
+
+	/**
+	 * Creates the rules for the given grammar
+	 * @param grammar The grammar
+	 */
+	explicit GrammarFormatterRules(const Grammar& grammar);
+
+	inline bool isKeyword(const String& string) const {
+		return mKeywords.isKeyword(string);
+	}
+
+	inline std::vector<String> keywords() const {
+		return mKeywords.keywords();
+	}
+
+	inline bool isStringDelimiter(Char current) const {
+		return isInTable(mStringDelimiters, current);
+	}
+
+	inline bool isNumberChar(Char current) const {
+		return isInTable(mNumberChars, current);
+	}
+
+	inline bool isOperator(Char current) const {
+		return isInTable(mOperators, current);
+	}
+};
\ No newline at end of file
@@ -1,5 +1,10 @@
 #include "python.h"
 
+constexpr FormatMode PythonFormatterRules::mode;
+constexpr Char PythonFormatterRules::lineCommentStart[];
+constexpr Char PythonFormatterRules::blockCommentStart[];
+constexpr Char PythonFormatterRules::blockCommentEnd[];
+
 PythonFormatterRules::PythonFormatterRules()
 	: mKeywords { {
 		  "def",
@@ -1,40 +1,30 @@
 #pragma once
-#include "../textformatter.h"
+#include "../formatterrules.h"
+#include "../helpers.h"
 
 /**
  * Defines Python formatting rules
  */
-class PythonFormatterRules : public FormatterRules {
+class PythonFormatterRules : public BaseFormatterRules {
 private:
 	KeywordList mKeywords;
-	String mLineCommentStart = u"#";
-	String mBlockCommentStart = u"\"\"\"";
-	String mBlockCommentEnd = u"\"\"\"";
 public:
-	PythonFormatterRules();
-	virtual ~PythonFormatterRules() override = default;
+	static constexpr FormatMode mode = FormatMode::Code;
+	static constexpr Char lineCommentStart[] = u"#";
+	static constexpr Char blockCommentStart[] = u"\"\"\"";
+	static constexpr Char blockCommentEnd[] = u"\"\"\"";
 
-	inline virtual FormatMode mode() const override {
-		return FormatMode::Code;
-	}
+	PythonFormatterRules();
 
-	inline virtual bool isKeyword(const String& string) const override {
+	inline bool isKeyword(const String& string) const {
 		return mKeywords.isKeyword(string);
 	}
 
-	inline virtual const String& lineCommentStart() const override {
-		return mLineCommentStart;
-	}
-
-	inline virtual const String& blockCommentStart() const override {
-		return mBlockCommentStart;
-	}
-
-	inline virtual const String& blockCommentEnd() const override {
-		return mBlockCommentEnd;
+	inline std::vector<String> keywords() const {
+		return mKeywords.keywords();
 	}
 
-	inline virtual bool isStringDelimiter(Char current) const override {
+	inline bool isStringDelimiter(Char current) const {
 		return current == '"' || current == '\'';
 	}
 };
\ No newline at end of file
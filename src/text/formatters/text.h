@@ -1,21 +1,21 @@
 #pragma once
-
-#include "../textformatter.h"
+#include "../formatterrules.h"
 
 /**
  * Defines text formatting rules
  */
-class TextFormatterRules : public FormatterRules {
-private:
-	String mEmpty;
+class TextFormatterRules : public BaseFormatterRules {
 public:
-	virtual FormatMode mode() const override;
-
-	virtual bool isKeyword(const String& string) const override;
+	static constexpr FormatMode mode = FormatMode::Text;
+	static constexpr Char lineCommentStart[] = u"";
+	static constexpr Char blockCommentStart[] = u"";
+	static constexpr Char blockCommentEnd[] = u"";
 
-	virtual const String& lineCommentStart() const override;
-	virtual const String& blockCommentStart() const override;
-	virtual const String& blockCommentEnd() const override;
+	inline bool isKeyword(const String& string) const {
+		return false;
+	}
 
-	virtual bool isStringDelimiter(Char current) const override;
+	inline bool isStringDelimiter(Char current) const {
+		return false;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include "grammar.h"
+#include "../helpers.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+namespace {
+	const std::uint32_t CACHE_MAGIC = 0x4D415247;
+	const std::uint32_t CACHE_VERSION = 2;
+
+	// The formatter only remembers the last few chars, which limits the length of delimiters
+	const std::size_t MAX_DELIMITER_LENGTH = 6;
+
+	std::string trim(const std::string& str) {
+		auto start = str.find_first_not_of(" \t\r");
+		if (start == std::string::npos) {
+			return "";
+		}
+
+		auto end = str.find_last_not_of(" \t\r");
+		return str.substr(start, end - start + 1);
+	}
+
+	std::vector<std::string> split(const std::string& str) {
+		std::vector<std::string> parts;
+		std::istringstream stream(str);
+		std::string part;
+		while (stream >> part) {
+			parts.push_back(part);
+		}
+
+		return parts;
+	}
+
+	String toChars(const std::string& str) {
+		String chars;
+		for (auto& part : split(str)) {
+			chars += Helpers::fromString<String>(part);
+		}
+
+		return chars;
+	}
+
+	String toDelimiter(const std::string& str) {
+		auto delimiter = Helpers::fromString<String>(str);
+		if (delimiter.size() > MAX_DELIMITER_LENGTH) {
+			throw std::runtime_error("The delimiter '" + str + "' is too long.");
+		}
+
+		return delimiter;
+	}
+
+	/**
+	 * The modification time and size of a grammar file, which decides if the cached grammar is still valid
+	 */
+	struct FileStamp {
+		std::int64_t time = 0;
+		std::int64_t size = 0;
+
+		bool operator==(const FileStamp& other) const {
+			return time == other.time && size == other.size;
+		}
+	};
+
+	bool fileStamp(const std::string& fileName, FileStamp& stamp) {
+		struct stat fileStat;
+		if (stat(fileName.c_str(), &fileStat) != 0) {
+			return false;
+		}
+
+		stamp.time = (std::int64_t)fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+		stamp.size = (std::int64_t)fileStat.st_size;
+		return true;
+	}
+
+	template<typename T>
+	void writeValue(std::ostream& stream, const T& value) {
+		stream.write((const char*)&value, sizeof(T));
+	}
+
+	template<typename T>
+	bool readValue(std::istream& stream, T& value) {
+		stream.read((char*)&value, sizeof(T));
+		return (bool)stream;
+	}
+
+	template<typename TString>
+	void writeString(std::ostream& stream, const TString& str) {
+		writeValue(stream, (std::uint32_t)str.size());
+		stream.write((const char*)str.data(), str.size() * sizeof(typename TString::value_type));
+	}
+
+	template<typename TString>
+	bool readString(std::istream& stream, TString& str) {
+		std::uint32_t size = 0;
+		if (!readValue(stream, size) || size > (1u << 20)) {
+			return false;
+		}
+
+		str.resize(size);
+		stream.read((char*)&str[0], size * sizeof(typename TString::value_type));
+		return (bool)stream;
+	}
+
+	void writeStrings(std::ostream& stream, const std::vector<std::string>& strings) {
+		writeValue(stream, (std::uint32_t)strings.size());
+		for (auto& str : strings) {
+			writeString(stream, str);
+		}
+	}
+
+	bool readStrings(std::istream& stream, std::vector<std::string>& strings) {
+		std::uint32_t size = 0;
+		if (!readValue(stream, size) || size > (1u << 20)) {
+			return false;
+		}
+
+		strings.resize(size);
+		for (auto& str : strings) {
+			if (!readString(stream, str)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+bool Grammar::matches(const std::string& fileName) const {
+	for (auto& extension : extensions) {
+		if (fileName.size() >= extension.size()
+			&& fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+Grammar GrammarLoader::parse(const std::string& content) {
+	Grammar grammar;
+
+	std::istringstream stream(content);
+	std::string line;
+	std::size_t lineNumber = 0;
+	while (std::getline(stream, line)) {
+		lineNumber++;
+		line = trim(line);
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		auto separator = line.find('=');
+		if (separator == std::string::npos) {
+			throw std::runtime_error("Expected 'key = value' at line " + std::to_string(lineNumber) + ".");
+		}
+
+		auto key = trim(line.substr(0, separator));
+		auto value = trim(line.substr(separator + 1));
+
+		if (key == "name") {
+			grammar.name = value;
+		} else if (key == "extensions") {
+			grammar.extensions = split(value);
+		} else if (key == "mode") {
+			if (value == "code") {
+				grammar.mode = FormatMode::Code;
+			} else if (value == "text") {
+				grammar.mode = FormatMode::Text;
+			} else {
+				throw std::runtime_error("Invalid mode '" + value + "' at line " + std::to_string(lineNumber) + ".");
+			}
+		} else if (key == "keywords") {
+			for (auto& keyword : split(value)) {
+				grammar.keywords.push_back(keyword);
+			}
+		} else if (key == "line_comment") {
+			grammar.lineCommentStart = toDelimiter(value);
+		} else if (key == "block_comment") {
+			auto delimiters = split(value);
+			if (delimiters.size() != 2) {
+				throw std::runtime_error("Expected start and end of block comment at line " + std::to_string(lineNumber) + ".");
+			}
+
+			grammar.blockCommentStart = toDelimiter(delimiters[0]);
+			grammar.blockCommentEnd = toDelimiter(delimiters[1]);
+		} else if (key == "string_delimiters") {
+			grammar.stringDelimiters = toChars(value);
+		} else if (key == "number_chars") {
+			grammar.numberChars = toChars(value);
+		} else if (key == "operators") {
+			grammar.operators = toChars(value);
+		} else {
+			throw std::runtime_error("Unknown key '" + key + "' at line " + std::to_string(lineNumber) + ".");
+		}
+	}
+
+	return grammar;
+}
+
+void GrammarLoader::write(std::ostream& stream, const Grammar& grammar) {
+	writeString(stream, grammar.name);
+	writeStrings(stream, grammar.extensions);
+	writeValue(stream, (std::uint8_t)grammar.mode);
+	writeStrings(stream, grammar.keywords);
+	writeString(stream, grammar.lineCommentStart);
+	writeString(stream, grammar.blockCommentStart);
+	writeString(stream, grammar.blockCommentEnd);
+	writeString(stream, grammar.stringDelimiters);
+	writeString(stream, grammar.numberChars);
+	writeString(stream, grammar.operators);
+}
+
+bool GrammarLoader::read(std::istream& stream, Grammar& grammar) {
+	std::uint8_t mode = 0;
+	bool success = readString(stream, grammar.name)
+				   && readStrings(stream, grammar.extensions)
+				   && readValue(stream, mode)
+				   && readStrings(stream, grammar.keywords)
+				   && readString(stream, grammar.lineCommentStart)
+				   && readString(stream, grammar.blockCommentStart)
+				   && readString(stream, grammar.blockCommentEnd)
+				   && readString(stream, grammar.stringDelimiters)
+				   && readString(stream, grammar.numberChars)
+				   && readString(stream, grammar.operators);
+
+	grammar.mode = (FormatMode)mode;
+	return success;
+}
+
+std::vector<Grammar> GrammarLoader::load(const std::string& indexFileName, const std::string& cacheFileName) {
+	auto t0 = Helpers::timeNow();
+
+	std::unordered_map<std::string, std::pair<FileStamp, Grammar>> cachedGrammars;
+	std::ifstream cacheStream(cacheFileName, std::ios::binary);
+	std::uint32_t magic = 0;
+	std::uint32_t version = 0;
+	std::uint32_t numCachedGrammars = 0;
+	if (readValue(cacheStream, magic) && magic == CACHE_MAGIC
+		&& readValue(cacheStream, version) && version == CACHE_VERSION
+		&& readValue(cacheStream, numCachedGrammars)) {
+		for (std::uint32_t i = 0; i < numCachedGrammars; i++) {
+			std::string fileName;
+			std::pair<FileStamp, Grammar> cachedGrammar;
+			if (!readString(cacheStream, fileName)
+				|| !readValue(cacheStream, cachedGrammar.first.time)
+				|| !readValue(cacheStream, cachedGrammar.first.size)
+				|| !read(cacheStream, cachedGrammar.second)) {
+				break;
+			}
+
+			cachedGrammars[fileName] = std::move(cachedGrammar);
+		}
+	}
+
+	std::string index;
+	try {
+		index = Helpers::readFileAsUTF8Text(indexFileName);
+	} catch (const std::exception& e) {
+		std::cout << "No grammars loaded: " << e.what() << std::endl;
+		return {};
+	}
+
+	auto directory = indexFileName.substr(0, indexFileName.find_last_of("/\\") + 1);
+	std::istringstream indexStream(index);
+	std::vector<std::string> fileNames;
+	std::vector<FileStamp> stamps;
+	std::vector<Grammar> grammars;
+	std::size_t numParsed = 0;
+
+	std::string fileName;
+	while (std::getline(indexStream, fileName)) {
+		fileName = trim(fileName);
+		if (fileName.empty() || fileName[0] == '#') {
+			continue;
+		}
+
+		// A grammar that cannot be read or parsed is skipped, so that it does not prevent loading the others
+		FileStamp stamp;
+		if (!fileStamp(directory + fileName, stamp)) {
+			std::cout << "Skipped grammar '" << fileName << "': The file does not exist." << std::endl;
+			continue;
+		}
+
+		auto cachedGrammar = cachedGrammars.find(fileName);
+		if (cachedGrammar != cachedGrammars.end() && cachedGrammar->second.first == stamp) {
+			grammars.push_back(cachedGrammar->second.second);
+		} else {
+			try {
+				grammars.push_back(parse(Helpers::readFileAsUTF8Text(directory + fileName)));
+			} catch (const std::exception& e) {
+				std::cout << "Skipped grammar '" << fileName << "': " << e.what() << std::endl;
+				continue;
+			}
+
+			numParsed++;
+		}
+
+		fileNames.push_back(fileName);
+		stamps.push_back(stamp);
+	}
+
+	if (numParsed > 0 || cachedGrammars.size() != grammars.size()) {
+		std::ofstream outputCacheStream(cacheFileName, std::ios::binary);
+		if (outputCacheStream.is_open()) {
+			writeValue(outputCacheStream, CACHE_MAGIC);
+			writeValue(outputCacheStream, CACHE_VERSION);
+			writeValue(outputCacheStream, (std::uint32_t)grammars.size());
+			for (std::size_t i = 0; i < grammars.size(); i++) {
+				writeString(outputCacheStream, fileNames[i]);
+				writeValue(outputCacheStream, stamps[i].time);
+				writeValue(outputCacheStream, stamps[i].size);
+				write(outputCacheStream, grammars[i]);
+			}
+		}
+	}
+
+	std::cout
+		<< "Loaded grammars (count = " << grammars.size() << ", parsed = " << numParsed << ") in "
+		<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
+		<< std::endl;
+
+	return grammars;
+}
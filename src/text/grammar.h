@@ -0,0 +1,77 @@
+#pragma once
+#include "text.h"
+#include "formatterrules.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+/**
+ * Represents the definition of a language loaded from a grammar file
+ */
+struct Grammar {
+	std::string name;
+	std::vector<std::string> extensions;
+	FormatMode mode = FormatMode::Code;
+
+	std::vector<std::string> keywords;
+	String lineCommentStart;
+	String blockCommentStart;
+	String blockCommentEnd;
+	String stringDelimiters = u"\"'";
+	String numberChars = u"0123456789.f";
+	String operators = u",()&:*";
+
+	/**
+	 * Indicates if the given file name has one of the extensions of the grammar
+	 * @param fileName The file name
+	 */
+	bool matches(const std::string& fileName) const;
+};
+
+/**
+ * Loads grammar files. A grammar file consists of lines with the format "key = value", where empty lines and lines
+ * starting with # are ignored. The keys are:
+ *
+ *  - name: the name of the language
+ *  - extensions: the file extensions, separated by spaces
+ *  - mode: code or text
+ *  - keywords: the keywords, separated by spaces. Can be given multiple times.
+ *  - line_comment: the start of a line comment
+ *  - block_comment: the start and end of a block comment, separated by a space
+ *  - string_delimiters: the chars that start and end strings
+ *  - number_chars: the chars that continue a number after the first digit
+ *  - operators: the chars that are tokens of their own, separated by spaces
+ */
+class GrammarLoader {
+public:
+	/**
+	 * Parses the given grammar file content
+	 * @param content The content of the grammar file
+	 */
+	static Grammar parse(const std::string& content);
+
+	/**
+	 * Writes the given grammar in binary form
+	 * @param stream The stream
+	 * @param grammar The grammar
+	 */
+	static void write(std::ostream& stream, const Grammar& grammar);
+
+	/**
+	 * Reads a grammar in binary form
+	 * @param stream The stream
+	 * @param grammar The grammar
+	 * @return True if read successfully
+	 */
+	static bool read(std::istream& stream, Grammar& grammar);
+
+	/**
+	 * Loads the grammar files listed in the given index file, one per line relative to the index. The grammars are
+	 * cached in binary form in the given cache file, and a grammar file is only parsed when its modification time or
+	 * size has changed. A grammar that cannot be read or parsed is skipped, and a missing index gives no grammars.
+	 * @param indexFileName The name of the index file
+	 * @param cacheFileName The name of the cache file
+	 */
+	static std::vector<Grammar> load(const std::string& indexFileName, const std::string& cacheFileName);
+};
\ No newline at end of file
@@ -7,4 +7,14 @@ KeywordList::KeywordList(const std::unordered_set<std::string>& keywords) {
 		mKeywords.insert(keywordStr);
 		mMaxLength = std::max(mMaxLength, keyword.size());
 	}
+}
+
+std::vector<String> KeywordList::keywords() const {
+	std::vector<String> keywords;
+	keywords.reserve(mKeywords.size());
+	for (auto keyword = mKeywords.begin(); keyword != mKeywords.end(); ++keyword) {
+		keywords.emplace_back(keyword.key(), keyword.key_size());
+	}
+
+	return keywords;
 }
\ No newline at end of file
@@ -29,6 +29,11 @@ public:
 	 */
 	void add(const T& value);
 
+	/**
+	 * Removes all elements, keeping the allocated memory
+	 */
+	void clear();
+
 	/**
 	 * Applies the given function to each element
 	 * @param apply The function
@@ -40,7 +45,7 @@ public:
 template<typename T>
 CircularBuffer<T>::CircularBuffer(std::size_t maxSize)
 	: mMaxSize(maxSize) {
-
+	mData.reserve(maxSize);
 }
 
 template<typename T>
@@ -54,6 +59,12 @@ void CircularBuffer<T>::add(const T& value) {
 	}
 }
 
+template<typename T>
+void CircularBuffer<T>::clear() {
+	mData.clear();
+	mCurrentIndex = 0;
+}
+
 template<typename T>
 void CircularBuffer<T>::forEachElement(std::function<void(const T&)> apply, std::size_t maxSize) {
 	bool showAll = maxSize == (std::size_t)(-1L);
@@ -91,4 +102,9 @@ public:
 
 		return false;
 	}
+
+	/**
+	 * Returns the keywords
+	 */
+	std::vector<String> keywords() const;
 };
\ No newline at end of file
@@ -4,16 +4,16 @@
 IncrementalFormattedText::IncrementalFormattedText(const Font& font,
 												   TextFormatter& textFormatter,
 												   const RenderStyle& renderStyle,
-												   const RenderViewPort& viewPort,
 												   Text& text,
 												   std::size_t& textVersion)
 	: mFont(font),
 	  mRenderStyle(renderStyle),
-	  mViewPort(viewPort),
 	  mTextFormatter(textFormatter),
 	  mText(text),
 	  mTextVersion(textVersion) {
-	mTextFormatter.format(mFont, mRenderStyle, mViewPort, mText, mFormattedLines);
+	FormattedLines formattedLines;
+	mTextFormatter.format(mFont, mRenderStyle, mText, formattedLines);
+	mFormattedLines.assign(std::move(formattedLines));
 }
 
 std::size_t IncrementalFormattedText::numLines() const {
@@ -21,36 +21,83 @@ std::size_t IncrementalFormattedText::numLines() const {
 }
 
 const FormattedLine& IncrementalFormattedText::getLine(std::size_t index) const {
+	if (mFormattedLines.isEvicted(index)) {
+		restoreLines(index);
+	}
+
 	return mFormattedLines[index];
 }
 
-FormatterStateMachine IncrementalFormattedText::createStateMachine(FormattedLines& formattedLines) {
-	return mTextFormatter.createStateMachine(mFont, mRenderStyle, mViewPort, formattedLines);
+const FormattedLine& IncrementalFormattedText::readLine(std::size_t index, ReadLinesBuffer& buffer) const {
+	if (!mFormattedLines.isEvicted(index)) {
+		return mFormattedLines[index];
+	}
+
+	if (index < buffer.startLineIndex || index >= buffer.startLineIndex + buffer.lines.size()) {
+		buffer.lines.clear();
+		buffer.startLineIndex = formatEvictedLines(index, buffer.lines);
+	}
+
+	return buffer.lines[index - buffer.startLineIndex];
+}
+
+float IncrementalFormattedText::getLineWidth(std::size_t index) const {
+	return mFormattedLines.getState(index).width;
 }
 
-namespace {
-	bool isNormalState(const FormatterStateMachine& stateMachine) {
-		return stateMachine.state() == State::Text || stateMachine.state() == State::Number;
+std::size_t IncrementalFormattedText::formatEvictedLines(std::size_t lineIndex, FormattedLines& formattedLines) const {
+	auto chunkRange = mFormattedLines.chunkRange(lineIndex);
+	auto startLineIndex = chunkRange.first;
+	auto endLineIndex = std::min(chunkRange.first + chunkRange.second, mText.numLines()) - 1;
+
+	auto state = State::Text;
+	if (startLineIndex > 0 && mFormattedLines.getState(startLineIndex - 1).endsInBlockComment) {
+		state = State::BlockComment;
 	}
 
-	void formatUntilStateRestored(FormatterStateMachine& stateMachine, const Text& text, std::size_t startLineIndex, std::size_t& numFormattedLines) {
-		for (std::size_t i = startLineIndex; i < text.numLines(); i++) {
-			stateMachine.processLine(text.getLine(i));
-			numFormattedLines++;
+	mTextFormatter.formatLinesInState(mFont, mRenderStyle, mText, startLineIndex, endLineIndex, state, formattedLines);
+	return startLineIndex;
+}
 
-			if (isNormalState(stateMachine)) {
-				break;
-			}
-		}
+void IncrementalFormattedText::restoreLines(std::size_t lineIndex) const {
+	FormattedLines formattedLines;
+	formatEvictedLines(lineIndex, formattedLines);
+	mFormattedLines.restore(lineIndex, std::move(formattedLines));
+}
+
+void IncrementalFormattedText::setWindowSize(std::size_t windowSize) {
+	mWindowSize = windowSize;
+}
+
+void IncrementalFormattedText::updateWindow(std::size_t viewStartLineIndex,
+											std::size_t viewEndLineIndex,
+											std::size_t caretLineIndex) {
+	if (mWindowSize == 0) {
+		return;
+	}
+
+	auto windowStart = [&](std::size_t lineIndex) {
+		return lineIndex - std::min(lineIndex, mWindowSize);
+	};
+
+	auto numEvictedLines = mFormattedLines.evictOutside({
+		{ windowStart(viewStartLineIndex), viewEndLineIndex + mWindowSize },
+		{ windowStart(caretLineIndex), caretLineIndex + mWindowSize }
+	});
+
+	if (numEvictedLines > 0) {
+		std::cout << "Evicted formatting (lines = " << numEvictedLines << ")" << std::endl;
 	}
 }
 
 std::pair<std::size_t, std::size_t> IncrementalFormattedText::findReformatSearchRegion(std::size_t lineIndex) {
-	auto& currentFormattedLine = mFormattedLines[lineIndex];
-	auto& startSearchLine = mFormattedLines[(std::size_t)(lineIndex + currentFormattedLine.reformatStartSearch)];
+	auto currentFormattedLine = mFormattedLines.getState(lineIndex);
+	// The start of a multi-line construct may have been deleted, which leaves the search before the first line
+	auto startSearchLineIndex = (std::size_t)std::max((std::int64_t)lineIndex + currentFormattedLine.reformatStartSearch, (std::int64_t)0);
+	auto startSearchLine = mFormattedLines.getState(startSearchLineIndex);
 
-	auto reformatStart = startSearchLine.number;
-	auto reformatEnd = startSearchLine.number + startSearchLine.reformatAmount;
+	auto reformatStart = startSearchLineIndex;
+	auto reformatEnd = startSearchLineIndex + startSearchLine.reformatAmount;
 
 	return std::make_pair(reformatStart, reformatEnd);
 }
@@ -59,26 +106,7 @@ void IncrementalFormattedText::reformatLine(std::size_t lineIndex) {
 	auto reformatRegion = findReformatSearchRegion(lineIndex);
 
 	if (reformatRegion.first == reformatRegion.second) {
-		FormattedLines formattedLines;
-		auto stateMachine = createStateMachine(formattedLines);
-
-		stateMachine.processLine(mText.getLine(lineIndex));
-
-		std::size_t numFormattedLines = 1;
-		if (formattedLines.front().mayRequireSearch && !isNormalState(stateMachine)) {
-			formatUntilStateRestored(stateMachine, mText, lineIndex + 1, numFormattedLines);
-		}
-
-		if (!stateMachine.currentFormattedLine().tokens.empty()) {
-			stateMachine.createNewLine();
-		}
-
-		std::cout << "reformatLine: " << numFormattedLines << std::endl;
-		for (std::size_t i = 0; i < numFormattedLines; i++) {
-			auto formattedLine = formattedLines[i];
-			formattedLine.number = lineIndex + i;
-			mFormattedLines[lineIndex + i] = std::move(formattedLine);
-		}
+		startFormattingJob(lineIndex, lineIndex);
 	} else {
 		reformatLines(reformatRegion.first, reformatRegion.second);
 	}
@@ -95,36 +123,112 @@ void IncrementalFormattedText::reformatLines(std::size_t startLineIndex, std::si
 		}
 	}
 
-	FormattedLines formattedLines;
-	auto stateMachine = createStateMachine(formattedLines);
-
-	std::size_t numFormattedLines = 0;
-	bool continueFormatting = false;
-	for (std::size_t i = startLineIndex; i <= endLineIndex; i++) {
-		stateMachine.processLine(mText.getLine(i));
-		numFormattedLines++;
-
-		if (i == endLineIndex) {
-			if (!isNormalState(stateMachine)) {
-				continueFormatting = true;
-			}
+	startFormattingJob(startLineIndex, endLineIndex);
+}
+
+void IncrementalFormattedText::startFormattingJob(std::size_t startLineIndex, std::size_t endLineIndex) {
+	// The state at the current position of a running job is not known, so it has to start over
+	if (hasPendingFormatting()) {
+		startLineIndex = std::min(startLineIndex, mFormattingJobStartLineIndex);
+		endLineIndex = std::max(endLineIndex, mFormattingJobEndLineIndex);
+	}
+
+	// The job is kept between edits, which means that a keystroke does not allocate a new job and buffers
+	if (mFormattingJob == nullptr) {
+		mFormattingJob = mTextFormatter.createFormattingJob(mFont, mRenderStyle, mText, startLineIndex, endLineIndex);
+	} else {
+		mFormattingJob->restart(startLineIndex, endLineIndex);
+	}
+
+	mFormattingJobStartLineIndex = startLineIndex;
+	mFormattingJobEndLineIndex = endLineIndex;
+	mNumFormattingJobLinesApplied = 0;
+	mNumFormattingJobSlices = 0;
+
+	auto formattedLines = runFormattingJob();
+	if (formattedLines.second > 0) {
+		if (mEditFormattedStartLineIndex == mEditFormattedEndLineIndex) {
+			mEditFormattedStartLineIndex = formattedLines.first;
+			mEditFormattedEndLineIndex = formattedLines.first + formattedLines.second;
+		} else {
+			mEditFormattedStartLineIndex = std::min(mEditFormattedStartLineIndex, formattedLines.first);
+			mEditFormattedEndLineIndex = std::max(mEditFormattedEndLineIndex, formattedLines.first + formattedLines.second);
 		}
 	}
+}
 
-	if (continueFormatting) {
-		formatUntilStateRestored(stateMachine, mText, endLineIndex + 1, numFormattedLines);
+void IncrementalFormattedText::shiftFormattingJob(std::size_t lineIndex, std::int64_t diff) {
+	if (!hasPendingFormatting()) {
+		return;
 	}
 
-	if (!stateMachine.currentFormattedLine().tokens.empty()) {
-		stateMachine.createNewLine();
+	auto shift = [&](std::size_t& currentLineIndex) {
+		if (currentLineIndex >= lineIndex) {
+			currentLineIndex = (std::size_t)std::max((std::int64_t)lineIndex, (std::int64_t)currentLineIndex + diff);
+		}
+	};
+
+	shift(mFormattingJobStartLineIndex);
+	shift(mFormattingJobEndLineIndex);
+}
+
+void IncrementalFormattedText::setFormattingBudget(std::int64_t budgetMicroseconds) {
+	mFormattingBudget = budgetMicroseconds;
+}
+
+bool IncrementalFormattedText::hasPendingFormatting() const {
+	return mFormattingJob != nullptr && !mFormattingJob->isDone();
+}
+
+std::pair<std::size_t, std::size_t> IncrementalFormattedText::runFormattingJob() {
+	if (!hasPendingFormatting()) {
+		return std::make_pair(0, 0);
+	}
+
+	auto isDone = mFormattingJob->run(mFormattingBudget);
+	mNumFormattingJobSlices++;
+
+	auto& formattedLines = mFormattingJob->formattedLines();
+	auto startLineIndex = mFormattingJobStartLineIndex + mNumFormattingJobLinesApplied;
+	auto numAvailableLines = mFormattedLines.size() - std::min(mFormattingJobStartLineIndex, mFormattedLines.size());
+	auto numFormattedLines = std::min(formattedLines.size(), numAvailableLines);
+
+	for (std::size_t i = mNumFormattingJobLinesApplied; i < numFormattedLines; i++) {
+		auto previousLine = mFormattedLines.exchange(mFormattingJobStartLineIndex + i, std::move(formattedLines[i]));
+		mFormattingJob->recycleLine(std::move(previousLine));
 	}
 
-	std::cout << "reformatLines: " << numFormattedLines << std::endl;
-	for (std::size_t i = 0; i < numFormattedLines; i++) {
-		auto formattedLine = formattedLines[i];
-		formattedLine.number = startLineIndex + i;
-		mFormattedLines[startLineIndex + i] = std::move(formattedLine);
+	auto numAppliedLines = numFormattedLines - std::min(mNumFormattingJobLinesApplied, numFormattedLines);
+	mNumFormattingJobLinesApplied = numFormattedLines;
+
+	if (isDone) {
+		// The information about multi-line constructs is updated after the start line has been formatted
+		for (std::size_t i = 0; i < numFormattedLines; i++) {
+			mFormattedLines.updateReformatInformation(mFormattingJobStartLineIndex + i, formattedLines[i]);
+		}
+
+		if (mNumFormattingJobSlices > 1) {
+			std::cout
+				<< "Formatting job (lines = " << numFormattedLines << ") in "
+				<< mNumFormattingJobSlices << " slices"
+				<< std::endl;
+		}
+
+		// Keep the job for the next edit, unless it holds on to the memory of a large region
+		if (numFormattedLines > MAX_KEPT_FORMATTING_JOB_LINES) {
+			mFormattingJob.reset();
+		}
 	}
+
+	return std::make_pair(startLineIndex, numAppliedLines);
+}
+
+std::pair<std::size_t, std::size_t> IncrementalFormattedText::takeEditFormattedLines() {
+	auto startLineIndex = std::min(mEditFormattedStartLineIndex, mFormattedLines.size());
+	auto endLineIndex = std::min(mEditFormattedEndLineIndex, mFormattedLines.size());
+	mEditFormattedStartLineIndex = 0;
+	mEditFormattedEndLineIndex = 0;
+	return std::make_pair(startLineIndex, endLineIndex - std::min(startLineIndex, endLineIndex));
 }
 
 void IncrementalFormattedText::reformatCharacterAction(const IncrementalFormattedText::InputState& inputState) {
@@ -139,27 +243,21 @@ void IncrementalFormattedText::insertCharacter(const InputState& inputState) {
 
 void IncrementalFormattedText::insertLine(const InputState& inputState) {
 	Timing timing("insertLine: ");
-	FormattedLine newFormattedLine;
-	mTextFormatter.formatLine(mFont, mRenderStyle, mViewPort, mText.getLine(inputState.lineIndex + 1), newFormattedLine);
-	mFormattedLines.insert(mFormattedLines.begin() + inputState.lineIndex + 1, newFormattedLine);
+	FormattedLines newFormattedLines(1);
+	mTextFormatter.formatLine(mFont, mRenderStyle, mText.getLine(inputState.lineIndex + 1), newFormattedLines[0]);
+	mFormattedLines.insert(inputState.lineIndex + 1, std::move(newFormattedLines));
+	shiftFormattingJob(inputState.lineIndex + 1, 1);
 	reformatLine(inputState.lineIndex);
 
-	for (std::size_t i = inputState.lineIndex; i < mFormattedLines.size(); i++) {
-		mFormattedLines[i].number = i;
-	}
-
 	mText.hasChanged(mTextVersion);
 }
 
 void IncrementalFormattedText::paste(const InputState& inputState, std::size_t numLines) {
 	Timing timing("paste: ");
 	if (numLines > 1) {
-		mFormattedLines.insert(mFormattedLines.begin() + inputState.lineIndex, numLines - 1, FormattedLine {});
+		mFormattedLines.insert(inputState.lineIndex, FormattedLines(numLines - 1));
+		shiftFormattingJob(inputState.lineIndex, (std::int64_t)numLines - 1);
 		reformatLines(inputState.lineIndex, inputState.lineIndex + numLines - 1);
-
-		for (std::size_t i = inputState.lineIndex; i < mFormattedLines.size(); i++) {
-			mFormattedLines[i].number = i;
-		}
 	} else {
 		reformatLine(inputState.lineIndex);
 	}
@@ -172,23 +270,17 @@ void IncrementalFormattedText::deleteLine(const InputState& inputState, Text::De
 	auto lineNumber = inputState.lineIndex;
 
 	if (mode == Text::DeleteLineMode::Start) {
-		mFormattedLines.erase(mFormattedLines.begin() + lineNumber);
+		mFormattedLines.erase(lineNumber, 1);
+		shiftFormattingJob(lineNumber, -1);
 
 		if (lineNumber > 0) {
 			reformatLine(lineNumber - 1);
 		}
-
-		for (std::size_t i = lineNumber - 1; i < mFormattedLines.size(); i++) {
-			mFormattedLines[i].number = i;
-		}
 	} else {
 		if (lineNumber + 1 < mFormattedLines.size()) {
-			mFormattedLines.erase(mFormattedLines.begin() + lineNumber + 1);
+			mFormattedLines.erase(lineNumber + 1, 1);
+			shiftFormattingJob(lineNumber + 1, -1);
 			reformatLine(lineNumber);
-
-			for (std::size_t i = lineNumber; i < mFormattedLines.size(); i++) {
-				mFormattedLines[i].number = i;
-			}
 		}
 	}
 
@@ -200,15 +292,13 @@ void IncrementalFormattedText::deleteSelection(const InputState& inputState, con
 	if (textSelection.startLine == textSelection.endLine) {
 		reformatLine(textSelection.startLine);
 	} else {
-		mFormattedLines.erase(
-			mFormattedLines.begin() + deleteData.startDeleteLineIndex,
-			mFormattedLines.begin() + deleteData.endDeleteLineIndex + 1);
+		auto numDeletedLines = deleteData.endDeleteLineIndex + 1 - deleteData.startDeleteLineIndex;
+		mFormattedLines.erase(deleteData.startDeleteLineIndex, numDeletedLines);
+		shiftFormattingJob(deleteData.startDeleteLineIndex, -(std::int64_t)numDeletedLines);
 
 		reformatLine(textSelection.startLine);
-		reformatLine(textSelection.startLine + 1);
-
-		for (std::size_t i = textSelection.startLine; i < mFormattedLines.size(); i++) {
-			mFormattedLines[i].number = i;
+		if (textSelection.startLine + 1 < mFormattedLines.size()) {
+			reformatLine(textSelection.startLine + 1);
 		}
 	}
 
@@ -1,11 +1,11 @@
 #pragma once
 
 #include "textformatter.h"
+#include "chunkedformattedlines.h"
 
 class Text;
 class Font;
 struct RenderStyle;
-struct RenderViewPort;
 
 /**
  * Represents an incremental formatted text
@@ -22,13 +22,25 @@ public:
 private:
 	const Font& mFont;
 	const RenderStyle& mRenderStyle;
-	const RenderViewPort& mViewPort;
 
 	TextFormatter& mTextFormatter;
 
 	Text& mText;
 	std::size_t& mTextVersion;
-	FormattedLines mFormattedLines;
+	// Evicted lines are restored when accessed
+	mutable ChunkedFormattedLines mFormattedLines;
+	std::size_t mWindowSize = 0;
+
+	static constexpr std::size_t MAX_KEPT_FORMATTING_JOB_LINES = 4096;
+
+	std::int64_t mFormattingBudget = 4000;
+	std::unique_ptr<FormattingJob> mFormattingJob;
+	std::size_t mFormattingJobStartLineIndex = 0;
+	std::size_t mFormattingJobEndLineIndex = 0;
+	std::size_t mNumFormattingJobLinesApplied = 0;
+	std::size_t mNumFormattingJobSlices = 0;
+	std::size_t mEditFormattedStartLineIndex = 0;
+	std::size_t mEditFormattedEndLineIndex = 0;
 
 	/**
 	 * Finds the reformat search region for the given line
@@ -49,6 +61,35 @@ private:
 	 */
 	void reformatLines(std::size_t startLineIndex, std::size_t endLineIndex);
 
+	/**
+	 * Formats the evicted lines around the given line
+	 * @param lineIndex The index of the line
+	 * @param formattedLines The formatted lines
+	 * @return The index of the first line
+	 */
+	std::size_t formatEvictedLines(std::size_t lineIndex, FormattedLines& formattedLines) const;
+
+	/**
+	 * Restores the formatting of the evicted lines around the given line
+	 * @param lineIndex The index of the line
+	 */
+	void restoreLines(std::size_t lineIndex) const;
+
+	/**
+	 * Starts a formatting job for the given lines and runs the first slice. If a job is already running, the job is
+	 * restarted to include its lines.
+	 * @param startLineIndex The index of the first line
+	 * @param endLineIndex The index of the last line
+	 */
+	void startFormattingJob(std::size_t startLineIndex, std::size_t endLineIndex);
+
+	/**
+	 * Moves the lines of the running formatting job after lines have been inserted or removed
+	 * @param lineIndex The index of the first line that moved
+	 * @param diff The number of lines inserted (positive) or removed (negative)
+	 */
+	void shiftFormattingJob(std::size_t lineIndex, std::int64_t diff);
+
 	/**
 	 * Reformats for a character action
 	 * @param inputState The input state
@@ -60,7 +101,6 @@ public:
 	 * @param font The font
 	 * @param textFormatter The text formatter
 	 * @param renderStyle The render style
-	 * @param viewPort The view port
 	 * @param text The text
 	 * @param textVersion The text version of the view
 	 * @param formatMode The format mode
@@ -68,7 +108,6 @@ public:
 	explicit IncrementalFormattedText(const Font& font,
 									  TextFormatter& textFormatter,
 									  const RenderStyle& renderStyle,
-									  const RenderViewPort& viewPort,
 									  Text& text,
 									  std::size_t& textVersion);
 
@@ -84,10 +123,57 @@ public:
 	virtual const FormattedLine& getLine(std::size_t index) const override;
 
 	/**
-	 * Creates a state machine
-	 * @param formattedLines The formatted lines
+	 * Returns the formatting for the given line when it is read once. Evicted lines are formatted into the buffer
+	 * without being restored, which keeps them evicted and keeps the versions of the lines that are shown.
+	 * @param index The index
+	 * @param buffer The buffer
+	 */
+	virtual const FormattedLine& readLine(std::size_t index, ReadLinesBuffer& buffer) const override;
+
+	/**
+	 * Returns the width of the given line
+	 * @param index The index
+	 */
+	virtual float getLineWidth(std::size_t index) const override;
+
+	/**
+	 * Sets the number of lines around the view and the caret that keeps their formatting. Outside of the window only
+	 * the state of each line is kept, and the formatting is restored when needed. Zero keeps all lines.
+	 * @param windowSize The number of lines on each side
+	 */
+	void setWindowSize(std::size_t windowSize);
+
+	/**
+	 * Evicts the formatting of lines outside the window
+	 * @param viewStartLineIndex The index of the first visible line
+	 * @param viewEndLineIndex The index of the last visible line
+	 * @param caretLineIndex The index of the line of the caret
+	 */
+	void updateWindow(std::size_t viewStartLineIndex, std::size_t viewEndLineIndex, std::size_t caretLineIndex);
+
+	/**
+	 * Sets the time budget for a slice of formatting
+	 * @param budgetMicroseconds The budget in microseconds
+	 */
+	void setFormattingBudget(std::int64_t budgetMicroseconds);
+
+	/**
+	 * Indicates if there is a formatting job that has not yet completed
+	 */
+	bool hasPendingFormatting() const;
+
+	/**
+	 * Runs a slice of the pending formatting job
+	 * @return The index of the first line formatted and the number of lines formatted
+	 */
+	std::pair<std::size_t, std::size_t> runFormattingJob();
+
+	/**
+	 * Returns the lines formatted by the first slice of the jobs started by edits since the last call. These can
+	 * extend beyond the edited lines, for example when a block comment is opened.
+	 * @return The index of the first line formatted and the number of lines formatted
 	 */
-	FormatterStateMachine createStateMachine(FormattedLines& formattedLines);
+	std::pair<std::size_t, std::size_t> takeEditFormattedLines();
 
 	/**
 	 * Inserts the given character
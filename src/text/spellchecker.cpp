@@ -0,0 +1,315 @@
+#include "spellchecker.h"
+#include "../helpers.h"
+#include "../external/bloom_filter.hpp"
+#include "../external/tsl/array_set.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+	Char toLower(Char character) {
+		if ((character >= 'A' && character <= 'Z') || (character >= 0xC0 && character <= 0xDE && character != 0xD7)) {
+			return character + 0x20;
+		}
+
+		return character;
+	}
+
+	// The letters of the Latin script, which are the letters of the word list
+	bool isLetter(Char character) {
+		return (character >= 'a' && character <= 'z')
+			   || (character >= 'A' && character <= 'Z')
+			   || (character >= 0xC0 && character <= 0x24F && character != 0xD7 && character != 0xF7)
+			   || (character >= 0x1E00 && character <= 0x1EFF);
+	}
+
+	// The letters and combining marks of other scripts. Words with these are skipped rather than checked against a word
+	// list of Latin words. Punctuation and symbol blocks, such as General Punctuation, are not included.
+	bool isOtherScriptLetter(Char character) {
+		return (character >= 0x300 && character < 0x1E00)
+			   || (character >= 0x1F00 && character < 0x2000)
+			   || (character >= 0x2C00 && character < 0x2E00)
+			   || (character >= 0x3040 && character < 0xD800)
+			   || (character >= 0xF900 && character < 0xFE00)
+			   || (character >= 0xFE70 && character < 0xFF00)
+			   || (character >= 0xFF21 && character <= 0xFFDC);
+	}
+
+	bool isWordCharacter(Char character) {
+		return isLetter(character) || isOtherScriptLetter(character);
+	}
+
+	bool isApostrophe(Char character) {
+		return character == '\'' || character == 0x2019;
+	}
+
+	// Words next to these characters are part of identifiers, numbers or paths rather than prose
+	bool isWordJoiner(Char character) {
+		return (character >= '0' && character <= '9')
+			   || character == '_'
+			   || character == '/'
+			   || character == '\\'
+			   || character == '@';
+	}
+
+	/**
+	 * The words of the word list
+	 */
+	class Dictionary {
+	private:
+		bloom_filter mFilter;
+		tsl::array_set<Char> mWords;
+
+		static const unsigned char* bytes(const String& word) {
+			return reinterpret_cast<const unsigned char*>(word.data());
+		}
+	public:
+		/**
+		 * Creates a dictionary with the given words, which are in lower case
+		 * @param words The words
+		 */
+		explicit Dictionary(const std::vector<String>& words) {
+			bloom_parameters parameters;
+			parameters.projected_element_count = std::max(words.size(), (std::size_t)1);
+			parameters.false_positive_probability = 0.01;
+			parameters.compute_optimal_parameters();
+			mFilter = bloom_filter(parameters);
+
+			mWords.reserve(words.size());
+			for (auto& word : words) {
+				mFilter.insert(bytes(word), word.size() * sizeof(Char));
+				mWords.insert(word);
+			}
+		}
+
+		/**
+		 * Returns the number of words
+		 */
+		std::size_t size() const {
+			return mWords.size();
+		}
+
+		/**
+		 * Indicates if the given word, which is in lower case, is in the dictionary
+		 * @param word The word
+		 */
+		bool contains(const String& word) const {
+			return mFilter.contains(bytes(word), word.size() * sizeof(Char)) && mWords.count(word) > 0;
+		}
+	};
+
+	/**
+	 * Finds the misspelled words of the given line
+	 * @param dictionary The dictionary
+	 * @param line The line
+	 * @param word Buffer for the current word
+	 * @param check Called with the start and length of each misspelled word
+	 */
+	template<typename T>
+	void checkLine(const Dictionary& dictionary, const String& line, String& word, T check) {
+		std::size_t charIndex = 0;
+		while (charIndex < line.size()) {
+			if (!isWordCharacter(line[charIndex])) {
+				charIndex++;
+				continue;
+			}
+
+			auto start = charIndex;
+			auto end = charIndex;
+			auto hasInnerUpperCase = false;
+			auto hasOtherScript = false;
+			while (end < line.size()
+				   && (isWordCharacter(line[end])
+					   || (isApostrophe(line[end]) && end + 1 < line.size() && isWordCharacter(line[end + 1])))) {
+				if (end > start && toLower(line[end]) != line[end]) {
+					hasInnerUpperCase = true;
+				}
+
+				hasOtherScript |= isOtherScriptLetter(line[end]);
+				end++;
+			}
+
+			charIndex = end;
+
+			// Single letters, acronyms, camel case, words within identifiers and words in other scripts are not checked
+			auto isJoined = (start > 0 && isWordJoiner(line[start - 1])) || (end < line.size() && isWordJoiner(line[end]));
+			if (end - start < 2 || hasInnerUpperCase || isJoined || hasOtherScript) {
+				continue;
+			}
+
+			word.clear();
+			for (auto i = start; i < end; i++) {
+				word += isApostrophe(line[i]) ? '\'' : toLower(line[i]);
+			}
+
+			if (!dictionary.contains(word)) {
+				check(start, end - start);
+			}
+		}
+	}
+}
+
+SpellChecker::SpellChecker(const std::string& dictionaryFileName, std::function<void ()> resultsAvailable)
+	: mResultsAvailable(std::move(resultsAvailable)),
+	  mThread(&SpellChecker::run, this, dictionaryFileName) {
+
+}
+
+SpellChecker::~SpellChecker() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+
+	mRequestAdded.notify_one();
+	mThread.join();
+}
+
+void SpellChecker::run(std::string dictionaryFileName) {
+	auto t0 = Helpers::timeNow();
+	std::vector<String> words;
+	try {
+		auto content = Helpers::readFileAsUTF16Text(dictionaryFileName);
+		std::size_t lineStart = 0;
+		while (lineStart < content.size() && !mStop) {
+			auto lineEnd = content.find('\n', lineStart);
+			if (lineEnd == String::npos) {
+				lineEnd = content.size();
+			}
+
+			String word;
+			for (auto i = lineStart; i < lineEnd; i++) {
+				if (content[i] != '\r') {
+					word += isApostrophe(content[i]) ? '\'' : toLower(content[i]);
+				}
+			}
+
+			if (!word.empty()) {
+				words.push_back(std::move(word));
+			}
+
+			lineStart = lineEnd + 1;
+		}
+	} catch (const std::exception& e) {
+		std::cout << "Spell checking disabled: " << e.what() << std::endl;
+		return;
+	}
+
+	Dictionary dictionary(words);
+	words = {};
+	mIsLoaded = true;
+
+	std::cout
+		<< "Loaded dictionary (words = " << dictionary.size() << ") in "
+		<< (Helpers::durationMicroseconds(Helpers::timeNow(), t0) / 1E3) << " ms"
+		<< std::endl;
+
+	String word;
+	std::vector<WordRange> misspelledWords;
+	while (true) {
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mRequestAdded.wait(lock, [&]() { return mStop || !mRequests.empty(); });
+			if (mStop) {
+				return;
+			}
+
+			request = std::move(mRequests.front());
+			mRequests.pop_front();
+		}
+
+		misspelledWords.clear();
+		checkLine(dictionary, request.line, word, [&](std::size_t charIndex, std::size_t length) {
+			misspelledWords.push_back({ (std::uint32_t)charIndex, (std::uint32_t)length });
+		});
+
+		bool isDone;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mCheckedLines.size() >= MAX_CHECKED_LINES) {
+				// Lines that are still needed are requested again
+				mCheckedLines.clear();
+			}
+
+			mCheckedLines[request.lineVersion] = misspelledWords;
+			mPendingVersions.erase(request.lineVersion);
+			isDone = mRequests.empty();
+		}
+
+		// The results are announced once per batch of requests rather than for each line
+		mHasNewResults = true;
+		if (isDone && mResultsAvailable) {
+			mResultsAvailable();
+		}
+	}
+}
+
+bool SpellChecker::isLoaded() const {
+	return mIsLoaded;
+}
+
+bool SpellChecker::hasNewResults() {
+	return mHasNewResults.exchange(false);
+}
+
+void SpellChecker::findMisspellings(const Text& text,
+									std::size_t startLineIndex,
+									std::size_t endLineIndex,
+									std::vector<Misspelling>& misspellings) {
+	misspellings.clear();
+	if (!mIsLoaded) {
+		return;
+	}
+
+	if (startLineIndex >= text.numLines()) {
+		return;
+	}
+
+	endLineIndex = std::min(endLineIndex, text.numLines() - 1);
+	mMissingLines.clear();
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (auto lineIndex = startLineIndex; lineIndex <= endLineIndex; lineIndex++) {
+			auto lineVersion = text.lineVersion(lineIndex);
+			auto checkedLine = mCheckedLines.find(lineVersion);
+			if (checkedLine == mCheckedLines.end()) {
+				if (mPendingVersions.count(lineVersion) == 0) {
+					mMissingLines.push_back(lineIndex);
+				}
+
+				continue;
+			}
+
+			for (auto& misspelledWord : checkedLine->second) {
+				misspellings.push_back({ lineIndex, misspelledWord.charIndex, misspelledWord.length });
+			}
+		}
+	}
+
+	if (mMissingLines.empty()) {
+		return;
+	}
+
+	// The lines are copied outside the lock, as the background thread does not access the text
+	std::vector<Request> requests;
+	requests.reserve(mMissingLines.size());
+	for (auto lineIndex : mMissingLines) {
+		requests.push_back({ text.lineVersion(lineIndex), text.getLine(lineIndex) });
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (auto request = requests.rbegin(); request != requests.rend(); ++request) {
+			mPendingVersions.insert(request->lineVersion);
+			mRequests.push_front(std::move(*request));
+		}
+
+		while (mRequests.size() > MAX_QUEUED_LINES) {
+			mPendingVersions.erase(mRequests.back().lineVersion);
+			mRequests.pop_back();
+		}
+	}
+
+	mRequestAdded.notify_one();
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "text.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Represents a misspelled word in the text
+ */
+struct Misspelling {
+	std::size_t lineIndex = 0;
+	std::size_t charIndex = 0;
+	std::size_t length = 0;
+};
+
+/**
+ * Checks the spelling of the words of a text against a word list. The word list is loaded into a Bloom filter, which
+ * rejects most misspelled words directly, backed by an exact set for the words that pass the filter.
+ *
+ * Lines are checked on a background thread. A line is requested when it is looked up and has not been checked, and the
+ * result is stored by the version of the line, which means that it stays valid when other lines are edited. The most
+ * recent requests are checked first, which are the visible and the recently edited lines.
+ */
+class SpellChecker {
+private:
+	static constexpr std::size_t MAX_QUEUED_LINES = 256;
+	static constexpr std::size_t MAX_CHECKED_LINES = 16384;
+
+	/**
+	 * A line to check
+	 */
+	struct Request {
+		std::size_t lineVersion;
+		String line;
+	};
+
+	/**
+	 * A misspelled word on a line
+	 */
+	struct WordRange {
+		std::uint32_t charIndex;
+		std::uint32_t length;
+	};
+
+	std::atomic<bool> mIsLoaded { false };
+	std::atomic<bool> mStop { false };
+	std::atomic<bool> mHasNewResults { false };
+	std::function<void ()> mResultsAvailable;
+
+	// Shared with the background thread
+	std::mutex mMutex;
+	std::condition_variable mRequestAdded;
+	std::deque<Request> mRequests;
+	std::unordered_map<std::size_t, std::vector<WordRange>> mCheckedLines;
+	std::unordered_set<std::size_t> mPendingVersions;
+
+	// Only used by the calling thread
+	std::vector<std::size_t> mMissingLines;
+
+	std::thread mThread;
+
+	/**
+	 * Loads the word list and checks the requested lines until stopped
+	 * @param dictionaryFileName The name of the word list file
+	 */
+	void run(std::string dictionaryFileName);
+public:
+	/**
+	 * Creates a new spell checker, where the word list is loaded on the background thread
+	 * @param dictionaryFileName The name of the word list file, which has one word per line
+	 * @param resultsAvailable Called on the background thread when it has checked all requested lines
+	 */
+	explicit SpellChecker(const std::string& dictionaryFileName, std::function<void ()> resultsAvailable = {});
+	~SpellChecker();
+
+	SpellChecker(const SpellChecker&) = delete;
+	SpellChecker& operator=(const SpellChecker&) = delete;
+
+	/**
+	 * Indicates if the word list has been loaded
+	 */
+	bool isLoaded() const;
+
+	/**
+	 * Indicates if lines have been checked since the last call
+	 */
+	bool hasNewResults();
+
+	/**
+	 * Finds the misspelled words of the given lines. Lines that have not been checked are requested from the background
+	 * thread, and their misspellings are found by a later call.
+	 * @param text The text
+	 * @param startLineIndex The index of the first line
+	 * @param endLineIndex The index of the last line
+	 * @param misspellings The misspelled words, ordered by position
+	 */
+	void findMisspellings(const Text& text,
+						  std::size_t startLineIndex,
+						  std::size_t endLineIndex,
+						  std::vector<Misspelling>& misspellings);
+};
\ No newline at end of file
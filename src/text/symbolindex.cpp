@@ -0,0 +1,551 @@
+#include "symbolindex.h"
+#include "helpers.h"
+#include "../helpers.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+	// Keywords that are followed by an expression rather than by the name of a declaration
+	const KeywordList NON_DECLARATION_KEYWORDS({
+		"if",
+		"elif",
+		"else",
+		"while",
+		"for",
+		"in",
+		"is",
+		"not",
+		"and",
+		"or",
+		"case",
+		"switch",
+		"return",
+		"yield",
+		"await",
+		"assert",
+		"raise",
+		"throw",
+		"new",
+		"delete",
+		"del",
+		"print",
+		"import",
+		"from",
+		"as",
+		"with",
+		"#include",
+		"#if",
+		"#ifdef",
+		"#ifndef"
+	});
+
+	bool isWhitespace(Char character) {
+		return character == ' ' || character == '\t';
+	}
+}
+
+bool SymbolIndex::isIdentifierCharacter(Char character) {
+	return (character >= 'a' && character <= 'z')
+		   || (character >= 'A' && character <= 'Z')
+		   || (character >= '0' && character <= '9')
+		   || character == '_'
+		   || character >= 0x80;
+}
+
+std::size_t SymbolIndex::Chunk::size() const {
+	return lineEnds.size();
+}
+
+std::size_t SymbolIndex::Chunk::lineStart(std::size_t lineIndex) const {
+	return lineIndex > 0 ? lineEnds[lineIndex - 1] : 0;
+}
+
+void SymbolIndex::Chunk::addLine(const std::vector<Occurrence>& lineOccurrences) {
+	occurrences.insert(occurrences.end(), lineOccurrences.begin(), lineOccurrences.end());
+	lineEnds.push_back((std::uint32_t)occurrences.size());
+
+	for (auto& occurrence : lineOccurrences) {
+		symbolCounts[occurrence.symbol]++;
+	}
+}
+
+void SymbolIndex::Chunk::replaceLine(std::size_t lineIndex, const std::vector<Occurrence>& lineOccurrences) {
+	auto start = lineStart(lineIndex);
+	auto end = (std::size_t)lineEnds[lineIndex];
+	for (auto i = start; i < end; i++) {
+		auto count = symbolCounts.find(occurrences[i].symbol);
+		if (--count->second == 0) {
+			symbolCounts.erase(count);
+		}
+	}
+
+	occurrences.erase(occurrences.begin() + start, occurrences.begin() + end);
+	occurrences.insert(occurrences.begin() + start, lineOccurrences.begin(), lineOccurrences.end());
+
+	auto diff = (std::int64_t)lineOccurrences.size() - (std::int64_t)(end - start);
+	for (auto i = lineIndex; i < lineEnds.size(); i++) {
+		lineEnds[i] = (std::uint32_t)((std::int64_t)lineEnds[i] + diff);
+	}
+
+	for (auto& occurrence : lineOccurrences) {
+		symbolCounts[occurrence.symbol]++;
+	}
+}
+
+SymbolIndex::Chunk SymbolIndex::Chunk::split(std::size_t lineIndex) {
+	Chunk chunk;
+	auto start = lineStart(lineIndex);
+
+	chunk.occurrences.assign(occurrences.begin() + start, occurrences.end());
+	for (auto i = lineIndex; i < lineEnds.size(); i++) {
+		chunk.lineEnds.push_back(lineEnds[i] - (std::uint32_t)start);
+	}
+
+	for (auto& occurrence : chunk.occurrences) {
+		chunk.symbolCounts[occurrence.symbol]++;
+
+		auto count = symbolCounts.find(occurrence.symbol);
+		if (--count->second == 0) {
+			symbolCounts.erase(count);
+		}
+	}
+
+	occurrences.resize(start);
+	lineEnds.resize(lineIndex);
+	return chunk;
+}
+
+void SymbolIndex::Chunk::append(const Chunk& chunk) {
+	auto offset = (std::uint32_t)occurrences.size();
+	occurrences.insert(occurrences.end(), chunk.occurrences.begin(), chunk.occurrences.end());
+	for (auto lineEnd : chunk.lineEnds) {
+		lineEnds.push_back(lineEnd + offset);
+	}
+
+	for (auto& count : chunk.symbolCounts) {
+		symbolCounts[count.first] += count.second;
+	}
+}
+
+SymbolIndex::SymbolId SymbolIndex::intern(const Char* name, std::size_t length) {
+	auto symbol = mSymbolIds.insert_ks(name, length, (SymbolId)mSymbolNames.size());
+	if (symbol.second) {
+		mSymbolNames.emplace_back(name, length);
+		mSymbolCounts.push_back(0);
+	}
+
+	return symbol.first.value();
+}
+
+void SymbolIndex::findLineOccurrences(const FormattedLine& line, std::vector<Occurrence>& occurrences) {
+	occurrences.clear();
+
+	std::size_t charIndex = 0;
+	bool afterDeclarationKeyword = false;
+	for (auto& token : line.tokens) {
+		auto& text = token.text;
+		if (token.type == TokenType::Keyword) {
+			afterDeclarationKeyword = !NON_DECLARATION_KEYWORDS.isKeyword(text);
+		} else if (token.type == TokenType::Text) {
+			for (std::size_t i = 0; i < text.size();) {
+				if (isWhitespace(text[i])) {
+					i++;
+					continue;
+				}
+
+				if (!isIdentifierCharacter(text[i])) {
+					afterDeclarationKeyword = false;
+					i++;
+					continue;
+				}
+
+				auto start = i;
+				while (i < text.size() && isIdentifierCharacter(text[i])) {
+					i++;
+				}
+
+				// Numbers are usually separate tokens, but suffixes such as in "1.5f" can end up in text tokens
+				if (!(text[start] >= '0' && text[start] <= '9')) {
+					Occurrence occurrence;
+					occurrence.symbol = intern(text.data() + start, i - start);
+					occurrence.charIndex = (std::uint32_t)(charIndex + start);
+					occurrence.isDeclaration = afterDeclarationKeyword;
+					occurrences.push_back(occurrence);
+				}
+
+				afterDeclarationKeyword = false;
+			}
+		} else if (!text.empty()) {
+			afterDeclarationKeyword = false;
+		}
+
+		charIndex += text.size();
+	}
+}
+
+void SymbolIndex::updateSymbolCounts(const std::vector<Occurrence>& occurrences,
+									 std::size_t begin,
+									 std::size_t end,
+									 bool added) {
+	for (auto i = begin; i < end; i++) {
+		if (added) {
+			mSymbolCounts[occurrences[i].symbol]++;
+		} else {
+			mSymbolCounts[occurrences[i].symbol]--;
+		}
+	}
+}
+
+void SymbolIndex::updateSortedSymbols() const {
+	auto numSorted = mSortedSymbols.size();
+	if (numSorted == mSymbolNames.size()) {
+		return;
+	}
+
+	auto compareNames = [&](SymbolId x, SymbolId y) {
+		return mSymbolNames[x] < mSymbolNames[y];
+	};
+
+	for (auto symbol = (SymbolId)numSorted; symbol < mSymbolNames.size(); symbol++) {
+		mSortedSymbols.push_back(symbol);
+	}
+
+	auto middle = mSortedSymbols.begin() + (std::ptrdiff_t)numSorted;
+	std::sort(middle, mSortedSymbols.end(), compareNames);
+	std::inplace_merge(mSortedSymbols.begin(), middle, mSortedSymbols.end(), compareNames);
+}
+
+void SymbolIndex::invalidateFrom(std::size_t chunkIndex) {
+	mFirstInvalidChunk = std::min(mFirstInvalidChunk, chunkIndex);
+}
+
+void SymbolIndex::updateChunkStarts() const {
+	if (mFirstInvalidChunk >= mChunks.size() && mChunkStarts.size() == mChunks.size()) {
+		return;
+	}
+
+	mFirstInvalidChunk = std::min(mFirstInvalidChunk, mChunkStarts.size());
+	mChunkStarts.resize(mChunks.size());
+	auto start = mFirstInvalidChunk > 0 ? mChunkStarts[mFirstInvalidChunk - 1] + mChunks[mFirstInvalidChunk - 1].size() : 0;
+	for (auto i = mFirstInvalidChunk; i < mChunks.size(); i++) {
+		mChunkStarts[i] = start;
+		start += mChunks[i].size();
+	}
+
+	mFirstInvalidChunk = mChunks.size();
+}
+
+std::pair<std::size_t, std::size_t> SymbolIndex::findChunk(std::size_t lineIndex) const {
+	updateChunkStarts();
+	auto chunkIterator = std::upper_bound(mChunkStarts.begin(), mChunkStarts.end(), lineIndex);
+	auto chunkIndex = (std::size_t)std::distance(mChunkStarts.begin(), chunkIterator) - 1;
+	return std::make_pair(chunkIndex, lineIndex - mChunkStarts[chunkIndex]);
+}
+
+std::size_t SymbolIndex::splitAt(std::size_t lineIndex) {
+	if (lineIndex >= mNumLines) {
+		return mChunks.size();
+	}
+
+	auto location = findChunk(lineIndex);
+	if (location.second == 0) {
+		return location.first;
+	}
+
+	auto chunk = mChunks[location.first].split(location.second);
+	mChunks.insert(mChunks.begin() + (std::ptrdiff_t)location.first + 1, std::move(chunk));
+	invalidateFrom(location.first);
+	return location.first + 1;
+}
+
+void SymbolIndex::mergeWithNext(std::size_t chunkIndex) {
+	if (chunkIndex + 1 >= mChunks.size() || mChunks[chunkIndex].size() + mChunks[chunkIndex + 1].size() > MAX_CHUNK_SIZE) {
+		return;
+	}
+
+	mChunks[chunkIndex].append(mChunks[chunkIndex + 1]);
+	mChunks.erase(mChunks.begin() + (std::ptrdiff_t)chunkIndex + 1);
+	invalidateFrom(chunkIndex);
+}
+
+void SymbolIndex::eraseLines(std::size_t lineIndex, std::size_t count) {
+	if (count == 0) {
+		return;
+	}
+
+	auto startChunkIndex = splitAt(lineIndex);
+	auto endChunkIndex = splitAt(lineIndex + count);
+	for (auto chunkIndex = startChunkIndex; chunkIndex < endChunkIndex; chunkIndex++) {
+		for (auto& count : mChunks[chunkIndex].symbolCounts) {
+			mSymbolCounts[count.first] -= count.second;
+		}
+	}
+
+	mChunks.erase(
+		mChunks.begin() + (std::ptrdiff_t)startChunkIndex,
+		mChunks.begin() + (std::ptrdiff_t)endChunkIndex);
+	mNumLines -= count;
+	invalidateFrom(startChunkIndex);
+
+	if (startChunkIndex > 0) {
+		mergeWithNext(startChunkIndex - 1);
+	}
+}
+
+void SymbolIndex::insertLines(const BaseFormattedText& text, std::size_t lineIndex, std::size_t count) {
+	if (count == 0) {
+		return;
+	}
+
+	std::vector<Chunk> chunks;
+	ReadLinesBuffer readLines;
+	for (auto i = lineIndex; i < lineIndex + count; i++) {
+		if (chunks.empty() || chunks.back().size() >= MAX_CHUNK_SIZE) {
+			chunks.emplace_back();
+		}
+
+		findLineOccurrences(text.readLine(i, readLines), mLineOccurrences);
+		updateSymbolCounts(mLineOccurrences, 0, mLineOccurrences.size(), true);
+		chunks.back().addLine(mLineOccurrences);
+	}
+
+	auto chunkIndex = splitAt(lineIndex);
+	mChunks.insert(
+		mChunks.begin() + (std::ptrdiff_t)chunkIndex,
+		std::make_move_iterator(chunks.begin()),
+		std::make_move_iterator(chunks.end()));
+	mNumLines += count;
+	invalidateFrom(chunkIndex);
+
+	// Merge the last inserted chunk first, as merging the first one moves the chunks after it
+	mergeWithNext(chunkIndex + chunks.size() - 1);
+	if (chunkIndex > 0) {
+		mergeWithNext(chunkIndex - 1);
+	}
+}
+
+void SymbolIndex::clear() {
+	mChunks.clear();
+	mNumLines = 0;
+	mChunkStarts.clear();
+	mFirstInvalidChunk = 0;
+	std::fill(mSymbolCounts.begin(), mSymbolCounts.end(), 0);
+}
+
+void SymbolIndex::assign(const BaseFormattedText& text) {
+	clear();
+	build(text, -1);
+}
+
+bool SymbolIndex::build(const BaseFormattedText& text, std::int64_t budgetMicroseconds) {
+	auto startTime = Helpers::timeNow();
+
+	// The lines are read without keeping the formatting of lines that are formatted when accessed
+	ReadLinesBuffer readLines;
+	while (mNumLines < text.numLines()) {
+		if (mChunks.empty() || mChunks.back().size() >= MAX_CHUNK_SIZE) {
+			// Checking the time for each chunk keeps the overhead low
+			if (budgetMicroseconds >= 0 && Helpers::durationMicroseconds(Helpers::timeNow(), startTime) >= budgetMicroseconds) {
+				return false;
+			}
+
+			mChunks.emplace_back();
+		}
+
+		findLineOccurrences(text.readLine(mNumLines, readLines), mLineOccurrences);
+		updateSymbolCounts(mLineOccurrences, 0, mLineOccurrences.size(), true);
+		mChunks.back().addLine(mLineOccurrences);
+		mNumLines++;
+	}
+
+	return true;
+}
+
+void SymbolIndex::replaceLines(const BaseFormattedText& text,
+							   std::size_t lineIndex,
+							   std::size_t numOldLines,
+							   std::size_t numNewLines) {
+	if (lineIndex >= mNumLines) {
+		return;
+	}
+
+	if (lineIndex + numOldLines > mNumLines) {
+		// The change reaches past the indexed lines, so the lines from the change are indexed by the build
+		eraseLines(lineIndex, mNumLines - lineIndex);
+		return;
+	}
+
+	if (numOldLines == numNewLines) {
+		ReadLinesBuffer readLines;
+		for (auto i = lineIndex; i < lineIndex + numNewLines; i++) {
+			auto location = findChunk(i);
+			auto& chunk = mChunks[location.first];
+			updateSymbolCounts(chunk.occurrences, chunk.lineStart(location.second), chunk.lineEnds[location.second], false);
+
+			findLineOccurrences(text.readLine(i, readLines), mLineOccurrences);
+			updateSymbolCounts(mLineOccurrences, 0, mLineOccurrences.size(), true);
+			chunk.replaceLine(location.second, mLineOccurrences);
+		}
+	} else {
+		eraseLines(lineIndex, numOldLines);
+		insertLines(text, lineIndex, numNewLines);
+	}
+
+	if (mNumLines > text.numLines()) {
+		// The index does not match the text before the change, so it is indexed from scratch
+		clear();
+	}
+}
+
+std::size_t SymbolIndex::numLines() const {
+	return mNumLines;
+}
+
+std::size_t SymbolIndex::numSymbols() const {
+	return mSymbolNames.size();
+}
+
+const String& SymbolIndex::symbolName(SymbolId symbol) const {
+	return mSymbolNames.at(symbol);
+}
+
+std::size_t SymbolIndex::symbolCount(SymbolId symbol) const {
+	return mSymbolCounts.at(symbol);
+}
+
+void SymbolIndex::findSymbolsWithPrefix(const String& prefix,
+										std::size_t maxSymbols,
+										std::vector<SymbolId>& symbols) const {
+	symbols.clear();
+	updateSortedSymbols();
+
+	auto first = std::lower_bound(
+		mSortedSymbols.begin(),
+		mSortedSymbols.end(),
+		prefix,
+		[&](SymbolId symbol, const String& prefix) { return mSymbolNames[symbol] < prefix; });
+
+	for (auto current = first; current != mSortedSymbols.end(); ++current) {
+		auto& name = mSymbolNames[*current];
+		if (name.compare(0, prefix.size(), prefix) != 0) {
+			break;
+		}
+
+		// Identifiers that no longer occur in the text are kept interned, but are not offered
+		if (mSymbolCounts[*current] > 0) {
+			symbols.push_back(*current);
+		}
+	}
+
+	auto numSymbols = std::min(maxSymbols, symbols.size());
+	std::partial_sort(
+		symbols.begin(),
+		symbols.begin() + (std::ptrdiff_t)numSymbols,
+		symbols.end(),
+		[&](SymbolId x, SymbolId y) {
+			if (mSymbolCounts[x] != mSymbolCounts[y]) {
+				return mSymbolCounts[x] > mSymbolCounts[y];
+			}
+
+			return mSymbolNames[x] < mSymbolNames[y];
+		});
+	symbols.resize(numSymbols);
+}
+
+SymbolIndex::SymbolId SymbolIndex::findSymbolAt(const SymbolPosition& position, SymbolPosition& start) const {
+	if (position.lineIndex >= mNumLines) {
+		return NO_SYMBOL;
+	}
+
+	auto location = findChunk(position.lineIndex);
+	auto& chunk = mChunks[location.first];
+
+	// An identifier that contains the position is preferred over one that ends at it
+	auto symbol = NO_SYMBOL;
+	for (auto i = chunk.lineStart(location.second); i < chunk.lineEnds[location.second]; i++) {
+		auto& occurrence = chunk.occurrences[i];
+		auto occurrenceStart = (std::size_t)occurrence.charIndex;
+		auto occurrenceEnd = occurrenceStart + mSymbolNames[occurrence.symbol].size();
+		if (position.charIndex < occurrenceStart) {
+			break;
+		}
+
+		if (position.charIndex <= occurrenceEnd) {
+			start = { position.lineIndex, occurrenceStart };
+			symbol = occurrence.symbol;
+			if (position.charIndex < occurrenceEnd) {
+				break;
+			}
+		}
+	}
+
+	return symbol;
+}
+
+void SymbolIndex::findOccurrences(SymbolId symbol,
+								  std::size_t startLineIndex,
+								  std::size_t endLineIndex,
+								  std::vector<SymbolPosition>& positions) const {
+	positions.clear();
+	if (mNumLines == 0 || startLineIndex >= mNumLines) {
+		return;
+	}
+
+	endLineIndex = std::min(endLineIndex, mNumLines - 1);
+	auto location = findChunk(startLineIndex);
+	for (auto chunkIndex = location.first; chunkIndex < mChunks.size(); chunkIndex++) {
+		auto chunkStart = mChunkStarts[chunkIndex];
+		if (chunkStart > endLineIndex) {
+			break;
+		}
+
+		auto& chunk = mChunks[chunkIndex];
+		if (chunk.symbolCounts.count(symbol) == 0) {
+			continue;
+		}
+
+		auto firstLineIndex = std::max(startLineIndex, chunkStart) - chunkStart;
+		auto lastLineIndex = std::min(endLineIndex, chunkStart + chunk.size() - 1) - chunkStart;
+		for (auto lineIndex = firstLineIndex; lineIndex <= lastLineIndex; lineIndex++) {
+			for (auto i = chunk.lineStart(lineIndex); i < chunk.lineEnds[lineIndex]; i++) {
+				if (chunk.occurrences[i].symbol == symbol) {
+					positions.push_back({ chunkStart + lineIndex, chunk.occurrences[i].charIndex });
+				}
+			}
+		}
+	}
+}
+
+bool SymbolIndex::findDefinition(SymbolId symbol, SymbolPosition& position) const {
+	updateChunkStarts();
+
+	bool found = false;
+	for (std::size_t chunkIndex = 0; chunkIndex < mChunks.size(); chunkIndex++) {
+		auto& chunk = mChunks[chunkIndex];
+		if (chunk.symbolCounts.count(symbol) == 0) {
+			continue;
+		}
+
+		for (std::size_t lineIndex = 0; lineIndex < chunk.size(); lineIndex++) {
+			for (auto i = chunk.lineStart(lineIndex); i < chunk.lineEnds[lineIndex]; i++) {
+				auto& occurrence = chunk.occurrences[i];
+				if (occurrence.symbol != symbol) {
+					continue;
+				}
+
+				if (occurrence.isDeclaration) {
+					position = { mChunkStarts[chunkIndex] + lineIndex, occurrence.charIndex };
+					return true;
+				}
+
+				if (!found) {
+					position = { mChunkStarts[chunkIndex] + lineIndex, occurrence.charIndex };
+					found = true;
+				}
+			}
+		}
+	}
+
+	return found;
+}
@@ -0,0 +1,276 @@
+#pragma once
+#include "formattedtext.h"
+#include "../external/tsl/array_map.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Represents the position of a symbol in the text
+ */
+struct SymbolPosition {
+	std::size_t lineIndex = 0;
+	std::size_t charIndex = 0;
+};
+
+/**
+ * Indexes the identifiers of a formatted text, which allows finding all occurrences of an identifier and its likely
+ * definition. Identifiers are taken from the text tokens of the formatted lines, which means that keywords, numbers,
+ * strings and comments are ignored. Each identifier is interned, and the lines store the ids of their identifiers.
+ *
+ * The lines are stored in chunks of bounded size, where each chunk counts the identifiers that it contains. A search
+ * for an identifier skips the chunks that do not contain it, and an edit only updates the chunks of the edited lines.
+ *
+ * The index can be built a slice at a time, in which case the lines after the indexed lines are indexed later.
+ *
+ * The number of occurrences of each identifier is kept for the whole text, and the identifiers are kept sorted by name
+ * for prefix searches. New identifiers are sorted into the array when searched, which avoids moving the array for each
+ * identifier while indexing.
+ */
+class SymbolIndex {
+public:
+	using SymbolId = std::uint32_t;
+	static constexpr SymbolId NO_SYMBOL = (SymbolId)-1;
+private:
+	static constexpr std::size_t MAX_CHUNK_SIZE = 512;
+
+	/**
+	 * An identifier on a line
+	 */
+	struct Occurrence {
+		SymbolId symbol;
+		std::uint32_t charIndex : 31;
+		std::uint32_t isDeclaration : 1;
+	};
+
+	/**
+	 * A chunk of lines
+	 */
+	struct Chunk {
+		std::vector<Occurrence> occurrences;
+		std::vector<std::uint32_t> lineEnds;
+		std::unordered_map<SymbolId, std::uint32_t> symbolCounts;
+
+		/**
+		 * Returns the number of lines in the chunk
+		 */
+		std::size_t size() const;
+
+		/**
+		 * Returns the index of the first occurrence of the given line
+		 * @param lineIndex The index of the line within the chunk
+		 */
+		std::size_t lineStart(std::size_t lineIndex) const;
+
+		/**
+		 * Appends a line
+		 * @param occurrences The occurrences of the line
+		 */
+		void addLine(const std::vector<Occurrence>& occurrences);
+
+		/**
+		 * Replaces the occurrences of the given line
+		 * @param lineIndex The index of the line within the chunk
+		 * @param occurrences The occurrences of the line
+		 */
+		void replaceLine(std::size_t lineIndex, const std::vector<Occurrence>& occurrences);
+
+		/**
+		 * Moves the lines starting at the given line to a new chunk
+		 * @param lineIndex The index of the first line to move
+		 */
+		Chunk split(std::size_t lineIndex);
+
+		/**
+		 * Appends the lines of the given chunk
+		 * @param chunk The chunk
+		 */
+		void append(const Chunk& chunk);
+	};
+
+	tsl::array_map<Char, SymbolId> mSymbolIds;
+	std::vector<String> mSymbolNames;
+	std::vector<std::uint32_t> mSymbolCounts;
+
+	mutable std::vector<SymbolId> mSortedSymbols;
+
+	std::vector<Chunk> mChunks;
+	std::size_t mNumLines = 0;
+
+	mutable std::vector<std::size_t> mChunkStarts;
+	mutable std::size_t mFirstInvalidChunk = 0;
+
+	std::vector<Occurrence> mLineOccurrences;
+
+	/**
+	 * Returns the id of the given identifier, which is interned if new
+	 * @param name The identifier
+	 * @param length The length of the identifier
+	 */
+	SymbolId intern(const Char* name, std::size_t length);
+
+	/**
+	 * Finds the identifiers of the given line
+	 * @param line The line
+	 * @param occurrences The identifiers
+	 */
+	void findLineOccurrences(const FormattedLine& line, std::vector<Occurrence>& occurrences);
+
+	/**
+	 * Updates the number of occurrences of the given identifiers
+	 * @param occurrences The occurrences
+	 * @param begin The index of the first occurrence
+	 * @param end The index after the last occurrence
+	 * @param added Indicates if the occurrences are added or removed
+	 */
+	void updateSymbolCounts(const std::vector<Occurrence>& occurrences, std::size_t begin, std::size_t end, bool added);
+
+	/**
+	 * Sorts the identifiers interned since the last search into the sorted identifiers
+	 */
+	void updateSortedSymbols() const;
+
+	/**
+	 * Marks that the start of the given chunk and the chunks after it needs to be recomputed
+	 * @param chunkIndex The index of the chunk
+	 */
+	void invalidateFrom(std::size_t chunkIndex);
+
+	/**
+	 * Recomputes the start of the invalid chunks
+	 */
+	void updateChunkStarts() const;
+
+	/**
+	 * Finds the chunk that contains the given line
+	 * @param lineIndex The index of the line
+	 * @return The index of the chunk and the index within the chunk
+	 */
+	std::pair<std::size_t, std::size_t> findChunk(std::size_t lineIndex) const;
+
+	/**
+	 * Splits the chunks such that a chunk starts at the given line
+	 * @param lineIndex The index of the line, which can be the number of lines
+	 * @return The index of the chunk
+	 */
+	std::size_t splitAt(std::size_t lineIndex);
+
+	/**
+	 * Merges the chunk after the given chunk into it if they are small enough together
+	 * @param chunkIndex The index of the chunk
+	 */
+	void mergeWithNext(std::size_t chunkIndex);
+
+	/**
+	 * Erases the given lines
+	 * @param lineIndex The index of the first line
+	 * @param count The number of lines
+	 */
+	void eraseLines(std::size_t lineIndex, std::size_t count);
+
+	/**
+	 * Indexes the given lines of the text and inserts them before the given line
+	 * @param text The formatted text
+	 * @param lineIndex The index of the first line
+	 * @param count The number of lines
+	 */
+	void insertLines(const BaseFormattedText& text, std::size_t lineIndex, std::size_t count);
+public:
+	/**
+	 * Indicates if the given character can be part of an identifier
+	 * @param character The character
+	 */
+	static bool isIdentifierCharacter(Char character);
+
+	/**
+	 * Removes all lines. The interned identifiers are kept.
+	 */
+	void clear();
+
+	/**
+	 * Indexes all lines of the given text
+	 * @param text The formatted text
+	 */
+	void assign(const BaseFormattedText& text);
+
+	/**
+	 * Indexes the lines of the given text after the indexed lines, until the time budget is used
+	 * @param text The formatted text
+	 * @param budgetMicroseconds The time budget in microseconds
+	 * @return True if all lines are indexed
+	 */
+	bool build(const BaseFormattedText& text, std::int64_t budgetMicroseconds);
+
+	/**
+	 * Replaces the given lines with the lines of the text. Only the chunks of the lines are updated. Lines that have
+	 * not been indexed yet are left to be indexed by the build.
+	 * @param text The formatted text
+	 * @param lineIndex The index of the first changed line
+	 * @param numOldLines The number of lines before the change
+	 * @param numNewLines The number of lines after the change
+	 */
+	void replaceLines(const BaseFormattedText& text,
+					  std::size_t lineIndex,
+					  std::size_t numOldLines,
+					  std::size_t numNewLines);
+
+	/**
+	 * Returns the number of indexed lines, which are the first lines of the text
+	 */
+	std::size_t numLines() const;
+
+	/**
+	 * Returns the number of interned identifiers
+	 */
+	std::size_t numSymbols() const;
+
+	/**
+	 * Returns the identifier with the given id
+	 * @param symbol The id of the identifier
+	 */
+	const String& symbolName(SymbolId symbol) const;
+
+	/**
+	 * Returns the number of occurrences of the given identifier in the indexed lines
+	 * @param symbol The id of the identifier
+	 */
+	std::size_t symbolCount(SymbolId symbol) const;
+
+	/**
+	 * Finds the identifiers that start with the given prefix and occur in the indexed lines
+	 * @param prefix The prefix
+	 * @param maxSymbols The maximum number of identifiers
+	 * @param symbols The identifiers with the most occurrences, ordered by number of occurrences and then by name
+	 */
+	void findSymbolsWithPrefix(const String& prefix, std::size_t maxSymbols, std::vector<SymbolId>& symbols) const;
+
+	/**
+	 * Returns the identifier at the given position, where the position can also be just after the identifier
+	 * @param position The position
+	 * @param start The position of the first character of the identifier
+	 * @return The id of the identifier, or NO_SYMBOL if there is none
+	 */
+	SymbolId findSymbolAt(const SymbolPosition& position, SymbolPosition& start) const;
+
+	/**
+	 * Finds the occurrences of the given identifier within the given lines
+	 * @param symbol The id of the identifier
+	 * @param startLineIndex The index of the first line
+	 * @param endLineIndex The index of the last line
+	 * @param positions The positions of the occurrences, ordered by position
+	 */
+	void findOccurrences(SymbolId symbol,
+						 std::size_t startLineIndex,
+						 std::size_t endLineIndex,
+						 std::vector<SymbolPosition>& positions) const;
+
+	/**
+	 * Finds the likely definition of the given identifier. This is the first occurrence that directly follows a
+	 * keyword that can start a declaration, such as a type or "def", otherwise the first occurrence.
+	 * @param symbol The id of the identifier
+	 * @param position The position of the definition
+	 * @return True if the identifier occurs in the text
+	 */
+	bool findDefinition(SymbolId symbol, SymbolPosition& position) const;
+};
\ No newline at end of file
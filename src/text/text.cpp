@@ -32,6 +32,19 @@ Text::Text(String text) {
 	} else {
 		mLines.emplace_back();
 	}
+
+	linesInserted(0, mLines.size());
+}
+
+void Text::lineChanged(std::size_t index) {
+	mLineVersions.at(index) = mNextLineVersion++;
+}
+
+void Text::linesInserted(std::size_t index, std::size_t count) {
+	mLineVersions.insert(mLineVersions.begin() + index, count, 0);
+	for (std::size_t i = index; i < index + count; i++) {
+		mLineVersions[i] = mNextLineVersion++;
+	}
 }
 
 void Text::forEach(std::function<void(std::size_t, Char)> apply) const {
@@ -65,6 +78,10 @@ const String& Text::getLine(std::size_t index) const {
 	return mLines.at(index);
 }
 
+std::size_t Text::lineVersion(std::size_t index) const {
+	return mLineVersions.at(index);
+}
+
 bool Text::hasChanged(std::size_t& version) const {
 	if (mVersion != version) {
 		version = mVersion;
@@ -82,6 +99,7 @@ void Text::insertAt(std::size_t lineIndex, std::size_t charIndex, Char character
 	auto maxIndex = (std::size_t)std::max((std::int64_t)line.size(), 0L);
 	charIndex = std::min(charIndex, maxIndex);
 	line.insert(line.begin() + charIndex, character);
+	lineChanged(lineIndex);
 
 	std::cout << "Inserted character in " << Helpers::durationMilliseconds(Helpers::timeNow(), startTime) << " ms" << std::endl;
 }
@@ -94,6 +112,7 @@ void Text::insertAt(std::size_t lineIndex, std::size_t charIndex, const String&
 	auto maxIndex = (std::size_t)std::max((std::int64_t)line.size(), 0L);
 	charIndex = std::min(charIndex, maxIndex);
 	line.insert(charIndex, str);
+	lineChanged(lineIndex);
 
 	std::cout << "Inserted string in " << Helpers::durationMilliseconds(Helpers::timeNow(), startTime) << " ms" << std::endl;
 }
@@ -103,6 +122,7 @@ void Text::insertLine(std::size_t lineIndex, const String& line) {
 	mVersion++;
 
 	mLines.insert(mLines.begin() + lineIndex + 1, line);
+	linesInserted(lineIndex + 1, 1);
 	std::cout << "Insert line in " << Helpers::durationMilliseconds(Helpers::timeNow(), startTime) << " ms" << std::endl;
 }
 
@@ -112,6 +132,7 @@ void Text::insertText(std::size_t lineIndex, std::size_t charIndex, const Text&
 
 	insertAt(lineIndex, charIndex, text.getLine(0));
 	mLines.insert(mLines.begin() + lineIndex + 1, text.mLines.begin() + 1, text.mLines.end());
+	linesInserted(lineIndex + 1, text.numLines() - 1);
 
 	std::cout << "Insert text in " << Helpers::durationMilliseconds(Helpers::timeNow(), startTime) << " ms" << std::endl;
 }
@@ -124,6 +145,7 @@ void Text::deleteAt(std::size_t lineIndex, std::size_t charIndex) {
 	auto maxIndex = (std::size_t)std::max((std::int64_t)line.size(), 0L);
 	charIndex = std::min(charIndex, maxIndex);
 	line.erase(line.begin() + charIndex);
+	lineChanged(lineIndex);
 
 	std::cout << "Deleted character in " << Helpers::durationMilliseconds(Helpers::timeNow(), startTime) << " ms" << std::endl;
 }
@@ -136,6 +158,8 @@ void Text::splitLine(std::size_t lineNumber, std::size_t charIndex) {
 	auto afterSplit = line.substr(charIndex);
 	line.erase(line.begin() + charIndex, line.end());
 	mLines.insert(mLines.begin() + lineNumber + 1, afterSplit);
+	lineChanged(lineNumber);
+	linesInserted(lineNumber + 1, 1);
 
 	std::cout << "Split line in " << Helpers::durationMilliseconds(Helpers::timeNow(), startTime) << " ms" << std::endl;
 }
@@ -149,13 +173,17 @@ Text::DeleteLineDiff Text::deleteLine(std::size_t lineNumber, DeleteLineMode mod
 		if (lineNumber > 0) {
 			diff.caretX = mLines.at(lineNumber - 1).length();
 			mLines.at(lineNumber - 1) += mLines.at(lineNumber);
+			lineChanged(lineNumber - 1);
 		}
 
 		mLines.erase(mLines.begin() + lineNumber);
+		mLineVersions.erase(mLineVersions.begin() + lineNumber);
 	} else {
 		if (lineNumber + 1 < numLines()) {
 			mLines.at(lineNumber) += mLines.at(lineNumber + 1);
 			mLines.erase(mLines.begin() + lineNumber + 1);
+			lineChanged(lineNumber);
+			mLineVersions.erase(mLineVersions.begin() + lineNumber + 1);
 		}
 	}
 
@@ -171,6 +199,7 @@ Text::DeleteSelectionData Text::deleteSelection(const TextSelection& textSelecti
 	if (textSelection.startLine == textSelection.endLine) {
 		auto& line = mLines.at(textSelection.startLine);
 		mLines.at(textSelection.startLine) = line.substr(0, textSelection.startChar) + line.substr(std::min(textSelection.endChar + 1, line.size()));
+		lineChanged(textSelection.startLine);
 		deleteSelectionData.startDeleteLineIndex = textSelection.startLine;
 		deleteSelectionData.endDeleteLineIndex = textSelection.endLine;
 	} else {
@@ -187,14 +216,17 @@ Text::DeleteSelectionData Text::deleteSelection(const TextSelection& textSelecti
 		}
 
 		mLines.at(textSelection.startLine) = mLines.at(textSelection.startLine).substr(0, textSelection.startChar);
+		lineChanged(textSelection.startLine);
 		if (!deleteLastLine) {
 			mLines.at(textSelection.endLine) = lastLine.substr(lastLineRemoveIndex);
+			lineChanged(textSelection.endLine);
 		}
 
 		deleteSelectionData.startDeleteLineIndex = deleteLineStartIndex;
 		deleteSelectionData.endDeleteLineIndex = deleteLineEndIndex;
 
 		mLines.erase(mLines.begin() + deleteLineStartIndex, mLines.begin() + deleteLineEndIndex + 1);
+		mLineVersions.erase(mLineVersions.begin() + deleteLineStartIndex, mLineVersions.begin() + deleteLineEndIndex + 1);
 	}
 
 	std::cout << "Deleted selection in " << Helpers::durationMilliseconds(Helpers::timeNow(), startTime) << " ms" << std::endl;
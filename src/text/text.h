@@ -40,6 +40,22 @@ class Text {
 private:
 	std::vector<String> mLines;
 	std::size_t mVersion = 0;
+
+	std::vector<std::size_t> mLineVersions;
+	std::size_t mNextLineVersion = 0;
+
+	/**
+	 * Marks that the given line has changed
+	 * @param index The index of the line
+	 */
+	void lineChanged(std::size_t index);
+
+	/**
+	 * Inserts versions for the given new lines
+	 * @param index The index of the first new line
+	 * @param count The number of new lines
+	 */
+	void linesInserted(std::size_t index, std::size_t count);
 public:
 	/**
 	 * Creates a new text
@@ -63,6 +79,13 @@ public:
 	 */
 	const String& getLine(std::size_t index) const;
 
+	/**
+	 * Returns the version of the given line. The version is unique for each content a line has had, and moving a line
+	 * due to changes to other lines does not change its version.
+	 * @param index The index
+	 */
+	std::size_t lineVersion(std::size_t index) const;
+
 	/**
 	 * Applies the given function to each character in the text
 	 * @param apply The function to apply
@@ -3,40 +3,91 @@
 #include "../rendering/font.h"
 #include "../rendering/textrender.h"
 #include "../rendering/renderstyle.h"
-#include "../rendering/renderviewport.h"
 #include "../helpers.h"
-#include "../external/tsl/array_set.h"
 
 #include <iostream>
 #include <unordered_set>
 
-#include "../external/tsl/array_set.h"
 #include "formatters/cpp.h"
 #include "formatters/python.h"
-
-FormatterStateMachine::FormatterStateMachine(const FormatterRules& textFormatterRules,
-											 const Font& font,
-											 const RenderStyle& renderStyle,
-											 const RenderViewPort& viewPort,
-											 FormattedLines& formattedLines)
-	: mRules(textFormatterRules),
+#include "formatters/text.h"
+#include "formatters/grammar.h"
+
+template<typename TRules>
+FormatterStateMachine<TRules>::FormatterStateMachine(const TRules& rules,
+													 const Font& font,
+													 const RenderStyle& renderStyle,
+													 FormattedLines& formattedLines)
+	: mRules(rules),
 	  mFont(font),
 	  mRenderStyle(renderStyle),
-	  mViewPort(viewPort),
 	  mFormattedLines(formattedLines),
 	  mPrevCharBuffer(5) {
 
 }
 
-State FormatterStateMachine::state() const {
+template<typename TRules>
+State FormatterStateMachine<TRules>::state() const {
 	return mState;
 }
 
-const FormattedLine& FormatterStateMachine::currentFormattedLine() const {
+template<typename TRules>
+bool FormatterStateMachine<TRules>::isNormalState() const {
+	return mState == State::Text || mState == State::Number;
+}
+
+template<typename TRules>
+const FormattedLine& FormatterStateMachine<TRules>::currentFormattedLine() const {
 	return mCurrentFormattedLine;
 }
 
-void FormatterStateMachine::removeChars(std::size_t count) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::startInState(State state) {
+	mState = state;
+	if (state == State::BlockComment) {
+		mCurrentToken.type = TokenType::Comment;
+	}
+}
+
+template<typename TRules>
+void FormatterStateMachine<TRules>::reset() {
+	mLineNumber = 0;
+	mBlockCommentStartIndex = 0;
+	mState = State::Text;
+	mIsWhitespace = false;
+	mIsEscaped = false;
+
+	recycleLine(std::move(mCurrentFormattedLine));
+	startNewFormattedLine();
+	mCurrentToken = {};
+	mCurrentWidth = 0.0f;
+
+	mPrevCharBuffer.clear();
+}
+
+template<typename TRules>
+void FormatterStateMachine<TRules>::recycleLine(FormattedLine line) {
+	// Only a few lines are needed for the steady state of reformatting a line for each keystroke
+	const std::size_t maxFreeTokens = 64;
+	if (mFreeTokens.size() < maxFreeTokens && line.tokens.capacity() > 0) {
+		line.tokens.clear();
+		mFreeTokens.push_back(std::move(line.tokens));
+	}
+}
+
+template<typename TRules>
+void FormatterStateMachine<TRules>::startNewFormattedLine() {
+	mCurrentFormattedLine = {};
+	if (!mFreeTokens.empty()) {
+		mCurrentFormattedLine.tokens = std::move(mFreeTokens.back());
+		mFreeTokens.pop_back();
+	} else {
+		mCurrentFormattedLine.tokens.reserve(1);
+	}
+}
+
+template<typename TRules>
+void FormatterStateMachine<TRules>::removeChars(std::size_t count) {
 	std::size_t toRemoveLeft = count;
 	Token* currentToken = &mCurrentToken;
 	auto currentTokenIterator = mCurrentFormattedLine.tokens.end();
@@ -45,6 +96,10 @@ void FormatterStateMachine::removeChars(std::size_t count) {
 		auto thisRemoved = std::min(toRemoveLeft, currentToken->text.size());
 
 		if (thisRemoved > 0) {
+			for (auto i = currentToken->text.size() - thisRemoved; i < currentToken->text.size(); i++) {
+				mCurrentWidth -= mRenderStyle.getAdvanceX(mFont, currentToken->text[i]);
+			}
+
 			currentToken->text.erase(
 				currentToken->text.begin() + currentToken->text.size() - thisRemoved,
 				currentToken->text.end());
@@ -65,12 +120,15 @@ void FormatterStateMachine::removeChars(std::size_t count) {
 			currentToken = &(*currentTokenIterator);
 		}
 	}
+
+	mCurrentFormattedLine.version = FormattedLine::nextVersion();
 }
 
-bool FormatterStateMachine::isPrevCharsMatch(const String& string, Char current, String& prevChars) {
-	if (current == string.back()) {
-		prevChars = getPrevChars(string.size() - 1);
-		if (prevChars == string.substr(0, string.size() - 1)) {
+template<typename TRules>
+bool FormatterStateMachine<TRules>::isPrevCharsMatch(const Char* string, std::size_t length, Char current, String& prevChars) {
+	if (length > 0 && current == string[length - 1]) {
+		prevChars = getPrevChars(length - 1);
+		if (prevChars.compare(0, String::npos, string, length - 1) == 0) {
 			return true;
 		}
 	}
@@ -78,14 +136,19 @@ bool FormatterStateMachine::isPrevCharsMatch(const String& string, Char current,
 	return false;
 }
 
-void FormatterStateMachine::tryMakeKeyword() {
+template<typename TRules>
+void FormatterStateMachine<TRules>::tryMakeKeyword() {
 	if (mRules.isKeyword(mCurrentToken.text)) {
 		mCurrentToken.type = TokenType::Keyword;
 	}
 }
 
-void FormatterStateMachine::createNewLine(bool resetState, bool continueWithLine, bool allowKeyword) {
-	if (mRules.mode() == FormatMode::Code) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::createNewLine(bool resetState, bool allowKeyword) {
+	mCurrentFormattedLine.width = mCurrentWidth;
+	mCurrentFormattedLine.endsInBlockComment = mState == State::BlockComment;
+
+	if (mRules.mode == FormatMode::Code) {
 		if (mState == State::BlockComment) {
 			mCurrentFormattedLine.reformatStartSearch = (std::int64_t)mBlockCommentStartIndex - (std::int64_t)mLineNumber;
 		}
@@ -116,21 +179,14 @@ void FormatterStateMachine::createNewLine(bool resetState, bool continueWithLine
 	}
 
 	mCurrentFormattedLine.number = mLineNumber;
-	std::size_t offsetFromTextLine = 0;
-	if (!continueWithLine) {
-		mLineNumber++;
-	} else {
-		offsetFromTextLine = mCurrentFormattedLine.offsetFromTextLine + mCurrentFormattedLine.length();
-	}
+	mLineNumber++;
 
 	mFormattedLines.push_back(std::move(mCurrentFormattedLine));
-	mCurrentFormattedLine = {};
-	mCurrentFormattedLine.offsetFromTextLine = offsetFromTextLine;
-	mCurrentFormattedLine.isContinuation = continueWithLine;
-	mCurrentFormattedLine.tokens.reserve(1);
+	startNewFormattedLine();
 }
 
-void FormatterStateMachine::newToken(TokenType type, bool makeKeyword) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::newToken(TokenType type, bool makeKeyword) {
 	if (makeKeyword) {
 		tryMakeKeyword();
 	}
@@ -143,17 +199,20 @@ void FormatterStateMachine::newToken(TokenType type, bool makeKeyword) {
 	mCurrentToken.type = type;
 }
 
-void FormatterStateMachine::addChar(Char character, float advanceX) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::addChar(Char character, float advanceX) {
 	mCurrentToken.text += character;
 	mCurrentWidth += advanceX;
 	mIsEscaped = false;
 }
 
-void FormatterStateMachine::handleTab() {
+template<typename TRules>
+void FormatterStateMachine<TRules>::handleTab() {
 	addChar('\t', mRenderStyle.getAdvanceX(mFont, '\t'));
 }
 
-String FormatterStateMachine::getPrevChars(std::size_t size) {
+template<typename TRules>
+String FormatterStateMachine<TRules>::getPrevChars(std::size_t size) {
 	String prevChars;
 	mPrevCharBuffer.forEachElement([&](auto& value) {
 		prevChars += value;
@@ -162,9 +221,10 @@ String FormatterStateMachine::getPrevChars(std::size_t size) {
 	return prevChars;
 }
 
-void FormatterStateMachine::handleText(Char current, float advanceX) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::handleText(Char current, float advanceX) {
 	String prevChars;
-	if (isPrevCharsMatch(mRules.lineCommentStart(), current, prevChars)) {
+	if (isPrevCharsMatch(mRules.lineCommentStart, current, prevChars)) {
 		// Remove prevChars from previous tokens
 		removeChars(prevChars.size());
 
@@ -179,7 +239,7 @@ void FormatterStateMachine::handleText(Char current, float advanceX) {
 		return;
 	}
 
-	if (isPrevCharsMatch(mRules.blockCommentStart(), current, prevChars)) {
+	if (isPrevCharsMatch(mRules.blockCommentStart, current, prevChars)) {
 		// Remove prevChars from previous tokens
 		removeChars(prevChars.size());
 
@@ -226,17 +286,14 @@ void FormatterStateMachine::handleText(Char current, float advanceX) {
 			addChar(current, advanceX);
 			mIsWhitespace = true;
 			break;
-		case ',':
-		case '(':
-		case ')':
-		case '&':
-		case ':':
-		case '*':
-			newToken(TokenType::Text, true);
-			addChar(current, advanceX);
-			newToken(TokenType::Text, true);
-			break;
 		default:
+			if (mRules.isOperator(current)) {
+				newToken(TokenType::Text, true);
+				addChar(current, advanceX);
+				newToken(TokenType::Text, true);
+				break;
+			}
+
 			if (mIsWhitespace) {
 				newToken();
 				mIsWhitespace = false;
@@ -247,7 +304,8 @@ void FormatterStateMachine::handleText(Char current, float advanceX) {
 	}
 }
 
-void FormatterStateMachine::handleString(Char current, float advanceX) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::handleString(Char current, float advanceX) {
 	if (current == mStringStartDelimiter) {
 		if (!mIsEscaped) {
 			mState = State::Text;
@@ -277,8 +335,9 @@ void FormatterStateMachine::handleString(Char current, float advanceX) {
 	}
 }
 
-void FormatterStateMachine::handleNumber(Char current, float advanceX) {
-	if (std::isdigit(current) || current == '.' || current == 'f') {
+template<typename TRules>
+void FormatterStateMachine<TRules>::handleNumber(Char current, float advanceX) {
+	if (mRules.isNumberChar(current)) {
 		addChar(current, advanceX);
 	} else if (current == '\n') {
 		createNewLine();
@@ -289,7 +348,8 @@ void FormatterStateMachine::handleNumber(Char current, float advanceX) {
 	}
 }
 
-void FormatterStateMachine::handleComment(Char current, float advanceX) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::handleComment(Char current, float advanceX) {
 	switch (current) {
 		case '\n':
 			createNewLine();
@@ -303,9 +363,11 @@ void FormatterStateMachine::handleComment(Char current, float advanceX) {
 	}
 }
 
-void FormatterStateMachine::handleBlockComment(Char current, float advanceX) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::handleBlockComment(Char current, float advanceX) {
 	auto updateStartFormatInformation = [&]() {
-		if (!mFormattedLines.empty()) {
+		// The line where the comment starts has not been added yet if it is the current line
+		if (mBlockCommentStartIndex < mFormattedLines.size()) {
 			mFormattedLines[mBlockCommentStartIndex].reformatAmount = (std::int64_t)mLineNumber - (std::int64_t)mBlockCommentStartIndex;
 		}
 	};
@@ -313,14 +375,14 @@ void FormatterStateMachine::handleBlockComment(Char current, float advanceX) {
 	switch (current) {
 		case '\n':
 			updateStartFormatInformation();
-			createNewLine(false, false, false);
+			createNewLine(false, false);
 			break;
 		case '\t':
 			handleTab();
 			break;
 		default:
 			String prevChars;
-			if (isPrevCharsMatch(mRules.blockCommentEnd(), current, prevChars)) {
+			if (isPrevCharsMatch(mRules.blockCommentEnd, current, prevChars)) {
 				updateStartFormatInformation();
 				mCurrentFormattedLine.reformatStartSearch = (std::int64_t)mBlockCommentStartIndex - (std::int64_t)mLineNumber;
 				mCurrentFormattedLine.mayRequireSearch = true;
@@ -336,15 +398,10 @@ void FormatterStateMachine::handleBlockComment(Char current, float advanceX) {
 	}
 }
 
-void FormatterStateMachine::processCodeMode(Char current) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::processCodeMode(Char current) {
 	auto advanceX = mRenderStyle.getAdvanceX(mFont, current);
 
-	if (mRenderStyle.wordWrap) {
-		if (mCurrentWidth + advanceX > mViewPort.width) {
-			createNewLine(false, true);
-		}
-	}
-
 	switch (mState) {
 		case State::Text:
 			handleText(current, advanceX);
@@ -366,15 +423,10 @@ void FormatterStateMachine::processCodeMode(Char current) {
 	mPrevCharBuffer.add(current);
 }
 
-void FormatterStateMachine::processTextMode(Char current) {
+template<typename TRules>
+void FormatterStateMachine<TRules>::processTextMode(Char current) {
 	auto advanceX = mRenderStyle.getAdvanceX(mFont, current);
 
-	if (mRenderStyle.wordWrap) {
-		if (mCurrentWidth + advanceX > mViewPort.width) {
-			createNewLine(false, true);
-		}
-	}
-
 	if (current == '\n') {
 		createNewLine();
 	} else if (current == '\t') {
@@ -386,88 +438,240 @@ void FormatterStateMachine::processTextMode(Char current) {
 	mPrevCharBuffer.add(current);
 }
 
-void FormatterStateMachine::processLine(const String& line) {
-	switch (mRules.mode()) {
-		case FormatMode::Text:
-			for (auto current : line) {
-				processTextMode(current);
+template<typename TRules>
+void FormatterStateMachine<TRules>::process(Char current) {
+	if (mRules.mode == FormatMode::Code) {
+		processCodeMode(current);
+	} else {
+		processTextMode(current);
+	}
+}
+
+template<typename TRules>
+void FormatterStateMachine<TRules>::processLine(const String& line) {
+	for (auto current : line) {
+		process(current);
+	}
+
+	process('\n');
+}
+
+template<typename TRules>
+RulesFormattingJob<TRules>::RulesFormattingJob(const TRules& rules,
+											   const Font& font,
+											   const RenderStyle& renderStyle,
+											   const Text& text,
+											   std::size_t startLineIndex,
+											   std::size_t endLineIndex)
+	: mText(text),
+	  mStartLineIndex(startLineIndex),
+	  mEndLineIndex(endLineIndex),
+	  mCurrentLineIndex(startLineIndex),
+	  mStateMachine(rules, font, renderStyle, mFormattedLines) {
+
+}
+
+template<typename TRules>
+std::size_t RulesFormattingJob<TRules>::startLineIndex() const {
+	return mStartLineIndex;
+}
+
+template<typename TRules>
+FormattedLines& RulesFormattingJob<TRules>::formattedLines() {
+	return mFormattedLines;
+}
+
+template<typename TRules>
+bool RulesFormattingJob<TRules>::isDone() const {
+	return mDone;
+}
+
+template<typename TRules>
+void RulesFormattingJob<TRules>::restart(std::size_t startLineIndex, std::size_t endLineIndex) {
+	mStartLineIndex = startLineIndex;
+	mEndLineIndex = endLineIndex;
+	mCurrentLineIndex = startLineIndex;
+	mDone = false;
+
+	mFormattedLines.clear();
+	mStateMachine.reset();
+}
+
+template<typename TRules>
+void RulesFormattingJob<TRules>::recycleLine(FormattedLine line) {
+	mStateMachine.recycleLine(std::move(line));
+}
+
+template<typename TRules>
+bool RulesFormattingJob<TRules>::run(std::int64_t budgetMicroseconds) {
+	// Reading the clock for every line is noticeable for short lines
+	const std::size_t linesPerTimeCheck = 64;
+	auto startTime = Helpers::timeNow();
+
+	while (!mDone) {
+		// Continue until we are out of multi-line constructs such as block comments
+		if (mCurrentLineIndex >= mText.numLines()
+			|| (mCurrentLineIndex > mEndLineIndex && mStateMachine.isNormalState())) {
+			if (!mStateMachine.currentFormattedLine().tokens.empty()) {
+				mStateMachine.createNewLine();
 			}
 
-			processTextMode('\n');
+			mDone = true;
 			break;
-		case FormatMode::Code:
-			for (auto current : line) {
-				processCodeMode(current);
-			}
+		}
 
-			processCodeMode('\n');
+		mStateMachine.processLine(mText.getLine(mCurrentLineIndex));
+		mCurrentLineIndex++;
+
+		if ((mCurrentLineIndex - mStartLineIndex) % linesPerTimeCheck == 0
+			&& Helpers::durationMicroseconds(Helpers::timeNow(), startTime) >= budgetMicroseconds) {
 			break;
+		}
 	}
+
+	return mDone;
 }
 
-TextFormatter::TextFormatter(std::unique_ptr<FormatterRules> rules)
+template<typename TRules>
+RulesTextFormatter<TRules>::RulesTextFormatter(TRules rules)
 	: mRules(std::move(rules)) {
 
 }
 
-const FormatterRules& TextFormatter::rules() const {
-	return *mRules;
+template<typename TRules>
+const TRules& RulesTextFormatter<TRules>::rules() const {
+	return mRules;
+}
+
+template<typename TRules>
+FormatMode RulesTextFormatter<TRules>::mode() const {
+	return mRules.mode;
+}
+
+template<typename TRules>
+std::vector<String> RulesTextFormatter<TRules>::keywords() const {
+	return mRules.keywords();
+}
+
+template<typename TRules>
+FormatterStateMachine<TRules> RulesTextFormatter<TRules>::createStateMachine(const Font& font,
+																			 const RenderStyle& renderStyle,
+																			 FormattedLines& formattedLines) {
+	return FormatterStateMachine<TRules>(mRules, font, renderStyle, formattedLines);
 }
 
-FormatterStateMachine TextFormatter::createStateMachine(const Font& font,
-														const RenderStyle& renderStyle,
-														const RenderViewPort& viewPort,
-														FormattedLines& formattedLines) {
-	return FormatterStateMachine(rules(), font, renderStyle, viewPort, formattedLines);
+template<typename TRules>
+void RulesTextFormatter<TRules>::formatLine(const Font& font,
+											const RenderStyle& renderStyle,
+											const String& line,
+											FormattedLine& formattedLine) {
+	// The lines are only used during the call, so the memory is reused between calls
+	mScratchLines.clear();
+	if (mLineStateMachine == nullptr || mLineFont != &font || mLineRenderStyle != &renderStyle) {
+		mLineStateMachine = std::make_unique<FormatterStateMachine<TRules>>(mRules, font, renderStyle, mScratchLines);
+		mLineFont = &font;
+		mLineRenderStyle = &renderStyle;
+	} else {
+		mLineStateMachine->recycleLine(std::move(formattedLine));
+		mLineStateMachine->reset();
+	}
+
+	mLineStateMachine->processLine(line);
+
+	if (!mLineStateMachine->currentFormattedLine().tokens.empty()) {
+		mLineStateMachine->createNewLine();
+	}
+
+	formattedLine = std::move(mScratchLines.front());
 }
 
-void TextFormatter::formatLine(const Font& font,
-							   const RenderStyle& renderStyle,
-							   const RenderViewPort& viewPort,
-							   const String& line,
-							   FormattedLine& formattedLine) {
-	FormattedLines formattedLines;
-	FormatterStateMachine stateMachine(*mRules, font, renderStyle, viewPort, formattedLines);
+template<typename TRules>
+std::size_t RulesTextFormatter<TRules>::formatLines(const Font& font,
+													const RenderStyle& renderStyle,
+													const Text& text,
+													std::size_t startLineIndex,
+													std::size_t endLineIndex,
+													FormattedLines& formattedLines) {
+	auto stateMachine = createStateMachine(font, renderStyle, formattedLines);
+
+	std::size_t numFormattedLines = 0;
+	for (std::size_t i = startLineIndex; i <= endLineIndex; i++) {
+		stateMachine.processLine(text.getLine(i));
+		numFormattedLines++;
+	}
 
-	stateMachine.processLine(line);
+	// Continue until we are out of multi-line constructs such as block comments
+	if (!stateMachine.isNormalState()) {
+		for (std::size_t i = endLineIndex + 1; i < text.numLines(); i++) {
+			stateMachine.processLine(text.getLine(i));
+			numFormattedLines++;
+
+			if (stateMachine.isNormalState()) {
+				break;
+			}
+		}
+	}
 
 	if (!stateMachine.currentFormattedLine().tokens.empty()) {
 		stateMachine.createNewLine();
 	}
 
-	formattedLine = std::move(formattedLines.front());
+	return numFormattedLines;
 }
 
-void TextFormatter::format(const Font& font,
-						   const RenderStyle& renderStyle,
-						   const RenderViewPort& viewPort,
-						   const Text& text,
-						   FormattedLines& formattedLines) {
-	formattedLines.reserve(text.numLines());
-	FormatterStateMachine stateMachine(*mRules, font, renderStyle, viewPort, formattedLines);
+template<typename TRules>
+void RulesTextFormatter<TRules>::formatLinesInState(const Font& font,
+													const RenderStyle& renderStyle,
+													const Text& text,
+													std::size_t startLineIndex,
+													std::size_t endLineIndex,
+													State state,
+													FormattedLines& formattedLines) {
+	auto stateMachine = createStateMachine(font, renderStyle, formattedLines);
+	stateMachine.startInState(state);
+
+	for (std::size_t i = startLineIndex; i <= endLineIndex; i++) {
+		stateMachine.processLine(text.getLine(i));
+	}
+}
 
-	switch (mRules->mode()) {
-		case FormatMode::Text:
-			text.forEachLine([&](const String& line) {
-				for (auto& current : line) {
-					stateMachine.processTextMode(current);
-				}
+template<typename TRules>
+std::unique_ptr<FormattingJob> RulesTextFormatter<TRules>::createFormattingJob(const Font& font,
+																			   const RenderStyle& renderStyle,
+																			   const Text& text,
+																			   std::size_t startLineIndex,
+																			   std::size_t endLineIndex) {
+	return std::make_unique<RulesFormattingJob<TRules>>(mRules, font, renderStyle, text, startLineIndex, endLineIndex);
+}
 
-				stateMachine.processTextMode('\n');
-			});
-			break;
-		case FormatMode::Code:
-			text.forEachLine([&](const String& line) {
-				for (auto& current : line) {
-					stateMachine.processCodeMode(current);
-				}
-
-				stateMachine.processCodeMode('\n');
-			});
-			break;
-	}
+template<typename TRules>
+void RulesTextFormatter<TRules>::format(const Font& font,
+										const RenderStyle& renderStyle,
+										const Text& text,
+										FormattedLines& formattedLines) {
+	formattedLines.reserve(text.numLines());
+	auto stateMachine = createStateMachine(font, renderStyle, formattedLines);
+
+	text.forEachLine([&](const String& line) {
+		stateMachine.processLine(line);
+	});
 
 	if (!stateMachine.currentFormattedLine().tokens.empty()) {
 		stateMachine.createNewLine();
 	}
-}
\ No newline at end of file
+}
+
+template class FormatterStateMachine<CppFormatterRules>;
+template class FormatterStateMachine<PythonFormatterRules>;
+template class FormatterStateMachine<TextFormatterRules>;
+template class FormatterStateMachine<GrammarFormatterRules>;
+
+template class RulesFormattingJob<CppFormatterRules>;
+template class RulesFormattingJob<PythonFormatterRules>;
+template class RulesFormattingJob<TextFormatterRules>;
+template class RulesFormattingJob<GrammarFormatterRules>;
+
+template class RulesTextFormatter<CppFormatterRules>;
+template class RulesTextFormatter<PythonFormatterRules>;
+template class RulesTextFormatter<TextFormatterRules>;
+template class RulesTextFormatter<GrammarFormatterRules>;
\ No newline at end of file
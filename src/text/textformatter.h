@@ -7,9 +7,9 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <memory>
 
 class Font;
-struct RenderViewPort;
 struct RenderStyle;
 class Text;
 
@@ -28,14 +28,15 @@ enum class State {
 
 /**
  * The internal formatter state machine
+ * @tparam TRules The formatting rules
  */
+template<typename TRules>
 class FormatterStateMachine {
 private:
-	const FormatterRules& mRules;
+	const TRules& mRules;
 
 	const Font& mFont;
 	const RenderStyle& mRenderStyle;
-	const RenderViewPort& mViewPort;
 	FormattedLines& mFormattedLines;
 
 	std::size_t mLineNumber = 0;
@@ -51,14 +52,25 @@ private:
 	float mCurrentWidth = 0.0f;
 
 	CircularBuffer<Char> mPrevCharBuffer;
+	std::vector<std::vector<Token>> mFreeTokens;
 
 	String getPrevChars(std::size_t size);
 	void removeChars(std::size_t count);
-	bool isPrevCharsMatch(const String& string, Char current, String& prevChars);
+	bool isPrevCharsMatch(const Char* string, std::size_t length, Char current, String& prevChars);
+
+	template<std::size_t N>
+	inline bool isPrevCharsMatch(const Char (&string)[N], Char current, String& prevChars) {
+		return isPrevCharsMatch(string, N - 1, current, prevChars);
+	}
+
+	inline bool isPrevCharsMatch(const String& string, Char current, String& prevChars) {
+		return isPrevCharsMatch(string.data(), string.size(), current, prevChars);
+	}
 
 	void tryMakeKeyword();
 	void newToken(TokenType type = TokenType::Text, bool makeKeyword = false);
 	void addChar(Char character, float advanceX);
+	void startNewFormattedLine();
 
 	void handleTab();
 
@@ -68,77 +80,279 @@ private:
 	void handleComment(Char current, float advanceX);
 	void handleBlockComment(Char current, float advanceX);
 public:
-	FormatterStateMachine(const FormatterRules& textFormatterRules,
+	FormatterStateMachine(const TRules& rules,
 						  const Font& font,
 						  const RenderStyle& renderStyle,
-						  const RenderViewPort& viewPort,
 						  FormattedLines& formattedLines);
 
 	State state() const;
+	bool isNormalState() const;
 	const FormattedLine& currentFormattedLine() const;
 
-	void createNewLine(bool resetState = true, bool continueWithLine = false, bool allowKeyword = true);
+	void startInState(State state);
+	void reset();
+	void recycleLine(FormattedLine line);
+
+	void createNewLine(bool resetState = true, bool allowKeyword = true);
 	void processCodeMode(Char current);
 	void processTextMode(Char current);
+	void process(Char current);
 
 	void processLine(const String& line);
 };
 
+/**
+ * Represents a formatting of a range of lines that can be paused and resumed, which allows large regions to be
+ * formatted a slice at a time
+ */
+class FormattingJob {
+public:
+	virtual ~FormattingJob() = default;
+
+	/**
+	 * Returns the index of the first line
+	 */
+	virtual std::size_t startLineIndex() const = 0;
+
+	/**
+	 * Returns the lines formatted so far, starting at the first line
+	 */
+	virtual FormattedLines& formattedLines() = 0;
+
+	/**
+	 * Indicates if the job is done
+	 */
+	virtual bool isDone() const = 0;
+
+	/**
+	 * Restarts the job for the given lines, reusing the memory of the previous run
+	 * @param startLineIndex The index of the first line
+	 * @param endLineIndex The index of the last line
+	 */
+	virtual void restart(std::size_t startLineIndex, std::size_t endLineIndex) = 0;
+
+	/**
+	 * Gives a line that is no longer used to the job, which reuses its memory for new lines
+	 * @param line The line
+	 */
+	virtual void recycleLine(FormattedLine line) = 0;
+
+	/**
+	 * Formats lines until the job is done or the given time budget has been used
+	 * @param budgetMicroseconds The time budget in microseconds
+	 * @return True if the job is done
+	 */
+	virtual bool run(std::int64_t budgetMicroseconds) = 0;
+};
+
 /**
  * Represents a text formatter
  */
 class TextFormatter {
-private:
-	std::unique_ptr<FormatterRules> mRules;
 public:
+	virtual ~TextFormatter() = default;
+
 	/**
-	 * Creates a new text formatter
-	 * @param rules The formatting rules
+	 * Returns the format mode
 	 */
-	explicit TextFormatter(std::unique_ptr<FormatterRules> rules);
+	virtual FormatMode mode() const = 0;
 
 	/**
-	 * Returns the formatting rules
+	 * Returns the keywords of the language
 	 */
-	const FormatterRules& rules() const;
+	virtual std::vector<String> keywords() const = 0;
 
 	/**
-	 * Creates a new formatter state machine
+	 * Formats the given line
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param line The line to format
+	 * @param formattedLine The formatted line
+	 */
+	virtual void formatLine(const Font& font,
+							const RenderStyle& renderStyle,
+							const String& line,
+							FormattedLine& formattedLine) = 0;
+
+	/**
+	 * Formats the given lines. If the formatting has not returned to a normal state at the last line (e.g. inside a
+	 * block comment), the formatting continues until it has.
 	 * @param font The font
 	 * @param renderStyle The render style
-	 * @param viewPort The view port
+	 * @param text The text
+	 * @param startLineIndex The index of the first line
+	 * @param endLineIndex The index of the last line
 	 * @param formattedLines The formatted lines
+	 * @return The number of formatted text lines
 	 */
-	FormatterStateMachine createStateMachine(const Font& font,
-											 const RenderStyle& renderStyle,
-											 const RenderViewPort& viewPort,
-											 FormattedLines& formattedLines);
+	virtual std::size_t formatLines(const Font& font,
+									const RenderStyle& renderStyle,
+									const Text& text,
+									std::size_t startLineIndex,
+									std::size_t endLineIndex,
+									FormattedLines& formattedLines) = 0;
 
 	/**
-	 * Formats the given line
+	 * Formats exactly the given lines, where the first line starts in the given state. The information about
+	 * multi-line constructs is only valid within the lines.
 	 * @param font The font
-	 * @param viewPort The view port to render to
 	 * @param renderStyle The render style
-	 * @param line The line to format
-	 * @param formattedLine The formatted line
+	 * @param text The text
+	 * @param startLineIndex The index of the first line
+	 * @param endLineIndex The index of the last line
+	 * @param state The state at the start of the first line
+	 * @param formattedLines The formatted lines
 	 */
-	void formatLine(const Font& font,
-					const RenderStyle& renderStyle,
-					const RenderViewPort& viewPort,
-					const String& line,
-					FormattedLine& formattedLine);
+	virtual void formatLinesInState(const Font& font,
+									const RenderStyle& renderStyle,
+									const Text& text,
+									std::size_t startLineIndex,
+									std::size_t endLineIndex,
+									State state,
+									FormattedLines& formattedLines) = 0;
+
+	/**
+	 * Creates a job that formats the given lines. Like formatLines, the job continues after the last line until the
+	 * formatting has returned to a normal state.
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param text The text
+	 * @param startLineIndex The index of the first line
+	 * @param endLineIndex The index of the last line
+	 */
+	virtual std::unique_ptr<FormattingJob> createFormattingJob(const Font& font,
+															   const RenderStyle& renderStyle,
+															   const Text& text,
+															   std::size_t startLineIndex,
+															   std::size_t endLineIndex) = 0;
 
 	/**
 	 * Formats the given text using the given font
 	 * @param font The font
-	 * @param viewPort The view port to render to
 	 * @param renderStyle The render style
  	 * @param text The text
  	 * @param formattedLines The formatted lines
 	 */
-	void format(const Font& font,
-				const RenderStyle& renderStyle,
-				const RenderViewPort& viewPort,
-				const Text& text,
-				FormattedLines& formattedLines);
+	virtual void format(const Font& font,
+						const RenderStyle& renderStyle,
+						const Text& text,
+						FormattedLines& formattedLines) = 0;
+};
+
+/**
+ * Represents a formatting job for the given formatting rules
+ * @tparam TRules The formatting rules
+ */
+template<typename TRules>
+class RulesFormattingJob : public FormattingJob {
+private:
+	const Text& mText;
+	std::size_t mStartLineIndex;
+	std::size_t mEndLineIndex;
+	std::size_t mCurrentLineIndex;
+	bool mDone = false;
+
+	FormattedLines mFormattedLines;
+	FormatterStateMachine<TRules> mStateMachine;
+public:
+	/**
+	 * Creates a new formatting job
+	 * @param rules The formatting rules
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param text The text
+	 * @param startLineIndex The index of the first line
+	 * @param endLineIndex The index of the last line
+	 */
+	RulesFormattingJob(const TRules& rules,
+					   const Font& font,
+					   const RenderStyle& renderStyle,
+					   const Text& text,
+					   std::size_t startLineIndex,
+					   std::size_t endLineIndex);
+
+	virtual std::size_t startLineIndex() const override;
+	virtual FormattedLines& formattedLines() override;
+	virtual bool isDone() const override;
+	virtual void restart(std::size_t startLineIndex, std::size_t endLineIndex) override;
+	virtual void recycleLine(FormattedLine line) override;
+	virtual bool run(std::int64_t budgetMicroseconds) override;
+};
+
+/**
+ * Represents a text formatter specialized for the given formatting rules
+ * @tparam TRules The formatting rules
+ */
+template<typename TRules>
+class RulesTextFormatter : public TextFormatter {
+private:
+	TRules mRules;
+
+	// The state machine of formatLine is kept between calls and reset, like the state machine of a formatting job
+	FormattedLines mScratchLines;
+	std::unique_ptr<FormatterStateMachine<TRules>> mLineStateMachine;
+	const Font* mLineFont = nullptr;
+	const RenderStyle* mLineRenderStyle = nullptr;
+public:
+	/**
+	 * Creates a new text formatter
+	 * @param rules The formatting rules
+	 */
+	explicit RulesTextFormatter(TRules rules = {});
+
+	/**
+	 * Returns the formatting rules
+	 */
+	const TRules& rules() const;
+
+	/**
+	 * Returns the format mode
+	 */
+	virtual FormatMode mode() const override;
+
+	/**
+	 * Returns the keywords of the language
+	 */
+	virtual std::vector<String> keywords() const override;
+
+	/**
+	 * Creates a new formatter state machine
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param formattedLines The formatted lines
+	 */
+	FormatterStateMachine<TRules> createStateMachine(const Font& font,
+													 const RenderStyle& renderStyle,
+													 FormattedLines& formattedLines);
+
+	virtual void formatLine(const Font& font,
+							const RenderStyle& renderStyle,
+							const String& line,
+							FormattedLine& formattedLine) override;
+
+	virtual std::size_t formatLines(const Font& font,
+									const RenderStyle& renderStyle,
+									const Text& text,
+									std::size_t startLineIndex,
+									std::size_t endLineIndex,
+									FormattedLines& formattedLines) override;
+
+	virtual void formatLinesInState(const Font& font,
+									const RenderStyle& renderStyle,
+									const Text& text,
+									std::size_t startLineIndex,
+									std::size_t endLineIndex,
+									State state,
+									FormattedLines& formattedLines) override;
+
+	virtual std::unique_ptr<FormattingJob> createFormattingJob(const Font& font,
+															   const RenderStyle& renderStyle,
+															   const Text& text,
+															   std::size_t startLineIndex,
+															   std::size_t endLineIndex) override;
+
+	virtual void format(const Font& font,
+						const RenderStyle& renderStyle,
+						const Text& text,
+						FormattedLines& formattedLines) override;
 };
\ No newline at end of file
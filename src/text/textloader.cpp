@@ -1,19 +1,34 @@
 #include "textloader.h"
 #include "../helpers.h"
+#include "textformatter.h"
 #include "formatters/cpp.h"
 #include "formatters/python.h"
 #include "formatters/text.h"
+#include "formatters/grammar.h"
+
+void TextLoader::loadGrammars(const std::string& indexFileName, const std::string& cacheFileName) {
+	mGrammars = GrammarLoader::load(indexFileName, cacheFileName);
+}
 
 LoadedText TextLoader::load(const std::string& fileName) {
-	std::unique_ptr<FormatterRules> rules;
+	std::unique_ptr<TextFormatter> formatter;
+
+	for (auto& grammar : mGrammars) {
+		if (grammar.matches(fileName)) {
+			formatter = std::make_unique<RulesTextFormatter<GrammarFormatterRules>>(GrammarFormatterRules(grammar));
+			break;
+		}
+	}
 
-	if (fileName.find(".cpp") != std::string::npos || fileName.find(".h") != std::string::npos) {
-		rules = std::make_unique<CppFormatterRules>();
-	} else if (fileName.find(".py") != std::string::npos) {
-		rules = std::make_unique<PythonFormatterRules>();
-	} else {
-		rules = std::make_unique<TextFormatterRules>();
+	if (formatter == nullptr) {
+		if (fileName.find(".cpp") != std::string::npos || fileName.find(".h") != std::string::npos) {
+			formatter = std::make_unique<RulesTextFormatter<CppFormatterRules>>();
+		} else if (fileName.find(".py") != std::string::npos) {
+			formatter = std::make_unique<RulesTextFormatter<PythonFormatterRules>>();
+		} else {
+			formatter = std::make_unique<RulesTextFormatter<TextFormatterRules>>();
+		}
 	}
 
-	return { Text(Helpers::readFileAsText<String>(fileName)), std::move(rules) };
+	return { Text(Helpers::readFileAsText<String>(fileName)), std::move(formatter) };
 }
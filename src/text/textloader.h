@@ -1,19 +1,30 @@
 #pragma once
 #include <memory>
+#include <vector>
 #include "text.h"
+#include "grammar.h"
 
-class FormatterRules;
+class TextFormatter;
 
 struct LoadedText {
 	Text text;
-	std::unique_ptr<FormatterRules> rules;
+	std::unique_ptr<TextFormatter> formatter;
 };
 
 /**
  * Represents a text loader
  */
 class TextLoader {
+private:
+	std::vector<Grammar> mGrammars;
 public:
+	/**
+	 * Loads the grammars listed in the given index file, which are selected by the extension of the loaded file
+	 * @param indexFileName The name of the index file
+	 * @param cacheFileName The name of the binary cache of the grammars
+	 */
+	void loadGrammars(const std::string& indexFileName, const std::string& cacheFileName);
+
 	/**
 	 * Loads the text from the given filename
 	 * @param fileName The file name
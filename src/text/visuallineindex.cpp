@@ -0,0 +1,253 @@
+#include "visuallineindex.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+const std::vector<std::size_t>& VisualLineIndex::Chunk::getFirstRows() const {
+	if (!isFirstRowsValid) {
+		firstRows.resize(numRows.size());
+		std::size_t row = 0;
+		for (std::size_t i = 0; i < numRows.size(); i++) {
+			firstRows[i] = row;
+			row += numRows[i];
+		}
+
+		isFirstRowsValid = true;
+	}
+
+	return firstRows;
+}
+
+void VisualLineIndex::buildTrees() {
+	auto size = mChunks.size();
+	mLineTree.assign(size + 1, 0);
+	mRowTree.assign(size + 1, 0);
+
+	for (std::size_t i = 1; i <= size; i++) {
+		mLineTree[i] += mChunks[i - 1].numRows.size();
+		mRowTree[i] += mChunks[i - 1].totalNumRows;
+
+		auto parent = i + (i & (~i + 1));
+		if (parent <= size) {
+			mLineTree[parent] += mLineTree[i];
+			mRowTree[parent] += mRowTree[i];
+		}
+	}
+}
+
+void VisualLineIndex::addToTrees(std::size_t chunkIndex, std::size_t numLines, std::size_t numRows) {
+	for (auto i = chunkIndex + 1; i < mLineTree.size(); i += i & (~i + 1)) {
+		mLineTree[i] += numLines;
+		mRowTree[i] += numRows;
+	}
+}
+
+std::size_t VisualLineIndex::sumChunks(const std::vector<std::size_t>& tree, std::size_t numChunks) {
+	std::size_t sum = 0;
+	for (auto i = numChunks; i > 0; i -= i & (~i + 1)) {
+		sum += tree[i];
+	}
+
+	return sum;
+}
+
+std::pair<std::size_t, std::size_t> VisualLineIndex::findChunk(const std::vector<std::size_t>& tree, std::size_t value) {
+	std::size_t step = 1;
+	while (step * 2 < tree.size()) {
+		step *= 2;
+	}
+
+	std::size_t position = 0;
+	auto remaining = value;
+	for (; step > 0; step /= 2) {
+		auto next = position + step;
+		if (next < tree.size() && tree[next] <= remaining) {
+			position = next;
+			remaining -= tree[next];
+		}
+	}
+
+	return std::make_pair(position, remaining);
+}
+
+std::pair<std::size_t, std::size_t> VisualLineIndex::findLine(std::size_t lineIndex) const {
+	if (lineIndex >= mNumLines) {
+		return std::make_pair(mChunks.size() - 1, mChunks.back().numRows.size());
+	}
+
+	return findChunk(mLineTree, lineIndex);
+}
+
+bool VisualLineIndex::splitChunk(std::size_t chunkIndex) {
+	if (mChunks[chunkIndex].numRows.size() <= MAX_CHUNK_SIZE) {
+		return false;
+	}
+
+	auto chunk = std::move(mChunks[chunkIndex]);
+	std::vector<Chunk> parts;
+	for (std::size_t start = 0; start < chunk.numRows.size(); start += MAX_CHUNK_SIZE / 2) {
+		auto end = std::min(start + MAX_CHUNK_SIZE / 2, chunk.numRows.size());
+		Chunk part;
+		part.numRows.assign(chunk.numRows.begin() + start, chunk.numRows.begin() + end);
+		part.totalNumRows = std::accumulate(part.numRows.begin(), part.numRows.end(), (std::size_t)0);
+		parts.push_back(std::move(part));
+	}
+
+	mChunks.erase(mChunks.begin() + chunkIndex);
+	mChunks.insert(
+		mChunks.begin() + chunkIndex,
+		std::make_move_iterator(parts.begin()),
+		std::make_move_iterator(parts.end()));
+	return true;
+}
+
+void VisualLineIndex::assign(std::vector<std::size_t> numRows) {
+	mChunks.clear();
+	mNumLines = 0;
+	mTotalNumRows = 0;
+	buildTrees();
+	insertLines(0, numRows);
+}
+
+std::size_t VisualLineIndex::numLines() const {
+	return mNumLines;
+}
+
+std::size_t VisualLineIndex::numRows() const {
+	return mTotalNumRows;
+}
+
+std::size_t VisualLineIndex::numRows(std::size_t lineIndex) const {
+	if (lineIndex >= mNumLines) {
+		throw std::out_of_range("The line does not exist.");
+	}
+
+	auto position = findLine(lineIndex);
+	return mChunks[position.first].numRows[position.second];
+}
+
+void VisualLineIndex::setNumRows(std::size_t lineIndex, std::size_t numRows) {
+	if (lineIndex >= mNumLines) {
+		throw std::out_of_range("The line does not exist.");
+	}
+
+	auto position = findLine(lineIndex);
+	auto& chunk = mChunks[position.first];
+	auto& current = chunk.numRows[position.second];
+	if (current == numRows) {
+		return;
+	}
+
+	auto diff = numRows - current;
+	current = numRows;
+	chunk.totalNumRows += diff;
+	chunk.isFirstRowsValid = false;
+	mTotalNumRows += diff;
+	addToTrees(position.first, 0, diff);
+}
+
+void VisualLineIndex::insertLines(std::size_t lineIndex, const std::vector<std::size_t>& numRows) {
+	if (numRows.empty()) {
+		return;
+	}
+
+	if (mChunks.empty()) {
+		mChunks.emplace_back();
+		buildTrees();
+	}
+
+	auto position = findLine(std::min(lineIndex, mNumLines));
+	auto& chunk = mChunks[position.first];
+	chunk.numRows.insert(chunk.numRows.begin() + position.second, numRows.begin(), numRows.end());
+	chunk.isFirstRowsValid = false;
+
+	auto numInsertedRows = std::accumulate(numRows.begin(), numRows.end(), (std::size_t)0);
+	chunk.totalNumRows += numInsertedRows;
+	mNumLines += numRows.size();
+	mTotalNumRows += numInsertedRows;
+
+	if (splitChunk(position.first)) {
+		buildTrees();
+	} else {
+		addToTrees(position.first, numRows.size(), numInsertedRows);
+	}
+}
+
+void VisualLineIndex::eraseLines(std::size_t lineIndex, std::size_t count) {
+	if (lineIndex >= mNumLines) {
+		return;
+	}
+
+	count = std::min(count, mNumLines - lineIndex);
+	auto position = findLine(lineIndex);
+	auto chunkIndex = position.first;
+	auto index = position.second;
+	bool emptiedChunk = false;
+
+	for (auto remaining = count; remaining > 0; chunkIndex++, index = 0) {
+		auto& chunk = mChunks[chunkIndex];
+		auto numErased = std::min(remaining, chunk.numRows.size() - index);
+		auto begin = chunk.numRows.begin() + index;
+		auto numErasedRows = std::accumulate(begin, begin + numErased, (std::size_t)0);
+		chunk.numRows.erase(begin, begin + numErased);
+		chunk.totalNumRows -= numErasedRows;
+		chunk.isFirstRowsValid = false;
+		mTotalNumRows -= numErasedRows;
+
+		emptiedChunk |= chunk.numRows.empty();
+		addToTrees(chunkIndex, 0 - numErased, 0 - numErasedRows);
+		remaining -= numErased;
+	}
+
+	mNumLines -= count;
+
+	if (emptiedChunk) {
+		auto firstChunk = mChunks.begin() + position.first;
+		auto lastChunk = mChunks.begin() + chunkIndex;
+		auto isEmpty = [](const Chunk& chunk) { return chunk.numRows.empty(); };
+		mChunks.erase(std::remove_if(firstChunk, lastChunk, isEmpty), lastChunk);
+	}
+
+	// Small chunks are merged to keep the number of chunks proportional to the number of lines
+	bool mergedChunk = false;
+	if (position.first + 1 < mChunks.size()
+		&& mChunks[position.first].numRows.size() + mChunks[position.first + 1].numRows.size() <= MAX_CHUNK_SIZE / 2) {
+		auto& chunk = mChunks[position.first];
+		auto& nextChunk = mChunks[position.first + 1];
+		chunk.numRows.insert(chunk.numRows.end(), nextChunk.numRows.begin(), nextChunk.numRows.end());
+		chunk.totalNumRows += nextChunk.totalNumRows;
+		chunk.isFirstRowsValid = false;
+		mChunks.erase(mChunks.begin() + position.first + 1);
+		mergedChunk = true;
+	}
+
+	if (emptiedChunk || mergedChunk) {
+		buildTrees();
+	}
+}
+
+std::size_t VisualLineIndex::firstRow(std::size_t lineIndex) const {
+	if (lineIndex >= mNumLines) {
+		return mTotalNumRows;
+	}
+
+	auto position = findLine(lineIndex);
+	return sumChunks(mRowTree, position.first) + mChunks[position.first].getFirstRows()[position.second];
+}
+
+std::pair<std::size_t, std::size_t> VisualLineIndex::findRow(std::size_t rowIndex) const {
+	// Find the number of chunks that ends before the row
+	auto chunkPosition = findChunk(mRowTree, rowIndex);
+	if (chunkPosition.first == mChunks.size()) {
+		return std::make_pair(mNumLines, chunkPosition.second);
+	}
+
+	// The last line that starts at or before the row, which skips lines without rows
+	auto& firstRows = mChunks[chunkPosition.first].getFirstRows();
+	auto nextLine = std::upper_bound(firstRows.begin(), firstRows.end(), chunkPosition.second);
+	auto index = (std::size_t)(nextLine - firstRows.begin()) - 1;
+	return std::make_pair(
+		sumChunks(mLineTree, chunkPosition.first) + index,
+		chunkPosition.second - firstRows[index]);
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+/**
+ * Maps text lines to visual lines (rows) and back, where each text line is shown as one or more rows.
+ *
+ * The number of rows per line is stored in chunks of bounded size, and Fenwick trees over the number of lines and
+ * rows of each chunk locate the chunk of a line or row. Each chunk keeps the first row of its lines, which is
+ * recomputed when the chunk is accessed after a change. This gives logarithmic lookups in both directions, and edits
+ * that insert or erase lines only move the lines within a chunk.
+ */
+class VisualLineIndex {
+private:
+	static constexpr std::size_t MAX_CHUNK_SIZE = 512;
+
+	/**
+	 * A chunk of lines
+	 */
+	struct Chunk {
+		std::vector<std::size_t> numRows;
+		std::size_t totalNumRows = 0;
+
+		mutable std::vector<std::size_t> firstRows;
+		mutable bool isFirstRowsValid = false;
+
+		/**
+		 * Returns the first row of each line relative to the chunk
+		 */
+		const std::vector<std::size_t>& getFirstRows() const;
+	};
+
+	std::vector<Chunk> mChunks;
+	std::vector<std::size_t> mLineTree;
+	std::vector<std::size_t> mRowTree;
+	std::size_t mNumLines = 0;
+	std::size_t mTotalNumRows = 0;
+
+	/**
+	 * Builds the trees from the chunks
+	 */
+	void buildTrees();
+
+	/**
+	 * Adds the given number of lines and rows to the given chunk in the trees. The trees store unsigned values, where a
+	 * decrease is applied as a wrapping add.
+	 * @param chunkIndex The index of the chunk
+	 * @param numLines The number of lines
+	 * @param numRows The number of rows
+	 */
+	void addToTrees(std::size_t chunkIndex, std::size_t numLines, std::size_t numRows);
+
+	/**
+	 * Returns the sum of the first chunks in the given tree
+	 * @param tree The tree
+	 * @param numChunks The number of chunks
+	 */
+	static std::size_t sumChunks(const std::vector<std::size_t>& tree, std::size_t numChunks);
+
+	/**
+	 * Finds the number of chunks whose sum in the given tree does not exceed the given value
+	 * @param tree The tree
+	 * @param value The value
+	 * @return The number of chunks, and what remains of the value after them
+	 */
+	static std::pair<std::size_t, std::size_t> findChunk(const std::vector<std::size_t>& tree, std::size_t value);
+
+	/**
+	 * Finds the chunk that contains the given line. The number of lines maps to the end of the last chunk.
+	 * @param lineIndex The index of the line
+	 * @return The index of the chunk and the index within the chunk
+	 */
+	std::pair<std::size_t, std::size_t> findLine(std::size_t lineIndex) const;
+
+	/**
+	 * Splits the given chunk if it has become too large
+	 * @param chunkIndex The index of the chunk
+	 * @return True if split
+	 */
+	bool splitChunk(std::size_t chunkIndex);
+public:
+	/**
+	 * Assigns the number of rows for all lines
+	 * @param numRows The number of rows for each line
+	 */
+	void assign(std::vector<std::size_t> numRows);
+
+	/**
+	 * Returns the number of text lines
+	 */
+	std::size_t numLines() const;
+
+	/**
+	 * Returns the total number of rows
+	 */
+	std::size_t numRows() const;
+
+	/**
+	 * Returns the number of rows for the given line
+	 * @param lineIndex The index of the line
+	 */
+	std::size_t numRows(std::size_t lineIndex) const;
+
+	/**
+	 * Sets the number of rows for the given line
+	 * @param lineIndex The index of the line
+	 * @param numRows The number of rows
+	 */
+	void setNumRows(std::size_t lineIndex, std::size_t numRows);
+
+	/**
+	 * Inserts lines before the given line
+	 * @param lineIndex The index to insert at
+	 * @param numRows The number of rows for each inserted line
+	 */
+	void insertLines(std::size_t lineIndex, const std::vector<std::size_t>& numRows);
+
+	/**
+	 * Erases the given lines
+	 * @param lineIndex The index of the first line
+	 * @param count The number of lines
+	 */
+	void eraseLines(std::size_t lineIndex, std::size_t count);
+
+	/**
+	 * Returns the index of the first row of the given line
+	 * @param lineIndex The index of the line
+	 */
+	std::size_t firstRow(std::size_t lineIndex) const;
+
+	/**
+	 * Finds the line for the given row
+	 * @param rowIndex The index of the row
+	 * @return The index of the line, and the index of the row within the line
+	 */
+	std::pair<std::size_t, std::size_t> findRow(std::size_t rowIndex) const;
+};
\ No newline at end of file
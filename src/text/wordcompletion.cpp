@@ -0,0 +1,49 @@
+#include "wordcompletion.h"
+
+#include <algorithm>
+
+void WordCompletion::setKeywords(std::vector<String> keywords) {
+	mKeywords = std::move(keywords);
+	std::sort(mKeywords.begin(), mKeywords.end());
+}
+
+std::size_t WordCompletion::findWordStart(const String& line, std::size_t charIndex) {
+	auto start = std::min(charIndex, line.size());
+	while (start > 0 && SymbolIndex::isIdentifierCharacter(line[start - 1])) {
+		start--;
+	}
+
+	return start;
+}
+
+void WordCompletion::complete(const SymbolIndex* symbolIndex,
+							  const String& prefix,
+							  std::size_t maxCompletions,
+							  std::vector<Completion>& completions) {
+	completions.clear();
+	if (prefix.empty()) {
+		return;
+	}
+
+	if (symbolIndex != nullptr) {
+		// The prefix is usually an identifier of its own, as the word being typed is indexed
+		symbolIndex->findSymbolsWithPrefix(prefix, maxCompletions + 1, mSymbols);
+		for (auto symbol : mSymbols) {
+			auto& name = symbolIndex->symbolName(symbol);
+			if (name != prefix && completions.size() < maxCompletions) {
+				completions.push_back({ name, symbolIndex->symbolCount(symbol), false });
+			}
+		}
+	}
+
+	auto keyword = std::lower_bound(mKeywords.begin(), mKeywords.end(), prefix);
+	for (; keyword != mKeywords.end() && completions.size() < maxCompletions; ++keyword) {
+		if (keyword->compare(0, prefix.size(), prefix) != 0) {
+			break;
+		}
+
+		if (*keyword != prefix) {
+			completions.push_back({ *keyword, 0, true });
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "symbolindex.h"
+
+#include <vector>
+
+/**
+ * A word offered for completion
+ */
+struct Completion {
+	String word;
+	std::size_t frequency = 0;
+	bool isKeyword = false;
+};
+
+/**
+ * Completes words from the identifiers of a symbol index and the keywords of the language. The identifiers are ranked
+ * by their number of occurrences in the text. Keywords are not indexed, which means that they are ranked after the
+ * identifiers. The prefix search is a binary search over identifiers and keywords sorted by name.
+ */
+class WordCompletion {
+private:
+	std::vector<String> mKeywords;
+	std::vector<SymbolIndex::SymbolId> mSymbols;
+public:
+	/**
+	 * Sets the keywords
+	 * @param keywords The keywords
+	 */
+	void setKeywords(std::vector<String> keywords);
+
+	/**
+	 * Returns the index of the first character of the word that ends at the given position
+	 * @param line The line
+	 * @param charIndex The position
+	 */
+	static std::size_t findWordStart(const String& line, std::size_t charIndex);
+
+	/**
+	 * Finds the words that complete the given prefix, excluding the prefix itself
+	 * @param symbolIndex The symbol index, or null if only keywords are completed
+	 * @param prefix The prefix
+	 * @param maxCompletions The maximum number of completions
+	 * @param completions The completions, ordered by rank
+	 */
+	void complete(const SymbolIndex* symbolIndex,
+				  const String& prefix,
+				  std::size_t maxCompletions,
+				  std::vector<Completion>& completions);
+};
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "wrappedformattedtext.h"
+#include "../rendering/font.h"
+#include "../rendering/renderstyle.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// The number of lines on each side of the view whose rows are kept after they have been split
+	const std::size_t WRAPPED_LINES_WINDOW_SIZE = 256;
+}
+
+WrappedFormattedText::WrappedFormattedText(const Font& font, const RenderStyle& renderStyle, const FoldIndex& folds)
+	: mFont(font), mRenderStyle(renderStyle), mFolds(folds) {
+
+}
+
+std::size_t WrappedFormattedText::estimateNumRows(std::size_t lineIndex) const {
+	if (mFolds.isHidden(lineIndex)) {
+		return 0;
+	}
+
+	// Most lines fit, which we know from the width computed when formatting
+	auto width = mText->getLineWidth(lineIndex);
+	if (width <= mMaxWidth) {
+		return 1;
+	}
+
+	// A row can end before the maximum width, which means that a line can need more rows than this
+	return std::max((std::size_t)std::ceil(width / std::max(mMaxWidth, 1.0f)), (std::size_t)2);
+}
+
+void WrappedFormattedText::wrapLine(std::size_t lineIndex, std::vector<FormattedLine>& rows) const {
+	auto& line = mText->getLine(lineIndex);
+	FormattedLine currentRow;
+	currentRow.number = lineIndex;
+	float currentWidth = 0.0f;
+	std::size_t offsetFromTextLine = 0;
+
+	for (auto& token : line.tokens) {
+		Token currentToken;
+		currentToken.type = token.type;
+
+		for (auto character : token.text) {
+			auto advanceX = mRenderStyle.getAdvanceX(mFont, character);
+			if (currentWidth > 0.0f && currentWidth + advanceX > mMaxWidth) {
+				if (!currentToken.text.empty()) {
+					currentRow.addToken(currentToken);
+					currentToken.text = {};
+				}
+
+				currentRow.width = currentWidth;
+				rows.push_back(std::move(currentRow));
+
+				currentRow = {};
+				currentRow.number = lineIndex;
+				currentRow.isContinuation = true;
+				currentRow.offsetFromTextLine = offsetFromTextLine;
+				currentWidth = 0.0f;
+			}
+
+			currentToken.text += character;
+			currentWidth += advanceX;
+			offsetFromTextLine++;
+		}
+
+		if (!currentToken.text.empty()) {
+			currentRow.addToken(std::move(currentToken));
+		}
+	}
+
+	currentRow.width = currentWidth;
+	rows.push_back(std::move(currentRow));
+}
+
+const std::vector<FormattedLine>& WrappedFormattedText::getWrappedLine(std::size_t lineIndex) const {
+	// Only the lines that are actually shown are split
+	auto wrappedIterator = mWrappedLines.find(lineIndex);
+	if (wrappedIterator == mWrappedLines.end()) {
+		std::vector<FormattedLine> rows;
+		wrapLine(lineIndex, rows);
+		mLineIndex.setNumRows(lineIndex, rows.size());
+		wrappedIterator = mWrappedLines.insert({ lineIndex, std::move(rows) }).first;
+	}
+
+	return wrappedIterator->second;
+}
+
+void WrappedFormattedText::invalidateWrappedLines(std::size_t lineIndex,
+												  std::size_t numOldLines,
+												  std::size_t numNewLines) {
+	auto endLineIndex = lineIndex + numOldLines;
+	if (numOldLines == numNewLines && numOldLines < mWrappedLines.size()) {
+		for (auto i = lineIndex; i < endLineIndex; i++) {
+			mWrappedLines.erase(i);
+		}
+
+		return;
+	}
+
+	std::unordered_map<std::size_t, std::vector<FormattedLine>> wrappedLines;
+	for (auto& wrappedLine : mWrappedLines) {
+		auto wrappedLineIndex = wrappedLine.first;
+		if (wrappedLineIndex >= lineIndex && wrappedLineIndex < endLineIndex) {
+			continue;
+		}
+
+		if (wrappedLineIndex >= endLineIndex) {
+			wrappedLineIndex = wrappedLineIndex - numOldLines + numNewLines;
+			for (auto& row : wrappedLine.second) {
+				row.number = wrappedLineIndex;
+			}
+		}
+
+		wrappedLines.insert({ wrappedLineIndex, std::move(wrappedLine.second) });
+	}
+
+	mWrappedLines = std::move(wrappedLines);
+}
+
+void WrappedFormattedText::layout(const BaseFormattedText& text, float maxWidth) {
+	mText = &text;
+	mMaxWidth = maxWidth;
+	mWrappedLines.clear();
+
+	// The lines are split when shown, which replaces the estimates of the lines that do not fit
+	std::vector<std::size_t> lineNumRows;
+	lineNumRows.reserve(text.numLines());
+	for (std::size_t lineIndex = 0; lineIndex < text.numLines(); lineIndex++) {
+		lineNumRows.push_back(estimateNumRows(lineIndex));
+	}
+
+	mLineIndex.assign(std::move(lineNumRows));
+}
+
+void WrappedFormattedText::replaceLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines) {
+	// Reformatting may change the tokens of lines after the edited ones (e.g. block comments), which are replaced
+	// separately, while the split lines after the replaced ones are only moved
+	invalidateWrappedLines(lineIndex, numOldLines, numNewLines);
+
+	auto numSameLines = std::min(numOldLines, numNewLines);
+	for (std::size_t i = lineIndex; i < lineIndex + numSameLines; i++) {
+		mLineIndex.setNumRows(i, estimateNumRows(i));
+	}
+
+	if (numOldLines > numNewLines) {
+		mLineIndex.eraseLines(lineIndex + numSameLines, numOldLines - numNewLines);
+	} else if (numNewLines > numOldLines) {
+		std::vector<std::size_t> lineNumRows;
+		for (std::size_t i = lineIndex + numSameLines; i < lineIndex + numNewLines; i++) {
+			lineNumRows.push_back(estimateNumRows(i));
+		}
+
+		mLineIndex.insertLines(lineIndex + numSameLines, lineNumRows);
+	}
+}
+
+void WrappedFormattedText::updateWindow(std::size_t viewStartRowIndex,
+										std::size_t viewEndRowIndex,
+										std::size_t caretLineIndex) {
+	if (mLineIndex.numLines() == 0) {
+		return;
+	}
+
+	// Splitting a line replaces its estimated number of rows, which moves the lines after it
+	auto viewStartLineIndex = std::min(mLineIndex.findRow(viewStartRowIndex).first, mLineIndex.numLines() - 1);
+	auto viewEndLineIndex = viewStartLineIndex;
+	for (; viewEndLineIndex < mLineIndex.numLines(); viewEndLineIndex++) {
+		if (mLineIndex.firstRow(viewEndLineIndex) > viewEndRowIndex) {
+			break;
+		}
+
+		if (mLineIndex.numRows(viewEndLineIndex) > 1) {
+			getWrappedLine(viewEndLineIndex);
+		}
+	}
+
+	auto windowStartLineIndex = viewStartLineIndex - std::min(viewStartLineIndex, WRAPPED_LINES_WINDOW_SIZE);
+	auto windowEndLineIndex = viewEndLineIndex + WRAPPED_LINES_WINDOW_SIZE;
+	if (mWrappedLines.size() <= windowEndLineIndex - windowStartLineIndex + 1) {
+		return;
+	}
+
+	for (auto wrappedLine = mWrappedLines.begin(); wrappedLine != mWrappedLines.end();) {
+		auto wrappedLineIndex = wrappedLine->first;
+		if ((wrappedLineIndex < windowStartLineIndex || wrappedLineIndex > windowEndLineIndex)
+			&& wrappedLineIndex != caretLineIndex) {
+			wrappedLine = mWrappedLines.erase(wrappedLine);
+		} else {
+			++wrappedLine;
+		}
+	}
+}
+
+float WrappedFormattedText::maxWidth() const {
+	return mMaxWidth;
+}
+
+std::size_t WrappedFormattedText::numLines() const {
+	return mLineIndex.numRows();
+}
+
+const FormattedLine& WrappedFormattedText::getLine(std::size_t index) const {
+	auto row = mLineIndex.findRow(index);
+	auto numRows = mLineIndex.numRows(row.first);
+	if (numRows == 1) {
+		return mText->getLine(row.first);
+	}
+
+	auto& rows = getWrappedLine(row.first);
+	if (rows.size() != numRows) {
+		// The estimated number of rows was replaced, which moved the rows after the first row of the line
+		return getLine(std::min(index, mLineIndex.numRows() - 1));
+	}
+
+	return rows.at(row.second);
+}
+
+std::size_t WrappedFormattedText::getVisualLineIndex(std::size_t lineIndex, std::size_t charIndex) const {
+	if (mLineIndex.numRows(lineIndex) <= 1) {
+		return mLineIndex.firstRow(lineIndex);
+	}
+
+	auto& rows = getWrappedLine(lineIndex);
+	auto firstRow = mLineIndex.firstRow(lineIndex);
+	std::size_t rowIndex = 0;
+	while (rowIndex + 1 < rows.size() && rows[rowIndex + 1].offsetFromTextLine <= charIndex) {
+		rowIndex++;
+	}
+
+	return firstRow + rowIndex;
+}
+
+std::size_t WrappedFormattedText::getTextLineIndex(std::size_t visualLineIndex) const {
+	return mLineIndex.findRow(visualLineIndex).first;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "formattedtext.h"
+#include "visuallineindex.h"
+#include "foldindex.h"
+
+#include <vector>
+#include <unordered_map>
+
+class Font;
+struct RenderStyle;
+
+/**
+ * Represents a word wrapped layout of formatted text. The layout is computed from the logical lines produced by the
+ * formatter, which means that changing the wrap width does not require the text to be formatted again.
+ * Folded lines are laid out as zero rows.
+ *
+ * Only the lines that are shown are split into rows. The number of rows of a line that does not fit is estimated from
+ * its width until the line is split, and only the split lines around the view are kept.
+ */
+class WrappedFormattedText : public BaseFormattedText {
+private:
+	const Font& mFont;
+	const RenderStyle& mRenderStyle;
+	const FoldIndex& mFolds;
+
+	const BaseFormattedText* mText = nullptr;
+	float mMaxWidth = 0.0f;
+	// The estimated number of rows of a line is replaced when the line is split
+	mutable VisualLineIndex mLineIndex;
+
+	mutable std::unordered_map<std::size_t, std::vector<FormattedLine>> mWrappedLines;
+
+	/**
+	 * Returns the number of rows the given line is wrapped into, which is estimated from the width of the line if it
+	 * does not fit
+	 * @param lineIndex The index of the line
+	 */
+	std::size_t estimateNumRows(std::size_t lineIndex) const;
+
+	/**
+	 * Splits the given line into rows
+	 * @param lineIndex The index of the line
+	 * @param rows The rows
+	 */
+	void wrapLine(std::size_t lineIndex, std::vector<FormattedLine>& rows) const;
+
+	/**
+	 * Returns the rows for the given line, which must be wrapped. Splitting the line replaces its estimated number of
+	 * rows.
+	 * @param lineIndex The index of the line
+	 */
+	const std::vector<FormattedLine>& getWrappedLine(std::size_t lineIndex) const;
+
+	/**
+	 * Removes the rows of the given lines and moves the rows of the lines after them
+	 * @param lineIndex The index of the first line
+	 * @param numOldLines The number of lines before the change
+	 * @param numNewLines The number of lines after the change
+	 */
+	void invalidateWrappedLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines);
+public:
+	/**
+	 * Creates a new wrapped formatted text
+	 * @param font The font
+	 * @param renderStyle The render style
+	 * @param folds The folds
+	 */
+	WrappedFormattedText(const Font& font, const RenderStyle& renderStyle, const FoldIndex& folds);
+
+	/**
+	 * Computes the layout for the given text
+	 * @param text The formatted text
+	 * @param maxWidth The maximum width of a row
+	 */
+	void layout(const BaseFormattedText& text, float maxWidth);
+
+	/**
+	 * Updates the layout after the given lines have been replaced in the formatted text
+	 * @param lineIndex The index of the first replaced line
+	 * @param numOldLines The number of lines before the change
+	 * @param numNewLines The number of lines after the change
+	 */
+	void replaceLines(std::size_t lineIndex, std::size_t numOldLines, std::size_t numNewLines);
+
+	/**
+	 * Splits the lines shown in the given rows, which makes their number of rows exact, and removes the split lines
+	 * that are far from the view and the caret
+	 * @param viewStartRowIndex The index of the first visible row
+	 * @param viewEndRowIndex The index of the last visible row
+	 * @param caretLineIndex The index of the line of the caret
+	 */
+	void updateWindow(std::size_t viewStartRowIndex, std::size_t viewEndRowIndex, std::size_t caretLineIndex);
+
+	/**
+	 * Returns the width that the current layout was computed for
+	 */
+	float maxWidth() const;
+
+	/**
+	 * Returns the number of lines
+	 */
+	virtual std::size_t numLines() const override;
+
+	/**
+	 * Returns the formatting for the given line
+	 * @param index The index
+	 */
+	virtual const FormattedLine& getLine(std::size_t index) const override;
+
+	/**
+	 * Returns the index of the visual line that the given position in the text is shown at
+	 * @param lineIndex The index of the text line
+	 * @param charIndex The index of the character in the text line
+	 */
+	virtual std::size_t getVisualLineIndex(std::size_t lineIndex, std::size_t charIndex) const override;
+
+	/**
+	 * Returns the index of the text line that the given visual line shows
+	 * @param visualLineIndex The index of the visual line
+	 */
+	virtual std::size_t getTextLineIndex(std::size_t visualLineIndex) const override;
+};
\ No newline at end of file
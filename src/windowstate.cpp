@@ -1,4 +1,6 @@
 #include "windowstate.h"
+#include <algorithm>
+#include <cmath>
 #include <glm/gtc/matrix_transform.hpp>
 
 #define GLEW_STATIC
@@ -6,6 +8,11 @@
 #include <GLFW/glfw3.h>
 
 namespace {
+	// The zoom is a power of the step, which returns to exactly one when zooming back
+	const double zoomStep = 1.1;
+	const double minZoomLevel = -7.0;
+	const double maxZoomLevel = 14.0;
+
 	WindowState& getWindowState(GLFWwindow* window) {
 		return *(WindowState*)glfwGetWindowUserPointer(window);
 	}
@@ -20,7 +27,14 @@ void WindowState::initialize(GLFWwindow* window) {
 
 	glfwSetScrollCallback(window, [](GLFWwindow* window, double offsetX, double offsetY) {
 		auto& windowState = getWindowState(window);
-		windowState.setScrollY(offsetY);
+
+		// Scrolling while holding control zooms the view
+		if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS
+			|| glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS) {
+			windowState.changeZoom(offsetY);
+		} else {
+			windowState.setScrollY(offsetY);
+		}
 	});
 
 	glfwSetCharCallback(window, [](GLFWwindow* window, CodePoint codePoint) {
@@ -30,6 +44,7 @@ void WindowState::initialize(GLFWwindow* window) {
 
 	glfwSetMouseButtonCallback(window, [](GLFWwindow* window, int button, int action, int mods) {
 		auto& windowState = getWindowState(window);
+		windowState.damage();
 
 		if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
 			windowState.leftMouseButtonPressed();
@@ -39,6 +54,11 @@ void WindowState::initialize(GLFWwindow* window) {
 			windowState.rightMouseButtonPressed();
 		}
 	});
+
+	glfwSetWindowRefreshCallback(window, [](GLFWwindow* window) {
+		auto& windowState = getWindowState(window);
+		windowState.damage();
+	});
 }
 
 void WindowState::update() {
@@ -68,10 +88,23 @@ void WindowState::update() {
 	}
 }
 
+void WindowState::damage() {
+	mIsDamaged = true;
+}
+
+bool WindowState::isDamaged() const {
+	return mIsDamaged;
+}
+
+void WindowState::clearDamage() {
+	mIsDamaged = false;
+}
+
 void WindowState::changeWindowSize(int width, int height) {
 	mWidth = width;
 	mHeight = height;
 	mChangedWindowSize = true;
+	mIsDamaged = true;
 }
 
 int WindowState::width() const {
@@ -83,7 +116,7 @@ int WindowState::height() const {
 }
 
 glm::mat4x4 WindowState::projection() const {
-	return glm::ortho(0.0f, (float)width(), -(float)height(), 0.0f);
+	return glm::ortho(0.0f, (float)width() / mZoom, -(float)height() / mZoom, 0.0f);
 }
 
 bool WindowState::hasChangedWindowSize() {
@@ -95,9 +128,33 @@ bool WindowState::hasChangedWindowSize() {
 	return false;
 }
 
+void WindowState::changeZoom(double steps) {
+	auto zoomLevel = std::min(std::max(mZoomLevel + steps, minZoomLevel), maxZoomLevel);
+	if (zoomLevel != mZoomLevel) {
+		mZoomLevel = zoomLevel;
+		mZoom = (float)std::pow(zoomStep, mZoomLevel);
+		mChangedZoom = true;
+		mIsDamaged = true;
+	}
+}
+
+float WindowState::zoom() const {
+	return mZoom;
+}
+
+bool WindowState::hasChangedZoom() {
+	if (mChangedZoom) {
+		mChangedZoom = false;
+		return true;
+	}
+
+	return false;
+}
+
 void WindowState::setScrollY(double value) {
 	mScrollValueY = value;
 	mScrollValueChanged = true;
+	mIsDamaged = true;
 }
 
 bool WindowState::hasScrolled() const {
@@ -110,6 +167,7 @@ double WindowState::scrollY() const {
 
 void WindowState::addCharacter(CodePoint codePoint) {
 	mCharacterBuffer.push_back(codePoint);
+	mIsDamaged = true;
 }
 
 const std::vector<CodePoint>& WindowState::inputCharacters() const {
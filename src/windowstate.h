@@ -14,6 +14,10 @@ private:
 	int mHeight = 720;
 	bool mChangedWindowSize = false;
 
+	double mZoomLevel = 0.0;
+	float mZoom = 1.0f;
+	bool mChangedZoom = false;
+
 	double mScrollValueY = 0.0;
 	bool mScrollValueChanged = false;
 
@@ -26,6 +30,8 @@ private:
 	bool mLeftMouseButtonPressedChanged = false;
 	bool mRightMouseButtonPressed = false;
 	bool mRightMouseButtonPressedChanged = false;
+
+	bool mIsDamaged = true;
 public:
 	/**
 	 * Initializes the window state using the given GLFW window
@@ -38,6 +44,21 @@ public:
 	 */
 	void update();
 
+	/**
+	 * Marks that the window needs to be redrawn
+	 */
+	void damage();
+
+	/**
+	 * Indicates if the window needs to be redrawn due to input or changes to the window
+	 */
+	bool isDamaged() const;
+
+	/**
+	 * Clears the damage after the window has been redrawn
+	 */
+	void clearDamage();
+
 	/**
 	 * Changes the window size
 	 * @param width The width of the window
@@ -56,7 +77,7 @@ public:
 	int height() const;
 
 	/**
-	 * Returns the projection matrix
+	 * Returns the projection matrix, which scales the view by the zoom
 	 */
 	glm::mat4x4 projection() const;
 
@@ -65,6 +86,22 @@ public:
 	 */
 	bool hasChangedWindowSize();
 
+	/**
+	 * Zooms the view by the given number of steps, where a negative number zooms out
+	 * @param steps The number of steps
+	 */
+	void changeZoom(double steps);
+
+	/**
+	 * Returns the zoom, which is the number of pixels in the window per unit in the view
+	 */
+	float zoom() const;
+
+	/**
+	 * Indicates if the zoom has changed, if that the case, clears the indication
+	 */
+	bool hasChangedZoom();
+
 	/**
 	 * Sets the scroll value
 	 */